@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -18,11 +18,40 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         main.cpp \
         mainwindow.cpp \
-    imagedenoizerapi.cpp
+    imagedenoizerapi.cpp \
+    imageframe.cpp \
+    batchprocessor.cpp \
+    resultcache.cpp \
+    operationgraph.cpp \
+    profiler.cpp \
+    videoprocessor.cpp \
+    stripprocessor.cpp \
+    imagestore.cpp \
+    denoizercomparison.cpp \
+    comparedialog.cpp \
+    imageencoder.cpp \
+    encoderoptionsdialog.cpp \
+    processingdaemon.cpp
 
 HEADERS += \
         mainwindow.h \
-    imagedenoizerapi.h
+    imagedenoizerapi.h \
+    imageframe.h \
+    batchprocessor.h \
+    resultcache.h \
+    operationgraph.h \
+    profiler.h \
+    videoprocessor.h \
+    boundedqueue.h \
+    stripprocessor.h \
+    imagestore.h \
+    denoizercomparison.h \
+    comparedialog.h \
+    imageencoder.h \
+    encoderoptionsdialog.h \
+    processingdaemon.h
+
+include(imagecore.pri)
 
 FORMS += \
         mainwindow.ui
@@ -36,3 +65,15 @@ LIBS += -LC:/opencv-mingw/x86/mingw/lib/ \
                                 -lopencv_photo410
 
 INCLUDEPATH +=  C:/opencv-mingw/include/
+
+# POSIX shared memory of the daemon mode
+unix:!macx: LIBS += -lrt
+
+# TIFF inputs of the streaming mode are read strip by strip with libtiff,
+# "qmake CONFIG+=no_libtiff" decodes them as a whole instead
+!no_libtiff {
+    DEFINES += HAVE_LIBTIFF
+    win32: LIBS += -LC:/libtiff-mingw/lib/
+    win32: INCLUDEPATH += C:/libtiff-mingw/include/
+    LIBS += -ltiff
+}
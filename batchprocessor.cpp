@@ -0,0 +1,589 @@
+#include "batchprocessor.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+
+#include <atomic>
+
+#include <opencv2/opencv.hpp>
+
+#include "workpool.h"
+
+// Image formats processed in batch mode
+static const char *g_batchFilters[] = { "*.jpg", "*.jpeg", "*.png", "*.tif", "*.tiff", "*.bmp" };
+
+BatchProcessor::BatchProcessor() :
+    m_encoderOptions(ImageEncoder::defaultOptions()),
+    m_threadCount(QThread::idealThreadCount())
+{
+    m_operation.bDenoize = false;
+    m_operation.type = TypeGaussianBlur;
+    m_operation.bEdit = false;
+    m_operation.brightness = 100;
+    m_operation.contrast = 100;
+    m_operation.hue = -1;
+    m_operation.saturation = -1;
+}
+
+void BatchProcessor::setOperation(const BatchOperation &_operation)
+{
+    m_operation = _operation;
+}
+
+void BatchProcessor::setThreadCount(int _threads)
+{
+    m_threadCount = (_threads > 0) ? _threads : QThread::idealThreadCount();
+}
+
+void BatchProcessor::setEncoderOptions(const EncoderOptions &_options)
+{
+    m_encoderOptions = _options;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Process every image of the input directory and write results
++          into the output directory (same file names). Files are
++          dispatched over the work pool so that decoding, processing
++          and encoding of different files overlap; the tiles of a file
++          are run by the same pool
++ ----------------
++ Parameters : _inputDir    directory containing the images to process
++              _outputDir   directory receiving the processed images
++ Returns    : TRUE if every file was processed; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool BatchProcessor::bRun(QString _inputDir, QString _outputDir)
+{
+    QDir inputDir(_inputDir);
+    QDir outputDir(_outputDir);
+    QStringList filters;
+    QStringList files;
+    QElapsedTimer timer;
+    std::atomic<int> nextFile(0);
+    int inFlight;
+    bool bOK = true;
+
+    if(!inputDir.exists())
+    {
+        qDebug() << __func__ << " Input directory does not exist!";
+        return false;
+    }
+
+    if(!outputDir.exists() && !QDir().mkpath(_outputDir))
+    {
+        qDebug() << __func__ << " Could not create output directory!";
+        return false;
+    }
+
+    if(m_operation.bDenoize && !ImageProcessor::bCheckDenoizeParams(m_operation.type, m_operation.params))
+    {
+        qDebug() << __func__ << " Bad parameters!";
+        return false;
+    }
+
+    for(const char *filter : g_batchFilters)
+    {
+        filters << filter;
+    }
+    files = inputDir.entryList(filters, QDir::Files, QDir::Name);
+    inFlight = std::max(1, std::min(m_threadCount, files.size()));
+
+    m_results.clear();
+    m_results.reserve(files.size());
+
+    WorkPool::instance().resetStats();
+    timer.start();
+
+    // At most m_threadCount files in flight, pulled from a shared counter.
+    // Threads left idle by the last files steal their tiles
+    WorkPool::instance().parallelFor(inFlight, [&](int _begin, int _end)
+    {
+        for(int w = _begin; w < _end; w++)
+        {
+            int index;
+
+            while((index = nextFile++) < files.size())
+            {
+                processFile(inputDir.filePath(files[index]), outputDir.filePath(files[index]));
+            }
+        }
+    }, inFlight);
+
+    printReport(timer.nsecsElapsed() / 1e6);
+
+    foreach(const BatchResult &result, m_results)
+    {
+        bOK = bOK && result.bOK;
+    }
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ processFile() - Decode, process and encode one file, and record timings
++ ----------------
++ Parameters : _inputFile   image to process
++              _outputFile  processed image location
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void BatchProcessor::processFile(const QString &_inputFile, const QString &_outputFile)
+{
+    BatchResult result;
+    QElapsedTimer timer;
+    cv::Mat img;
+    cv::Mat out;
+
+    result.file = QFileInfo(_inputFile).fileName();
+    result.bOK = false;
+    result.megaPixels = 0;
+    result.decodeMs = 0;
+    result.processMs = 0;
+    result.encodeMs = 0;
+    result.outputBytes = 0;
+
+    // Decode
+    timer.start();
+    img = cv::imread(_inputFile.toStdString());
+    result.decodeMs = timer.nsecsElapsed() / 1e6;
+
+    if(!img.empty())
+    {
+        result.megaPixels = img.total() / 1e6;
+        result.bOK = true;
+
+        // Process
+        timer.restart();
+        result.bOK = bApplyOperation(m_operation, img, out);
+        img = out;
+        result.processMs = timer.nsecsElapsed() / 1e6;
+
+        // Encode
+        if(result.bOK)
+        {
+            EncodeResult encoded;
+
+            result.bOK = ImageEncoder::bEncode(img, _outputFile, m_encoderOptions, encoded);
+            result.encodeMs = encoded.encodeMs + encoded.writeMs;
+            result.outputBytes = encoded.bytes;
+        }
+    }
+
+    QMutexLocker locker(&m_resultMutex);
+    m_results.append(result);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bApplyOperation() - Edit then denoize an image as requested
++ ----------------
++ Parameters : _operation   checked operation to apply
++              _in          input BGR image
++              _out         output BGR image (the input itself when
++                           there is nothing to do)
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool BatchProcessor::bApplyOperation(const BatchOperation &_operation, const cv::Mat &_in, cv::Mat &_out)
+{
+    cv::Mat img = _in;
+    cv::Mat out;
+
+    if(_operation.bEdit)
+    {
+        ColorEditKernel kernel;
+        int meanHue = 0;
+        int meanSaturation = 0;
+
+        ImageProcessor::computeMeanHueSaturation(img, meanHue, meanSaturation);
+        ImageProcessor::buildEditKernel(kernel, _operation.brightness, _operation.contrast,
+                                        (_operation.hue < 0) ? meanHue : _operation.hue,
+                                        (_operation.saturation < 0) ? meanSaturation : _operation.saturation,
+                                        meanHue, meanSaturation);
+        if(!ImageProcessor::bEditImage(img, out, kernel, false))
+            return false;
+        img = out;
+    }
+    if(_operation.bDenoize)
+    {
+        if(!ImageProcessor::bDenoizeImage(img, out, _operation.type, _operation.params))
+            return false;
+        img = out;
+    }
+
+    _out = img;
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ printReport() - Print per file and aggregate throughput
++ ----------------
++ Parameters : _wallMs     total elapsed time of the batch
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void BatchProcessor::printReport(double _wallMs)
+{
+    QTextStream out(stdout);
+    WorkPoolStats stats = WorkPool::instance().stats();
+    double megaPixels = 0;
+    qint64 outputBytes = 0;
+    int failed = 0;
+
+    out << "file\tMP\tdecode ms\tprocess ms\tencode ms\toutput KB\tMP/s\tstatus\n";
+
+    foreach(const BatchResult &result, m_results)
+    {
+        double totalMs = result.decodeMs + result.processMs + result.encodeMs;
+
+        out << result.file << "\t"
+            << QString::number(result.megaPixels, 'f', 2) << "\t"
+            << QString::number(result.decodeMs, 'f', 1) << "\t"
+            << QString::number(result.processMs, 'f', 1) << "\t"
+            << QString::number(result.encodeMs, 'f', 1) << "\t"
+            << result.outputBytes / 1024 << "\t"
+            << QString::number((totalMs > 0) ? result.megaPixels * 1000 / totalMs : 0, 'f', 2) << "\t"
+            << (result.bOK ? "OK" : "FAILED") << "\n";
+
+        megaPixels += result.megaPixels;
+        outputBytes += result.outputBytes;
+        if(!result.bOK)
+            failed++;
+    }
+
+    out << "\n" << m_results.size() << " files (" << failed << " failed) in "
+        << QString::number(_wallMs / 1000, 'f', 2) << " s using " << m_threadCount << " files in flight, "
+        << QString::number(outputBytes / (1024.0 * 1024.0), 'f', 1) << " MB written\n";
+    out << "Work pool: " << stats.threads << " threads (OpenCV " << stats.opencvThreads << " per task), "
+        << stats.executed << " tasks, " << stats.steals << " steals, max queue depth " << stats.maxQueued << "\n";
+
+    if(_wallMs > 0)
+    {
+        out << QString::number(m_results.size() * 1000 / _wallMs, 'f', 2) << " files/s, "
+            << QString::number(megaPixels * 1000 / _wallMs, 'f', 2) << " MP/s\n";
+    }
+
+    if(Profiler::bIsEnabled())
+    {
+        out << "Stages: " << Profiler::formatStageTimings(Profiler::stageTimingsSince(0)) << "\n";
+    }
+
+    if(m_operation.bDenoize && (m_operation.type == TypeNlMeans))
+    {
+        int tier = ImageProcessor::GetNlMeansTier(m_operation.params);
+
+        if(tier >= 0)
+        {
+            out << "NlMeans tier cost: "
+                << QString::number(ImageProcessor::GetNlMeansTierCost((NlMeansTier)tier), 'f', 1) << " ms/MP\n";
+        }
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ addProcessingOptions() - Add the denoizing & editing options shared by
++                          the headless modes
++ ----------------
++ Parameters : _parser  command line parser
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void addProcessingOptions(QCommandLineParser &_parser)
+{
+    _parser.addOptions({
+        { "op", "Denoizing operation: none, gaussian, median, nlmeans, fastgaussian, guided or bilateralgrid", "op", "none" },
+        { "sigma", "GaussianBlur & FastGaussian sigma (x10)", "value", "15" },
+        { "kernel-width", "GaussianBlur kernel width", "value", "5" },
+        { "kernel-height", "GaussianBlur kernel height", "value", "5" },
+        { "aperture", "MedianBlur aperture", "value", "5" },
+        { "tier", "NlMeans tier: draft, balanced or best", "tier", "balanced" },
+        { "h", "NlMeans filter strength", "value", "3" },
+        { "radius", "GuidedFilter window radius", "value", "4" },
+        { "epsilon", "GuidedFilter edge threshold (levels)", "value", "20" },
+        { "cell", "BilateralGrid cell size (8 to 64, rounded to a power of two)", "value", "16" },
+        { "range", "BilateralGrid range sigma (levels)", "value", "24" },
+        { "brightness", "Brightness between 1 and 200", "value", "100" },
+        { "contrast", "Contrast between 1 and 200", "value", "100" },
+        { "hue", "Target mean hue between 0 and 179", "value", "-1" },
+        { "saturation", "Target mean saturation between 0 and 255", "value", "-1" },
+        { "tile-budget", "Memory budget for NlMeans tiles in flight (MB)", "MB", "0" },
+        { "trace", "Write a Chrome trace of the processing stages", "file" },
+    });
+    addPoolOptions(_parser);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bParseProcessingOptions() - Read the denoizing & editing options
++ ----------------
++ Parameters : _parser      command line parser (processed)
++              _operation   receives the operation to apply
++ Returns    : TRUE if the options are valid; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool bParseProcessingOptions(const QCommandLineParser &_parser, BatchOperation &_operation)
+{
+    QString op = _parser.value("op");
+
+    _operation.bDenoize = true;
+    if(op == "gaussian")
+        _operation.type = TypeGaussianBlur;
+    else if(op == "median")
+        _operation.type = TypeMedianBlur;
+    else if(op == "nlmeans")
+        _operation.type = TypeNlMeans;
+    else if(op == "fastgaussian")
+        _operation.type = TypeFastGaussian;
+    else if(op == "guided")
+        _operation.type = TypeGuidedFilter;
+    else if(op == "bilateralgrid")
+        _operation.type = TypeBilateralGrid;
+    else if(op == "none")
+    {
+        _operation.type = TypeGaussianBlur;
+        _operation.bDenoize = false;
+    }
+    else
+    {
+        qDebug() << "Unkown operation:" << op;
+        return false;
+    }
+
+    _operation.params.sigma = _parser.value("sigma").toInt();
+    _operation.params.kernelSizeWidth = _parser.value("kernel-width").toInt();
+    _operation.params.kernelSizeHeight = _parser.value("kernel-height").toInt();
+    _operation.params.aperture = _parser.value("aperture").toInt();
+    _operation.params.h = _parser.value("h").toInt();
+    _operation.params.hColor = _operation.params.h;
+    _operation.params.guidedRadius = _parser.value("radius").toInt();
+    _operation.params.guidedEpsilon = _parser.value("epsilon").toInt();
+    _operation.params.gridCellSize = _parser.value("cell").toInt();
+    _operation.params.gridRangeSigma = _parser.value("range").toInt();
+    if(_parser.value("tier") == "draft")
+        ImageProcessor::GetNlMeansTierParameters(NlMeansDraft, _operation.params);
+    else if(_parser.value("tier") == "best")
+        ImageProcessor::GetNlMeansTierParameters(NlMeansBest, _operation.params);
+    else
+        ImageProcessor::GetNlMeansTierParameters(NlMeansBalanced, _operation.params);
+
+    _operation.brightness = _parser.value("brightness").toInt();
+    _operation.contrast = _parser.value("contrast").toInt();
+    _operation.hue = _parser.value("hue").toInt();
+    _operation.saturation = _parser.value("saturation").toInt();
+    _operation.bEdit = (_operation.brightness != 100) || (_operation.contrast != 100) ||
+                       (_operation.hue >= 0) || (_operation.saturation >= 0);
+
+    if(_operation.bEdit &&
+       !ImageProcessor::bCheckImageEditingValues(_operation.brightness, _operation.contrast,
+                                                 std::max(_operation.hue, 0), std::max(_operation.saturation, 0)))
+    {
+        qDebug() << "Bad editing values!";
+        return false;
+    }
+
+    if(_parser.value("tile-budget").toInt() > 0)
+    {
+        TiledExecutor::setDefaultMemoryBudget((size_t)_parser.value("tile-budget").toInt() * 1024 * 1024);
+    }
+
+    if(!bParsePoolOptions(_parser))
+        return false;
+
+    if(_parser.isSet("trace"))
+    {
+        Profiler::setEnabled(true);
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ addPoolOptions() - Add the options of the work pool
++ ----------------
++ Parameters : _parser  command line parser
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void addPoolOptions(QCommandLineParser &_parser)
+{
+    _parser.addOptions({
+        { "pool-threads", "Threads of the work pool (0 for one per CPU)", "N", "0" },
+        { "pool-affinity", "CPUs the pool threads are pinned to, e.g. 0-3,8 (Linux, Windows)", "cpus" },
+    });
+}
+
+/**
+*************************************************************************
+@verbatim
++ bParsePoolOptions() - Configure the work pool when its options are set
++ ----------------
++ Parameters : _parser      command line parser (processed)
++ Returns    : TRUE if the options are valid; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool bParsePoolOptions(const QCommandLineParser &_parser)
+{
+    std::vector<int> cpus;
+
+    if(!_parser.isSet("pool-threads") && !_parser.isSet("pool-affinity"))
+        return true;
+
+    if(_parser.isSet("pool-affinity") && !WorkPool::bAffinitySupported())
+    {
+        qDebug() << "--pool-affinity is not supported on this platform!";
+        return false;
+    }
+
+    if(_parser.isSet("pool-affinity") &&
+       !WorkPool::bParseCpuList(_parser.value("pool-affinity").toStdString(), cpus))
+    {
+        qDebug() << "Bad CPU list:" << _parser.value("pool-affinity");
+        return false;
+    }
+
+    if(!WorkPool::instance().configure(_parser.value("pool-threads").toInt(), cpus))
+    {
+        qDebug() << "Could not pin the pool threads to" << _parser.value("pool-affinity");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ addEncoderOptions() - Add the options of the encoders writing the
++                       output images
++ ----------------
++ Parameters : _parser  command line parser
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void addEncoderOptions(QCommandLineParser &_parser)
+{
+    EncoderOptions defaults = ImageEncoder::defaultOptions();
+
+    _parser.addOptions({
+        { "jpeg-quality", "JPEG quality between 0 and 100", "value", QString::number(defaults.jpegQuality) },
+        { "jpeg-progressive", "Write progressive JPEG files" },
+        { "jpeg-optimize", "Optimize JPEG Huffman tables (smaller files, slower)" },
+        { "png-compression", "PNG compression level between 0 (fastest) and 9 (smallest)", "value",
+          QString::number(defaults.pngCompression) },
+        { "tiff-compression", "TIFF compression: none, lzw, deflate or packbits", "scheme", "lzw" },
+    });
+}
+
+/**
+*************************************************************************
+@verbatim
++ bParseEncoderOptions() - Read the encoder options
++ ----------------
++ Parameters : _parser      command line parser (processed)
++              _options     receives the encoder options
++ Returns    : TRUE if the options are valid; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool bParseEncoderOptions(const QCommandLineParser &_parser, EncoderOptions &_options)
+{
+    QString tiff = _parser.value("tiff-compression");
+
+    _options = ImageEncoder::defaultOptions();
+    _options.jpegQuality = _parser.value("jpeg-quality").toInt();
+    _options.bJpegProgressive = _parser.isSet("jpeg-progressive");
+    _options.bJpegOptimize = _parser.isSet("jpeg-optimize");
+    _options.pngCompression = _parser.value("png-compression").toInt();
+
+    if( (_options.jpegQuality < 0) || (_options.jpegQuality > 100) ||
+        (_options.pngCompression < 0) || (_options.pngCompression > 9) )
+    {
+        qDebug() << "Bad encoder values!";
+        return false;
+    }
+
+    if(tiff == "none")
+        _options.tiffCompression = TiffCompressionNone;
+    else if(tiff == "lzw")
+        _options.tiffCompression = TiffCompressionLzw;
+    else if(tiff == "deflate")
+        _options.tiffCompression = TiffCompressionDeflate;
+    else if(tiff == "packbits")
+        _options.tiffCompression = TiffCompressionPackBits;
+    else
+    {
+        qDebug() << "Unkown TIFF compression:" << tiff;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ runBatchCommandLine() - Parse batch mode arguments and run the batch.
++                         Usage: ImageEnhancer --batch in/ out/ --op nlmeans --threads N
++ ----------------
++ Parameters : _arguments   application arguments
++ Returns    : int process exit code
+@endverbatim
+***************************************************************************/
+int runBatchCommandLine(const QStringList &_arguments)
+{
+    QCommandLineParser parser;
+    BatchProcessor processor;
+    BatchOperation operation;
+    EncoderOptions encoderOptions;
+
+    parser.setApplicationDescription("Headless batch processing of a directory of images");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Directory containing the images to process");
+    parser.addPositionalArgument("output", "Directory receiving the processed images");
+    parser.addOptions({
+        { "batch", "Run in headless batch mode" },
+        { "threads", "Number of files processed in parallel", "N", "0" },
+    });
+    addProcessingOptions(parser);
+    addEncoderOptions(parser);
+
+    parser.process(_arguments);
+
+    if(parser.positionalArguments().size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    if(!bParseProcessingOptions(parser, operation) || !bParseEncoderOptions(parser, encoderOptions))
+        return 1;
+
+    processor.setOperation(operation);
+    processor.setEncoderOptions(encoderOptions);
+    processor.setThreadCount(parser.value("threads").toInt());
+
+    bool bOK = processor.bRun(parser.positionalArguments().at(0), parser.positionalArguments().at(1));
+
+    if(parser.isSet("trace") && !Profiler::bWriteTrace(parser.value("trace")))
+    {
+        bOK = false;
+    }
+
+    return bOK ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QVector>
+
+#include "imagedenoizerapi.h"
+
+typedef struct
+{
+    QString file;
+    bool bOK;
+    double megaPixels;
+    double decodeMs;
+    double processMs;
+    double encodeMs;
+    qint64 outputBytes;
+} BatchResult;
+
+typedef struct
+{
+    // Denoizing (bDenoize FALSE for editing only)
+    bool bDenoize;
+    ProcessType type;
+    ProcessParameters params;
+    // Editing (bEdit FALSE to keep the image untouched)
+    bool bEdit;
+    int brightness;
+    int contrast;
+    // Hue & saturation targets, -1 to keep the image levels
+    int hue;
+    int saturation;
+} BatchOperation;
+
+/*
+ * Headless processing of a whole directory. Files are processed in
+ * parallel (decode, process & encode), results are collected for the
+ * final report.
+ */
+class BatchProcessor
+{
+public:
+    BatchProcessor();
+
+    void setOperation(const BatchOperation &_operation);
+    void setThreadCount(int _threads);
+    void setEncoderOptions(const EncoderOptions &_options);
+
+    bool bRun(QString _inputDir, QString _outputDir);
+
+    // Called by the processing tasks
+    void processFile(const QString &_inputFile, const QString &_outputFile);
+
+    static bool bApplyOperation(const BatchOperation &_operation, const cv::Mat &_in, cv::Mat &_out);
+
+private:
+    void printReport(double _wallMs);
+
+    BatchOperation      m_operation;
+    EncoderOptions      m_encoderOptions;
+    int                 m_threadCount;
+
+    QMutex              m_resultMutex;
+    QVector<BatchResult> m_results;
+};
+
+class QCommandLineParser;
+
+// Denoizing & editing options shared by the headless modes
+void addProcessingOptions(QCommandLineParser &_parser);
+bool bParseProcessingOptions(const QCommandLineParser &_parser, BatchOperation &_operation);
+void addPoolOptions(QCommandLineParser &_parser);
+bool bParsePoolOptions(const QCommandLineParser &_parser);
+void addEncoderOptions(QCommandLineParser &_parser);
+bool bParseEncoderOptions(const QCommandLineParser &_parser, EncoderOptions &_options);
+
+int runBatchCommandLine(const QStringList &_arguments);
+
+#endif // BATCHPROCESSOR_H
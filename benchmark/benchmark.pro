@@ -0,0 +1,54 @@
+#-------------------------------------------------
+#
+# Micro-benchmarks of the ImageProcessor operations
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = ImageEnhancerBenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# Default directory of the real images (--images)
+DEFINES += BENCHMARK_IMAGES_DIR=\\\"$$PWD/../release/Examples_images\\\"
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+    benchmarksuite.cpp \
+    ../imagedenoizerapi.cpp \
+    ../imageframe.cpp \
+    ../resultcache.cpp \
+    ../operationgraph.cpp \
+    ../profiler.cpp \
+    ../imagestore.cpp \
+    ../denoizercomparison.cpp \
+    ../imageencoder.cpp
+
+HEADERS += \
+    benchmarksuite.h \
+    ../imagedenoizerapi.h \
+    ../imageframe.h \
+    ../resultcache.h \
+    ../operationgraph.h \
+    ../profiler.h \
+    ../imagestore.h \
+    ../denoizercomparison.h \
+    ../imageencoder.h
+
+include(../imagecore.pri)
+
+LIBS += -LC:/opencv-mingw/x86/mingw/lib/ \
+                                -lopencv_core410 \
+                                -lopencv_highgui410 \
+                                -lopencv_videoio410 \
+                                -lopencv_imgcodecs410 \
+                                -lopencv_imgproc410 \
+                                -lopencv_photo410
+
+INCLUDEPATH +=  C:/opencv-mingw/include/
@@ -0,0 +1,585 @@
+#include "benchmarksuite.h"
+#include "imagedenoizerapi.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+// Image formats used as real inputs
+static const char *g_benchmarkFilters[] = { "*.jpg", "*.jpeg", "*.png", "*.tif", "*.tiff", "*.bmp" };
+
+BenchmarkSuite::BenchmarkSuite() :
+    m_repetitions(3)
+{
+    m_resolutions << 1 << 12 << 24 << 50;
+    m_threadCounts << 1 << cv::getNumberOfCPUs();
+}
+
+void BenchmarkSuite::setResolutions(const QList<double> &_megaPixels)
+{
+    m_resolutions = _megaPixels;
+}
+
+void BenchmarkSuite::setThreadCounts(const QList<int> &_threads)
+{
+    m_threadCounts = _threads;
+}
+
+void BenchmarkSuite::setImageDir(const QString &_dir)
+{
+    m_imageDir = _dir;
+}
+
+void BenchmarkSuite::setRepetitions(int _repetitions)
+{
+    m_repetitions = std::max(1, _repetitions);
+}
+
+void BenchmarkSuite::setOperations(const QStringList &_operations)
+{
+    m_operations = _operations;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Run every selected benchmark on synthetic images and on the
++          images of the image directory (rescaled), for each resolution
++          and thread count
++ ----------------
++ Parameters : NONE
++ Returns    : TRUE if every operation succeeded; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool BenchmarkSuite::bRun()
+{
+    QTemporaryDir tempDir;
+    QList<QPair<QString, cv::Mat> > sources;
+    bool bOK = true;
+
+    if(!tempDir.isValid())
+    {
+        qWarning() << __func__ << " Could not create temporary directory!";
+        return false;
+    }
+    m_tempDir = tempDir.path();
+
+    // Real inputs, decoded once
+    if(!m_imageDir.isEmpty())
+    {
+        QDir dir(m_imageDir);
+        QStringList filters;
+
+        if(!dir.exists())
+            qWarning() << "No image directory" << m_imageDir << ", synthetic images only";
+
+        for(const char *filter : g_benchmarkFilters)
+        {
+            filters << filter;
+        }
+
+        foreach(const QString &file, dir.entryList(filters, QDir::Files, QDir::Name))
+        {
+            cv::Mat img = cv::imread(dir.filePath(file).toStdString());
+
+            if(img.empty())
+            {
+                qWarning() << "Could not decode" << file;
+                continue;
+            }
+            sources.append(qMakePair(file, img));
+        }
+    }
+
+    m_results = QJsonArray();
+
+    foreach(double megaPixels, m_resolutions)
+    {
+        QList<QPair<QString, cv::Mat> > inputs;
+
+        inputs.append(qMakePair(QString("synthetic"), makeSyntheticImage(megaPixels)));
+        for(int i = 0; i < sources.size(); i++)
+        {
+            inputs.append(qMakePair(sources[i].first, resizeToMegaPixels(sources[i].second, megaPixels)));
+        }
+
+        for(int i = 0; i < inputs.size(); i++)
+        {
+            foreach(int threads, m_threadCounts)
+            {
+                benchInput(inputs[i].first, inputs[i].second, threads);
+            }
+        }
+    }
+
+    for(int i = 0; i < m_results.size(); i++)
+    {
+        bOK = bOK && m_results[i].toObject().value("ok").toBool();
+    }
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ benchInput() - Run every selected benchmark on one input image
++ ----------------
++ Parameters : _input     name of the input
++              _img       input BGR image
++              _threads   number of work pool threads
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void BenchmarkSuite::benchInput(const QString &_input, const cv::Mat &_img, int _threads)
+{
+    const int gaussianKernels[] = { 3, 7, 15 };
+    const int apertures[] = { 3, 5, 7 };
+    const int fastGaussianSigmas[] = { 10, 50, 200 };
+    const int guidedRadii[] = { 2, 8, 32 };
+    const int gridCellSizes[] = { 8, 16, 64 };
+    const char *tierNames[NlMeansTierCount] = { "draft", "balanced", "best" };
+    cv::Mat out;
+
+    // Also caps the OpenCV threads
+    WorkPool::instance().configure(_threads);
+
+    // Denoizing, for each type and a range of kernel/aperture values
+    if(bIsSelected("gaussian"))
+    {
+        for(int kernel : gaussianKernels)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.sigma = 15;
+            params.kernelSizeWidth = kernel;
+            params.kernelSizeHeight = kernel;
+            ImageProcessor::bCheckDenoizeParams(TypeGaussianBlur, params);
+
+            measure("gaussian", QString("kernel=%1").arg(kernel), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeGaussianBlur, params);
+            });
+        }
+    }
+
+    if(bIsSelected("median"))
+    {
+        for(int aperture : apertures)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.aperture = aperture;
+            ImageProcessor::bCheckDenoizeParams(TypeMedianBlur, params);
+
+            measure("median", QString("aperture=%1").arg(aperture), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeMedianBlur, params);
+            });
+        }
+    }
+
+    if(bIsSelected("fastgaussian"))
+    {
+        for(int sigma : fastGaussianSigmas)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.sigma = sigma;
+            ImageProcessor::bCheckDenoizeParams(TypeFastGaussian, params);
+
+            measure("fastgaussian", QString("sigma=%1").arg(sigma), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeFastGaussian, params);
+            });
+        }
+    }
+
+    if(bIsSelected("guided"))
+    {
+        for(int radius : guidedRadii)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.guidedRadius = radius;
+            params.guidedEpsilon = 20;
+            ImageProcessor::bCheckDenoizeParams(TypeGuidedFilter, params);
+
+            measure("guided", QString("radius=%1").arg(radius), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeGuidedFilter, params);
+            });
+        }
+    }
+
+    if(bIsSelected("bilateralgrid"))
+    {
+        for(int cellSize : gridCellSizes)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.gridCellSize = cellSize;
+            params.gridRangeSigma = 24;
+            ImageProcessor::bCheckDenoizeParams(TypeBilateralGrid, params);
+
+            measure("bilateralgrid", QString("cell=%1").arg(cellSize), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeBilateralGrid, params);
+            });
+        }
+    }
+
+    if(bIsSelected("nlmeans"))
+    {
+        for(int tier = 0; tier < NlMeansTierCount; tier++)
+        {
+            ProcessParameters params = ProcessParameters();
+            params.h = 3;
+            params.hColor = 3;
+            ImageProcessor::GetNlMeansTierParameters((NlMeansTier)tier, params);
+            ImageProcessor::bCheckDenoizeParams(TypeNlMeans, params);
+
+            measure("nlmeans", QString("tier=%1").arg(tierNames[tier]), _input, _img, _threads, [&]() {
+                return ImageProcessor::bDenoizeImage(_img, out, TypeNlMeans, params);
+            });
+        }
+    }
+
+    // Editing: LUT only (brightness & contrast) and full (hue & saturation)
+    if(bIsSelected("edit"))
+    {
+        int meanHue = 0;
+        int meanSaturation = 0;
+        ColorEditKernel lutKernel;
+        ColorEditKernel fullKernel;
+
+        ImageProcessor::computeMeanHueSaturation(_img, meanHue, meanSaturation);
+        ImageProcessor::buildEditKernel(lutKernel, 120, 110, meanHue, meanSaturation, meanHue, meanSaturation);
+        ImageProcessor::buildEditKernel(fullKernel, 120, 110, (meanHue + 20) % 180,
+                                        std::min(255, meanSaturation + 30), meanHue, meanSaturation);
+
+        measure("edit", "brightness-contrast", _input, _img, _threads, [&]() {
+            return ImageProcessor::bEditImage(_img, out, lutKernel, false);
+        });
+        measure("edit", "full", _input, _img, _threads, [&]() {
+            return ImageProcessor::bEditImage(_img, out, fullKernel, false);
+        });
+    }
+
+    // Loading as the application does it (probe, reduced paint, decode,
+    // statistics & preview proxy), until imageLoaded() is received
+    if(bIsSelected("load"))
+    {
+        const char *formats[] = { "jpg", "png" };
+        ImageDenoizeAPI api;
+
+        api.start();
+        api.setPreviewSize(581, 351);
+
+        for(const char *format : formats)
+        {
+            QString file = QDir(m_tempDir).filePath(QString("load.%1").arg(format));
+
+            if(!cv::imwrite(file.toStdString(), _img))
+                continue;
+
+            measure("load", format, _input, _img, _threads, [&]() {
+                QEventLoop loop;
+
+                auto failed = [&loop](int _type) { if(_type == JobLoadImage) loop.exit(1); };
+
+                // Queued from the worker thread, received by exec()
+                (void)QObject::connect(&api, &ImageDenoizeAPI::imageLoaded, &loop, [&loop]() { loop.exit(0); });
+                (void)QObject::connect(&api, &ImageDenoizeAPI::jobFailed, &loop, failed);
+                (void)QObject::connect(&api, &ImageDenoizeAPI::jobCancelled, &loop, failed);
+                (void)QObject::connect(&api, &ImageDenoizeAPI::memoryBudgetExceeded, &loop, failed);
+
+                api.requestLoadImage(file);
+                return loop.exec() == 0;
+            });
+        }
+    }
+
+    // Encoding from the Mat, with the encoder settings trading CPU for bytes
+    if(bIsSelected("save"))
+    {
+        EncoderOptions defaults = ImageEncoder::defaultOptions();
+        EncoderOptions jpegOptimized = defaults;
+        EncoderOptions pngSmallest = defaults;
+        EncoderOptions tiffNone = defaults;
+        EncoderOptions tiffDeflate = defaults;
+
+        jpegOptimized.bJpegProgressive = true;
+        jpegOptimized.bJpegOptimize = true;
+        pngSmallest.pngCompression = 9;
+        tiffNone.tiffCompression = TiffCompressionNone;
+        tiffDeflate.tiffCompression = TiffCompressionDeflate;
+
+        struct { const char *variant; const char *suffix; EncoderOptions options; } saves[] = {
+            { "jpg", "jpg", defaults },
+            { "jpg-progressive-optimized", "jpg", jpegOptimized },
+            { "png-1", "png", defaults },
+            { "png-9", "png", pngSmallest },
+            { "tif-none", "tif", tiffNone },
+            { "tif-lzw", "tif", defaults },
+            { "tif-deflate", "tif", tiffDeflate }
+        };
+
+        for(const auto &save : saves)
+        {
+            QString file = QDir(m_tempDir).filePath(QString("save.%1").arg(save.suffix));
+
+            measure("save", save.variant, _input, _img, _threads, [&]() {
+                EncodeResult result;
+                return ImageEncoder::bEncode(_img, file, save.options, result);
+            });
+        }
+    }
+
+    // Mat to QImage conversion & display scaling
+    if(bIsSelected("qimage"))
+    {
+        measure("qimage", "view", _input, _img, _threads, [&]() {
+            return !ImageFrame(_img).toQImage().isNull();
+        });
+        measure("qimage", "copy", _input, _img, _threads, [&]() {
+            return !ImageFrame(_img).toQImage().copy().isNull();
+        });
+        measure("qimage", "scaled-preview", _input, _img, _threads, [&]() {
+            return !ImageFrame(_img).toQImage().scaled(581, 351, Qt::KeepAspectRatio).isNull();
+        });
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ measure() - Run an operation several times and record its timings
++ ----------------
++ Parameters : _operation  name of the operation
++              _variant    parameters of the operation
++              _input      name of the input
++              _img        input image
++              _threads    number of work pool threads
++              _function   operation to measure
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void BenchmarkSuite::measure(const QString &_operation, const QString &_variant, const QString &_input,
+                             const cv::Mat &_img, int _threads, BenchmarkFunction _function)
+{
+    QVector<double> timings;
+    QElapsedTimer timer;
+    QJsonObject result;
+    QJsonArray samples;
+    WorkPoolStats poolStats;
+    double megaPixels = _img.total() / 1e6;
+    bool bOK = true;
+
+    WorkPool::instance().resetStats();
+
+    for(int i = 0; (i < m_repetitions) && bOK; i++)
+    {
+        timer.start();
+        bOK = _function();
+        timings.append(timer.nsecsElapsed() / 1e6);
+        samples.append(timings.last());
+    }
+
+    std::sort(timings.begin(), timings.end());
+    poolStats = WorkPool::instance().stats();
+
+    result["operation"] = _operation;
+    result["variant"] = _variant;
+    result["input"] = _input;
+    result["width"] = _img.cols;
+    result["height"] = _img.rows;
+    result["megapixels"] = megaPixels;
+    result["threads"] = _threads;
+    result["opencv_threads"] = poolStats.opencvThreads;
+    result["pool_tasks"] = (double)poolStats.executed;
+    result["pool_steals"] = (double)poolStats.steals;
+    result["pool_max_queue"] = poolStats.maxQueued;
+    result["ok"] = bOK;
+    result["samples_ms"] = samples;
+    result["min_ms"] = timings.first();
+    result["median_ms"] = timings[timings.size() / 2];
+    result["mp_per_s"] = (timings.first() > 0) ? megaPixels * 1000 / timings.first() : 0;
+
+    m_results.append(result);
+
+    QTextStream(stdout) << _operation << "\t" << _variant << "\t" << _input << "\t"
+                        << QString::number(megaPixels, 'f', 1) << " MP\t" << _threads << " thr\t"
+                        << QString::number(timings.first(), 'f', 2) << " ms"
+                        << (bOK ? "" : "\tFAILED")
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+                        << Qt::endl;
+#else
+                        << endl;
+#endif
+}
+
+bool BenchmarkSuite::bIsSelected(const QString &_operation) const
+{
+    return m_operations.isEmpty() || m_operations.contains(_operation);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bWriteJson() - Write the results and the build description as JSON
++ ----------------
++ Parameters : _file   output file
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool BenchmarkSuite::bWriteJson(const QString &_file) const
+{
+    QJsonObject build;
+    QJsonObject root;
+    QFile file(_file);
+
+    build["qt"] = QString(qVersion());
+    build["opencv"] = QString(CV_VERSION);
+    build["edit_isa"] = QString(colorEditKernelISA());
+    build["filter_isa"] = QString(filterKernelISA());
+    build["cpus"] = cv::getNumberOfCPUs();
+    build["compiled"] = QString(__DATE__ " " __TIME__);
+
+    root["build"] = build;
+    root["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    root["repetitions"] = m_repetitions;
+    root["results"] = m_results;
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << __func__ << " Could not open" << _file;
+        return false;
+    }
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCompare() - Print the speedup of every benchmark found in both result
++              files (baseline min time / current min time)
++ ----------------
++ Parameters : _baselineFile   JSON results of the reference build
++              _currentFile    JSON results of the build to compare
++ Returns    : TRUE if both files could be read; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool BenchmarkSuite::bCompare(const QString &_baselineFile, const QString &_currentFile)
+{
+    QJsonArray results[2];
+    QString files[2] = { _baselineFile, _currentFile };
+    QMap<QString, double> baseline;
+    QTextStream out(stdout);
+
+    for(int i = 0; i < 2; i++)
+    {
+        QFile file(files[i]);
+
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            qWarning() << __func__ << " Could not open" << files[i];
+            return false;
+        }
+        results[i] = QJsonDocument::fromJson(file.readAll()).object().value("results").toArray();
+    }
+
+    for(int i = 0; i < results[0].size(); i++)
+    {
+        QJsonObject result = results[0][i].toObject();
+        baseline.insert(resultKey(result), result.value("min_ms").toDouble());
+    }
+
+    out << "benchmark\tbaseline ms\tcurrent ms\tspeedup\n";
+
+    for(int i = 0; i < results[1].size(); i++)
+    {
+        QJsonObject result = results[1][i].toObject();
+        QString key = resultKey(result);
+        double current = result.value("min_ms").toDouble();
+
+        if(!baseline.contains(key))
+            continue;
+
+        out << key << "\t" << QString::number(baseline[key], 'f', 2) << "\t"
+            << QString::number(current, 'f', 2) << "\t"
+            << QString::number((current > 0) ? baseline[key] / current : 0, 'f', 2) << "x\n";
+    }
+
+    return true;
+}
+
+QString BenchmarkSuite::resultKey(const QJsonObject &_result)
+{
+    return QString("%1/%2/%3/%4MP/%5thr").arg(_result.value("operation").toString())
+                                         .arg(_result.value("variant").toString())
+                                         .arg(_result.value("input").toString())
+                                         .arg(_result.value("megapixels").toDouble(), 0, 'f', 1)
+                                         .arg(_result.value("threads").toInt());
+}
+
+/**
+*************************************************************************
+@verbatim
++ makeSyntheticImage() - Build a reproducible noisy 3:2 BGR image
++ ----------------
++ Parameters : _megaPixels     size of the image
++ Returns    : cv::Mat the image
+@endverbatim
+***************************************************************************/
+cv::Mat BenchmarkSuite::makeSyntheticImage(double _megaPixels)
+{
+    int width = std::max(1, cvRound(std::sqrt(_megaPixels * 1e6 * 3 / 2)));
+    int height = std::max(1, cvRound(_megaPixels * 1e6 / width));
+    cv::Mat gradient(height, width, CV_8UC3);
+    cv::Mat noise(height, width, CV_16SC3);
+    cv::Mat img;
+
+    // Smooth color gradient with gaussian noise on top
+    for(int y = 0; y < height; y++)
+    {
+        cv::Vec3b *row = gradient.ptr<cv::Vec3b>(y);
+
+        for(int x = 0; x < width; x++)
+        {
+            row[x] = cv::Vec3b((uchar)(255 * x / width), (uchar)(255 * y / height), (uchar)(128 + 64 * ((x / 64 + y / 64) % 2)));
+        }
+    }
+
+    cv::theRNG().state = 0x12345678;
+    cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(20));
+    cv::add(gradient, noise, img, cv::noArray(), CV_8UC3);
+
+    return img;
+}
+
+/**
+*************************************************************************
+@verbatim
++ resizeToMegaPixels() - Rescale an image to a size, keeping its aspect
++                        ratio
++ ----------------
++ Parameters : _img            BGR image
++              _megaPixels     target size
++ Returns    : cv::Mat the rescaled image
+@endverbatim
+***************************************************************************/
+cv::Mat BenchmarkSuite::resizeToMegaPixels(const cv::Mat &_img, double _megaPixels)
+{
+    double scale = std::sqrt(_megaPixels * 1e6 / _img.total());
+    cv::Size size(std::max(1, cvRound(_img.cols * scale)), std::max(1, cvRound(_img.rows * scale)));
+    cv::Mat out;
+
+    cv::resize(_img, out, size, 0, 0, (scale < 1.0) ? cv::INTER_AREA : cv::INTER_CUBIC);
+
+    return out;
+}
@@ -0,0 +1,59 @@
+#ifndef BENCHMARKSUITE_H
+#define BENCHMARKSUITE_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+// Measured operation, returns FALSE on failure
+typedef std::function<bool()> BenchmarkFunction;
+
+/*
+ * Micro-benchmarks of every ImageDenoizeAPI operation (denoizing types
+ * and parameter ranges, editing, decoding, encoding & display
+ * conversion) at several resolutions and thread counts. Results are
+ * written as JSON so that two builds can be compared.
+ */
+class BenchmarkSuite
+{
+public:
+    BenchmarkSuite();
+
+    void setResolutions(const QList<double> &_megaPixels);
+    void setThreadCounts(const QList<int> &_threads);
+    void setImageDir(const QString &_dir);
+    void setRepetitions(int _repetitions);
+    void setOperations(const QStringList &_operations);
+
+    bool bRun();
+    bool bWriteJson(const QString &_file) const;
+
+    static bool bCompare(const QString &_baselineFile, const QString &_currentFile);
+
+private:
+    void benchInput(const QString &_input, const cv::Mat &_img, int _threads);
+    void measure(const QString &_operation, const QString &_variant, const QString &_input,
+                 const cv::Mat &_img, int _threads, BenchmarkFunction _function);
+    bool bIsSelected(const QString &_operation) const;
+
+    static cv::Mat makeSyntheticImage(double _megaPixels);
+    static cv::Mat resizeToMegaPixels(const cv::Mat &_img, double _megaPixels);
+    static QString resultKey(const QJsonObject &_result);
+
+    QList<double>   m_resolutions;
+    QList<int>      m_threadCounts;
+    QString         m_imageDir;
+    int             m_repetitions;
+    QStringList     m_operations;
+    QString         m_tempDir;
+
+    QJsonArray      m_results;
+};
+
+#endif // BENCHMARKSUITE_H
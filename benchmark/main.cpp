@@ -0,0 +1,103 @@
+#include "benchmarksuite.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDebug>
+
+#include <cstdio>
+
+// Real images of the repository, set by benchmark.pro
+#ifndef BENCHMARK_IMAGES_DIR
+#define BENCHMARK_IMAGES_DIR "../release/Examples_images"
+#endif
+
+// Processing functions log each call, keep the benchmark output readable
+static bool g_bVerbose = false;
+
+static void messageHandler(QtMsgType _type, const QMessageLogContext &_context, const QString &_msg)
+{
+    Q_UNUSED(_context);
+
+    if( (_type == QtDebugMsg) && !g_bVerbose )
+        return;
+
+    fprintf(stderr, "%s\n", qPrintable(_msg));
+}
+
+static QStringList splitList(const QString &_list)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return _list.split(',', Qt::SkipEmptyParts);
+#else
+    return _list.split(',', QString::SkipEmptyParts);
+#endif
+}
+
+/*
+ * Usage: ImageEnhancerBenchmark --output results.json
+ *                               [--resolutions 1,12,24,50] [--threads 1,4,8]
+ *                               [--images dir (default release/Examples_images, "" for none)] [--reps 3]
+ *                               [--ops gaussian,median,nlmeans,fastgaussian,guided,bilateralgrid,edit,load,save,qimage]
+ *        ImageEnhancerBenchmark --compare baseline.json results.json
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    BenchmarkSuite suite;
+    QList<double> resolutions;
+    QList<int> threads;
+
+    parser.setApplicationDescription("Micro-benchmarks of the ImageDenoizeAPI operations");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "With --compare: baseline and current JSON results");
+    parser.addOptions({
+        { "output", "JSON file receiving the results", "file", "benchmark.json" },
+        { "resolutions", "Comma separated image sizes (MP)", "list", "1,12,24,50" },
+        { "threads", "Comma separated work pool thread counts", "list", "" },
+        { "images", "Directory of real images (rescaled to each size), empty for none", "dir",
+          QDir::cleanPath(BENCHMARK_IMAGES_DIR) },
+        { "reps", "Repetitions of each measure", "N", "3" },
+        { "ops", "Comma separated operations to run (default: all)", "list", "" },
+        { "compare", "Compare two JSON result files" },
+        { "verbose", "Show processing logs" },
+    });
+
+    parser.process(a);
+    g_bVerbose = parser.isSet("verbose");
+    qInstallMessageHandler(messageHandler);
+
+    if(parser.isSet("compare"))
+    {
+        if(parser.positionalArguments().size() != 2)
+        {
+            parser.showHelp(1);
+        }
+        return BenchmarkSuite::bCompare(parser.positionalArguments().at(0), parser.positionalArguments().at(1)) ? 0 : 1;
+    }
+
+    foreach(const QString &value, splitList(parser.value("resolutions")))
+    {
+        resolutions << value.toDouble();
+    }
+    foreach(const QString &value, splitList(parser.value("threads")))
+    {
+        threads << value.toInt();
+    }
+
+    if(!resolutions.isEmpty())
+        suite.setResolutions(resolutions);
+    if(!threads.isEmpty())
+        suite.setThreadCounts(threads);
+    suite.setImageDir(parser.value("images"));
+    suite.setRepetitions(parser.value("reps").toInt());
+    suite.setOperations(splitList(parser.value("ops")));
+
+    bool bOK = suite.bRun();
+
+    if(!suite.bWriteJson(parser.value("output")))
+        return 1;
+
+    return bOK ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+#include <algorithm>
+
+/*
+ * Thread safe FIFO with a fixed capacity, linking two pipeline stages.
+ * push() blocks while the queue is full (back pressure), pop() blocks
+ * while it is empty. Once closed, pop() drains the remaining items then
+ * fails.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int _capacity) :
+        m_capacity(std::max(1, _capacity)),
+        m_maxDepth(0),
+        m_bClosed(false)
+    {
+    }
+
+    // Return FALSE if the queue has been closed
+    bool push(const T &_item)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        while(!m_bClosed && (m_items.size() >= m_capacity))
+        {
+            m_notFull.wait(&m_mutex);
+        }
+
+        if(m_bClosed)
+            return false;
+
+        m_items.enqueue(_item);
+        m_maxDepth = std::max(m_maxDepth, m_items.size());
+        m_notEmpty.wakeOne();
+
+        return true;
+    }
+
+    // Return FALSE once the queue is closed and empty
+    bool pop(T &_item)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        while(!m_bClosed && m_items.isEmpty())
+        {
+            m_notEmpty.wait(&m_mutex);
+        }
+
+        if(m_items.isEmpty())
+            return false;
+
+        _item = m_items.dequeue();
+        m_notFull.wakeOne();
+
+        return true;
+    }
+
+    // No more items will be pushed
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_bClosed = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    int depth() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_items.size();
+    }
+
+    int maxDepth() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_maxDepth;
+    }
+
+    int capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<T> m_items;
+    int m_capacity;
+    int m_maxDepth;
+    bool m_bClosed;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,159 @@
+#include "comparedialog.h"
+
+#include <QPixmap>
+#include <QVBoxLayout>
+
+// Default minimum quality of the recommended method
+#define COMPARE_DEFAULT_THRESHOLD 0.5
+
+CompareDialog::CompareDialog(const QStringList &typeNames, QWidget *parent) :
+    QDialog(parent),
+    m_typeNames(typeNames),
+    m_recommended(-1)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    QHBoxLayout *controls = new QHBoxLayout();
+    QPushButton *buttonClose = new QPushButton("Close", this);
+
+    setWindowTitle("Compare denoizers");
+
+    m_cellsLayout = new QHBoxLayout();
+    m_labelSummary = new QLabel(this);
+    m_spinThreshold = new QDoubleSpinBox(this);
+    m_spinThreshold->setRange(0.0, 1.0);
+    m_spinThreshold->setSingleStep(0.05);
+    m_spinThreshold->setValue(COMPARE_DEFAULT_THRESHOLD);
+    m_spinThreshold->setToolTip("Minimum quality (noise reduction x detail retention) of the recommended method");
+    m_buttonUse = new QPushButton("Use recommended", this);
+
+    controls->addWidget(new QLabel("Quality threshold", this));
+    controls->addWidget(m_spinThreshold);
+    controls->addStretch();
+    controls->addWidget(m_buttonUse);
+    controls->addWidget(buttonClose);
+
+    layout->addLayout(m_cellsLayout);
+    layout->addWidget(m_labelSummary);
+    layout->addLayout(controls);
+
+    (void)QObject::connect(m_spinThreshold, SIGNAL(valueChanged(double)), this, SLOT(updateRecommendation()));
+    (void)QObject::connect(m_buttonUse, SIGNAL(clicked()), this, SLOT(useRecommended()));
+    (void)QObject::connect(buttonClose, SIGNAL(clicked()), this, SLOT(hide()));
+}
+
+/**
+*************************************************************************
+@verbatim
++ setComparison() - Display the results of a comparison: input crop first,
++                   then one cell per method
++ ----------------
++ Parameters : comparison   results to display
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void CompareDialog::setComparison(const Comparison &comparison)
+{
+    QLabel *inputText;
+
+    m_comparison = comparison;
+
+    qDeleteAll(m_cells);
+    m_cells.clear();
+    m_resultLabels.clear();
+
+    inputText = new QLabel(QString("<b>Input</b><br>Noise %1").arg(comparison.inputNoise, 0, 'f', 2), this);
+    m_cells.append(makeCell(comparison.inputCrop, inputText));
+
+    for(int i = 0; i < comparison.results.size(); i++)
+    {
+        QLabel *text = new QLabel(this);
+
+        m_resultLabels.append(text);
+        m_cells.append(makeCell(comparison.results[i].crop, text));
+    }
+
+    for(int i = 0; i < m_cells.size(); i++)
+    {
+        m_cellsLayout->addWidget(m_cells[i]);
+    }
+
+    m_labelSummary->setText(QString("%1 methods run concurrently in %2 ms (1:1 crops at the centre of the image)")
+                            .arg(comparison.results.size()).arg(comparison.wallMs, 0, 'f', 0));
+
+    updateRecommendation();
+}
+
+/**
+*************************************************************************
+@verbatim
++ updateRecommendation() - Select the fastest method meeting the quality
++                          threshold and refresh the result texts
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void CompareDialog::updateRecommendation()
+{
+    m_recommended = DenoizerComparison::recommend(m_comparison, m_spinThreshold->value());
+    m_buttonUse->setEnabled(m_recommended >= 0);
+
+    for(int i = 0; i < m_resultLabels.size(); i++)
+    {
+        const ComparisonResult &result = m_comparison.results[i];
+        QString name = m_typeNames.value(result.candidate.type, QString::number(result.candidate.type));
+        QString text;
+
+        if(result.bOK)
+        {
+            text = QString("<b>%1</b><br>Wall %2 ms<br>CPU %3 ms<br>Noise %4<br>Sharpness %5<br>Quality %6")
+                   .arg(name)
+                   .arg(result.wallMs, 0, 'f', 0)
+                   .arg(result.cpuMs, 0, 'f', 0)
+                   .arg(result.noise, 0, 'f', 2)
+                   .arg(result.sharpness, 0, 'f', 2)
+                   .arg(result.quality, 0, 'f', 2);
+        }
+        else
+        {
+            text = QString("<b>%1</b><br>Failed").arg(name);
+        }
+
+        if(i == m_recommended)
+        {
+            text += "<br><b>Recommended</b>";
+        }
+
+        m_resultLabels[i]->setText(text);
+        m_resultLabels[i]->setStyleSheet((i == m_recommended) ? "QLabel { background-color: #c8e6c9; }" : "");
+    }
+}
+
+void CompareDialog::useRecommended()
+{
+    if(m_recommended >= 0)
+    {
+        emit typeSelected(m_comparison.results[m_recommended].candidate.type);
+    }
+}
+
+QWidget *CompareDialog::makeCell(const ImageFrame &crop, QLabel *text)
+{
+    QWidget *cell = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(cell);
+    QLabel *image = new QLabel(cell);
+
+    if(!crop.isNull())
+    {
+        image->setPixmap(QPixmap::fromImage(crop.toQImage()));
+    }
+
+    text->setParent(cell);
+    text->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+
+    layout->addWidget(image);
+    layout->addWidget(text);
+    layout->addStretch();
+
+    return cell;
+}
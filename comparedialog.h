@@ -0,0 +1,49 @@
+#ifndef COMPAREDIALOG_H
+#define COMPAREDIALOG_H
+
+#include <QDialog>
+#include <QDoubleSpinBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QStringList>
+#include <QVector>
+
+#include "denoizercomparison.h"
+
+/*
+ * Side by side results of a denoizer comparison: 1:1 crops, timings and
+ * quality scores. The recommendation follows the quality threshold.
+ */
+class CompareDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit CompareDialog(const QStringList &typeNames, QWidget *parent = 0);
+
+    void setComparison(const Comparison &comparison);
+
+signals:
+    void typeSelected(int type);
+
+private slots:
+    void updateRecommendation();
+    void useRecommended();
+
+private:
+    QWidget *makeCell(const ImageFrame &crop, QLabel *text);
+
+    QStringList         m_typeNames;
+    Comparison          m_comparison;
+    int                 m_recommended;
+
+    QHBoxLayout         *m_cellsLayout;
+    QVector<QWidget *>  m_cells;
+    QVector<QLabel *>   m_resultLabels;
+    QLabel              *m_labelSummary;
+    QDoubleSpinBox      *m_spinThreshold;
+    QPushButton         *m_buttonUse;
+};
+
+#endif // COMPAREDIALOG_H
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# ImageEnhancerCore: the processing library alone, for services that
+# embed it without Qt. Static by default, "qmake CONFIG+=core_shared"
+# builds a shared library
+#
+#-------------------------------------------------
+
+CONFIG -= qt
+CONFIG += c++11
+
+TARGET = ImageEnhancerCore
+TEMPLATE = lib
+
+core_shared {
+    CONFIG += shared
+} else {
+    CONFIG += staticlib
+}
+
+include(../imagecore.pri)
+
+LIBS += -LC:/opencv-mingw/x86/mingw/lib/ \
+                                -lopencv_core410 \
+                                -lopencv_imgproc410 \
+                                -lopencv_photo410
+
+INCLUDEPATH +=  C:/opencv-mingw/include/
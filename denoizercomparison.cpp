@@ -0,0 +1,275 @@
+#include "denoizercomparison.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+#include "imageprocessor.h"
+#include "tiledexecutor.h"
+#include "workpool.h"
+
+// Tile sides: NlMeans tiles last tens of milliseconds, the other filters
+// are much cheaper per pixel
+#define COMPARE_NLMEANS_TILE_SIZE 256
+#define COMPARE_TILE_SIZE 1024
+// Side of the crops displayed side by side
+#define COMPARE_CROP_SIZE 256
+// Rows of the bands of the noise estimation
+#define COMPARE_NOISE_BAND_ROWS 64
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Denoize an image with every candidate concurrently and score
++          the outputs. Only the crops of the outputs are kept
++ ----------------
++ Parameters : _in          input BGR image (read-only, shared by all)
++              _candidates  checked methods & parameters to compare
++              _comparison  receives the results, in candidate order
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool DenoizerComparison::bRun(const cv::Mat &_in, const QVector<DenoizeCandidate> &_candidates, Comparison &_comparison,
+                              TaskControl *_control)
+{
+    int count = _candidates.size();
+    std::vector<TiledExecutor> executors(count);
+    std::vector<TileFunction> functions(count);
+    std::vector<cv::Mat> outputs(count);
+    std::vector<cv::Vec2i> tiles;
+    std::unique_ptr<std::atomic<int>[]> remainingTiles(new std::atomic<int>[count]);
+    std::unique_ptr<std::atomic<int64>[]> tileTicks(new std::atomic<int64>[count]);
+    std::unique_ptr<std::atomic<bool>[]> bFailed(new std::atomic<bool>[count]);
+    std::vector<double> wallMs(count, 0);
+    std::atomic<int> doneTiles(0);
+    int maxTiles = 0;
+    cv::Rect crop = cropRect(_in);
+    double inputEnergy;
+    QElapsedTimer timer;
+
+    if(_in.empty() || (count == 0))
+        return false;
+
+    timer.start();
+
+    for(int c = 0; c < count; c++)
+    {
+        const DenoizeCandidate &candidate = _candidates[c];
+
+        executors[c].setTileSize((candidate.type == TypeNlMeans) ? COMPARE_NLMEANS_TILE_SIZE : COMPARE_TILE_SIZE);
+        executors[c].setHalo(ImageProcessor::GetProcessHalo(candidate.type, candidate.params));
+        functions[c] = ImageProcessor::GetDenoizeFunction(candidate.type, candidate.params);
+        outputs[c].create(_in.size(), _in.type());
+        remainingTiles[c] = executors[c].tileCount(_in);
+        tileTicks[c] = 0;
+        bFailed[c] = false;
+        maxTiles = std::max(maxTiles, (int)remainingTiles[c]);
+    }
+
+    // Round robin over the methods, so that they all progress together
+    for(int t = 0; t < maxTiles; t++)
+    {
+        for(int c = 0; c < count; c++)
+        {
+            if(t < executors[c].tileCount(_in))
+                tiles.push_back(cv::Vec2i(c, t));
+        }
+    }
+
+    // One stripe per tile: processing inside a tile is not parallelized
+    // again (serial scope), so a tile duration is its CPU time
+    WorkPool::instance().parallelFor((int)tiles.size(), [&](int _begin, int _end)
+    {
+        WorkPool::SerialScope serial;
+
+        for(int i = _begin; i < _end; i++)
+        {
+            int c = tiles[i][0];
+            int64 start;
+
+            if( (_control != nullptr) && _control->bIsCancelled() )
+                return;
+
+            start = cv::getTickCount();
+            if(!executors[c].bRunTile(_in, outputs[c], tiles[i][1], functions[c]))
+                bFailed[c] = true;
+            tileTicks[c] += cv::getTickCount() - start;
+
+            if(--remainingTiles[c] == 0)
+                wallMs[c] = timer.nsecsElapsed() / 1e6;
+
+            if(_control != nullptr)
+                _control->setProgress(++doneTiles, (long long)tiles.size());
+        }
+    }, (int)tiles.size());
+
+    if( (_control != nullptr) && _control->bIsCancelled() )
+        return false;
+
+    _comparison.results.clear();
+    _comparison.inputNoise = estimateNoise(_in);
+    _comparison.inputCrop = ImageFrame(_in(crop).clone());
+    inputEnergy = gradientEnergy(_in);
+
+    for(int c = 0; c < count; c++)
+    {
+        ComparisonResult result;
+        double noiseReduction = 0;
+
+        result.candidate = _candidates[c];
+        result.bOK = !bFailed[c];
+        result.wallMs = wallMs[c];
+        result.cpuMs = tileTicks[c] * 1000.0 / cv::getTickFrequency();
+        result.noise = result.bOK ? estimateNoise(outputs[c]) : 0;
+        result.sharpness = (result.bOK && (inputEnergy > 0)) ? gradientEnergy(outputs[c]) / inputEnergy : 0;
+
+        if(_comparison.inputNoise > 0)
+            noiseReduction = std::min(std::max(1.0 - result.noise / _comparison.inputNoise, 0.0), 1.0);
+        result.quality = result.bOK ? noiseReduction * std::min(std::max(result.sharpness, 0.0), 1.0) : 0;
+
+        if(result.bOK)
+            result.crop = ImageFrame(outputs[c](crop).clone());
+
+        // Full size output is not needed anymore
+        outputs[c].release();
+
+        qDebug() << "Compare" << c << ": wall" << result.wallMs << "ms, cpu" << result.cpuMs << "ms, noise"
+                 << result.noise << ", sharpness" << result.sharpness << ", quality" << result.quality;
+
+        _comparison.results.append(result);
+    }
+
+    _comparison.wallMs = timer.nsecsElapsed() / 1e6;
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ recommend() - Select the method with the lowest CPU time among those
++               reaching the quality threshold. If none reaches it, the
++               best quality is selected
++ ----------------
++ Parameters : _comparison          results of a comparison
++              _qualityThreshold    minimum quality, between 0 and 1
++ Returns    : int index of the recommended result; -1 if none succeeded
+@endverbatim
+***************************************************************************/
+int DenoizerComparison::recommend(const Comparison &_comparison, double _qualityThreshold)
+{
+    int fastest = -1;
+    int best = -1;
+
+    for(int i = 0; i < _comparison.results.size(); i++)
+    {
+        const ComparisonResult &result = _comparison.results[i];
+
+        if(!result.bOK)
+            continue;
+
+        if( (result.quality >= _qualityThreshold) &&
+            ((fastest < 0) || (result.cpuMs < _comparison.results[fastest].cpuMs)) )
+        {
+            fastest = i;
+        }
+
+        if( (best < 0) || (result.quality > _comparison.results[best].quality) )
+            best = i;
+    }
+
+    return (fastest >= 0) ? fastest : best;
+}
+
+/**
+*************************************************************************
+@verbatim
++ estimateNoise() - Estimate the standard deviation of the noise of an
++                   image (Immerkaer): the luma is filtered by a mask
++                   cancelling smooth variations, the mean absolute
++                   response is proportional to sigma. Row bands keep the
++                   float response small
++ ----------------
++ Parameters : _img     BGR image
++ Returns    : double the estimated sigma, in levels
+@endverbatim
+***************************************************************************/
+double DenoizerComparison::estimateNoise(const cv::Mat &_img)
+{
+    cv::Mat gray;
+    cv::Mat mask = (cv::Mat_<float>(3, 3) << 1, -2, 1, -2, 4, -2, 1, -2, 1);
+    std::mutex mutex;
+    double sum = 0;
+    int bands;
+
+    if( (_img.cols < 3) || (_img.rows < 3) )
+        return 0;
+
+    cv::cvtColor(_img, gray, cv::COLOR_BGR2GRAY);
+    bands = (gray.rows - 2 + COMPARE_NOISE_BAND_ROWS - 1) / COMPARE_NOISE_BAND_ROWS;
+
+    WorkPool::instance().parallelFor(bands, [&](int _begin, int _end)
+    {
+        double localSum = 0;
+
+        for(int band = _begin; band < _end; band++)
+        {
+            // Interior rows only, extended by one row for the mask
+            int first = 1 + band * COMPARE_NOISE_BAND_ROWS;
+            int last = std::min(first + COMPARE_NOISE_BAND_ROWS, gray.rows - 1);
+            cv::Mat response;
+
+            cv::filter2D(gray.rowRange(first - 1, last + 1), response, CV_32F, mask);
+            localSum += cv::norm(response(cv::Rect(1, 1, gray.cols - 2, last - first)), cv::NORM_L1);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        sum += localSum;
+    });
+
+    return sum * std::sqrt(CV_PI / 2) / (6.0 * (gray.cols - 2) * (gray.rows - 2));
+}
+
+/**
+*************************************************************************
+@verbatim
++ gradientEnergy() - Return the mean squared gradient of the luma at half
++                    size, where fine grain noise is mostly averaged out
++                    and edges & textures remain
++ ----------------
++ Parameters : _img     BGR image
++ Returns    : double the gradient energy
+@endverbatim
+***************************************************************************/
+double DenoizerComparison::gradientEnergy(const cv::Mat &_img)
+{
+    cv::Mat gray;
+    cv::Mat half;
+    cv::Mat dx;
+    cv::Mat dy;
+
+    if(_img.empty())
+        return 0;
+
+    cv::cvtColor(_img, gray, cv::COLOR_BGR2GRAY);
+    cv::resize(gray, half, cv::Size(std::max(1, gray.cols / 2), std::max(1, gray.rows / 2)), 0, 0, cv::INTER_AREA);
+    cv::Sobel(half, dx, CV_32F, 1, 0);
+    cv::Sobel(half, dy, CV_32F, 0, 1);
+
+    return cv::mean(dx.mul(dx) + dy.mul(dy))[0];
+}
+
+cv::Rect DenoizerComparison::cropRect(const cv::Mat &_img)
+{
+    int width = std::min(COMPARE_CROP_SIZE, _img.cols);
+    int height = std::min(COMPARE_CROP_SIZE, _img.rows);
+
+    return cv::Rect((_img.cols - width) / 2, (_img.rows - height) / 2, width, height);
+}
@@ -0,0 +1,70 @@
+#ifndef DENOIZERCOMPARISON_H
+#define DENOIZERCOMPARISON_H
+
+#include <QMetaType>
+#include <QVector>
+
+#include <opencv2/core.hpp>
+
+#include "imageframe.h"
+#include "processtypes.h"
+#include "taskcontrol.h"
+
+typedef struct
+{
+    ProcessType type;
+    ProcessParameters params;
+} DenoizeCandidate;
+
+typedef struct
+{
+    DenoizeCandidate candidate;
+    bool bOK;
+    // From the start of the comparison to the last tile of the method
+    double wallMs;
+    // Sum of the tile durations (each tile runs on a single thread)
+    double cpuMs;
+    // Estimated noise standard deviation of the output
+    double noise;
+    // Gradient energy of the output relative to the input, at half size
+    double sharpness;
+    // Noise reduction x detail retention, between 0 and 1
+    double quality;
+    // 1:1 crop of the output at the centre of the image
+    ImageFrame crop;
+} ComparisonResult;
+
+typedef struct
+{
+    QVector<ComparisonResult> results;
+    // Estimated noise standard deviation of the input
+    double inputNoise;
+    double wallMs;
+    // 1:1 crop of the input, same area as the result crops
+    ImageFrame inputCrop;
+} Comparison;
+
+Q_DECLARE_METATYPE(Comparison)
+
+/*
+ * Run several denoizings concurrently on one read-only input: the tiles
+ * of all the methods share a single pool, interleaved so that the
+ * methods progress together. Outputs are scored with no-reference
+ * metrics (noise estimate, detail retention) to recommend a method.
+ */
+class DenoizerComparison
+{
+public:
+    static bool bRun(const cv::Mat &_in, const QVector<DenoizeCandidate> &_candidates, Comparison &_comparison,
+                     TaskControl *_control = nullptr);
+    static int recommend(const Comparison &_comparison, double _qualityThreshold);
+
+    // No-reference metrics
+    static double estimateNoise(const cv::Mat &_img);
+    static double gradientEnergy(const cv::Mat &_img);
+
+private:
+    static cv::Rect cropRect(const cv::Mat &_img);
+};
+
+#endif // DENOIZERCOMPARISON_H
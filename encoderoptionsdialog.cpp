@@ -0,0 +1,87 @@
+#include "encoderoptionsdialog.h"
+
+#include <algorithm>
+
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QVBoxLayout>
+
+EncoderOptionsDialog::EncoderOptionsDialog(QWidget *parent) :
+    QDialog(parent)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    QFormLayout *jpegLayout;
+    QFormLayout *pngLayout;
+    QFormLayout *tiffLayout;
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+
+    setWindowTitle("Encoder options");
+
+    m_groupJpeg = new QGroupBox("JPEG", this);
+    m_spinJpegQuality = new QSpinBox(m_groupJpeg);
+    m_spinJpegQuality->setRange(0, 100);
+    m_checkJpegProgressive = new QCheckBox("Progressive", m_groupJpeg);
+    m_checkJpegOptimize = new QCheckBox("Optimized Huffman tables", m_groupJpeg);
+    m_checkJpegOptimize->setToolTip("Smaller files for a slightly longer encoding");
+    jpegLayout = new QFormLayout(m_groupJpeg);
+    jpegLayout->addRow("Quality", m_spinJpegQuality);
+    jpegLayout->addRow(m_checkJpegProgressive);
+    jpegLayout->addRow(m_checkJpegOptimize);
+
+    m_groupPng = new QGroupBox("PNG", this);
+    m_spinPngCompression = new QSpinBox(m_groupPng);
+    m_spinPngCompression->setRange(0, 9);
+    m_spinPngCompression->setToolTip("0: fastest, 9: smallest file");
+    pngLayout = new QFormLayout(m_groupPng);
+    pngLayout->addRow("Compression level", m_spinPngCompression);
+
+    m_groupTiff = new QGroupBox("TIFF", this);
+    m_comboTiffCompression = new QComboBox(m_groupTiff);
+    m_comboTiffCompression->addItem("None", TiffCompressionNone);
+    m_comboTiffCompression->addItem("LZW", TiffCompressionLzw);
+    m_comboTiffCompression->addItem("Deflate", TiffCompressionDeflate);
+    m_comboTiffCompression->addItem("PackBits", TiffCompressionPackBits);
+    tiffLayout = new QFormLayout(m_groupTiff);
+    tiffLayout->addRow("Compression", m_comboTiffCompression);
+
+    layout->addWidget(m_groupJpeg);
+    layout->addWidget(m_groupPng);
+    layout->addWidget(m_groupTiff);
+    layout->addWidget(buttons);
+
+    setOptions(ImageEncoder::defaultOptions());
+
+    (void)QObject::connect(buttons, SIGNAL(accepted()), this, SLOT(accept()));
+    (void)QObject::connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+}
+
+void EncoderOptionsDialog::setFormat(const QString &suffix)
+{
+    QString format = suffix.toLower();
+
+    m_groupJpeg->setEnabled( (format == "jpg") || (format == "jpeg") );
+    m_groupPng->setEnabled(format == "png");
+    m_groupTiff->setEnabled( (format == "tif") || (format == "tiff") );
+}
+
+void EncoderOptionsDialog::setOptions(const EncoderOptions &options)
+{
+    m_spinJpegQuality->setValue(options.jpegQuality);
+    m_checkJpegProgressive->setChecked(options.bJpegProgressive);
+    m_checkJpegOptimize->setChecked(options.bJpegOptimize);
+    m_spinPngCompression->setValue(options.pngCompression);
+    m_comboTiffCompression->setCurrentIndex(std::max(m_comboTiffCompression->findData(options.tiffCompression), 0));
+}
+
+EncoderOptions EncoderOptionsDialog::options() const
+{
+    EncoderOptions options;
+
+    options.jpegQuality = m_spinJpegQuality->value();
+    options.bJpegProgressive = m_checkJpegProgressive->isChecked();
+    options.bJpegOptimize = m_checkJpegOptimize->isChecked();
+    options.pngCompression = m_spinPngCompression->value();
+    options.tiffCompression = (TiffCompression)m_comboTiffCompression->currentData().toInt();
+
+    return options;
+}
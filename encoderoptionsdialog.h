@@ -0,0 +1,38 @@
+#ifndef ENCODEROPTIONSDIALOG_H
+#define ENCODEROPTIONSDIALOG_H
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialog>
+#include <QGroupBox>
+#include <QSpinBox>
+
+#include "imageencoder.h"
+
+/*
+ * Encoder settings of a save: JPEG quality & flags, PNG compression level,
+ * TIFF compression. Only the settings of the chosen format are enabled.
+ */
+class EncoderOptionsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit EncoderOptionsDialog(QWidget *parent = 0);
+
+    void setFormat(const QString &suffix);
+    void setOptions(const EncoderOptions &options);
+    EncoderOptions options() const;
+
+private:
+    QGroupBox   *m_groupJpeg;
+    QGroupBox   *m_groupPng;
+    QGroupBox   *m_groupTiff;
+    QSpinBox    *m_spinJpegQuality;
+    QCheckBox   *m_checkJpegProgressive;
+    QCheckBox   *m_checkJpegOptimize;
+    QSpinBox    *m_spinPngCompression;
+    QComboBox   *m_comboTiffCompression;
+};
+
+#endif // ENCODEROPTIONSDIALOG_H
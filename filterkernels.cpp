@@ -0,0 +1,1028 @@
+#include "filterkernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FILTERKERNELS_X86
+#include <immintrin.h>
+// Vector types only cross the generic templates below once they are
+// inlined into the entry point of their instruction set (flatten)
+#pragma GCC diagnostic ignored "-Wpsabi"
+// Spurious with the AVX-512 conversions of GCC 12 headers (undefined upper lanes)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#ifdef __GNUC__
+#define FILTER_FLATTEN __attribute__((flatten))
+#else
+#define FILTER_FLATTEN
+#endif
+
+// Largest specialized kernel size
+#define FILTER_MAX_SIZE 7
+
+// Fixed point taps of the Gaussian: 8 fractional bits per pass
+#define FILTER_TAP_BITS 8
+
+typedef struct
+{
+    const unsigned char *src;
+    int srcStride;
+    unsigned char *dst;
+    int dstStride;
+    int width;
+    int height;
+    int firstRow;
+    int rows;
+} FilterImage;
+
+/*
+ * Operations of each instruction set used by the generic kernels:
+ * - bytes (median): ByteLanes per vector
+ * - Gaussian horizontal pass: bytes widened to 16-bit words, WordLanes per
+ *   vector, multiplied by the taps & summed (no overflow: taps sum to 256)
+ * - Gaussian vertical pass: words accumulated in 32 bits, rounded & packed
+ *   back to bytes, WordLanes per accumulator
+ */
+struct KernelOpsScalar
+{
+    typedef unsigned char VecU8;
+    typedef unsigned short VecU16;
+    typedef unsigned int Tap32;
+    typedef unsigned int Acc;
+    enum { ByteLanes = 1, WordLanes = 1 };
+
+    static inline VecU8 load(const unsigned char *_p) { return *_p; }
+    static inline void store(unsigned char *_p, VecU8 _v) { *_p = _v; }
+    static inline VecU8 min(VecU8 _a, VecU8 _b) { return (_a < _b) ? _a : _b; }
+    static inline VecU8 max(VecU8 _a, VecU8 _b) { return (_a < _b) ? _b : _a; }
+
+    static inline VecU16 tap16(unsigned short _tap) { return _tap; }
+    static inline VecU16 zero16() { return 0; }
+    static inline VecU16 widen(const unsigned char *_p) { return *_p; }
+    static inline VecU16 madd16(VecU16 _sum, VecU16 _a, VecU16 _tap) { return (VecU16)(_sum + _a * _tap); }
+    static inline void store16(unsigned short *_p, VecU16 _v) { *_p = _v; }
+
+    static inline Tap32 tap32(unsigned int _tap) { return _tap; }
+    static inline Acc accZero() { return 0; }
+    static inline void accMadd(Acc &_acc, const unsigned short *_p, Tap32 _tap) { _acc += *_p * _tap; }
+    static inline void accStore(unsigned char *_p, const Acc &_acc)
+    {
+        *_p = (unsigned char)((_acc + (1u << (2 * FILTER_TAP_BITS - 1))) >> (2 * FILTER_TAP_BITS));
+    }
+};
+
+#ifdef FILTERKERNELS_X86
+struct KernelOpsSSE4
+{
+    typedef __m128i VecU8;
+    typedef __m128i VecU16;
+    typedef __m128i Tap32;
+    typedef struct { __m128i lo; __m128i hi; } Acc;
+    enum { ByteLanes = 16, WordLanes = 8 };
+
+    __attribute__((target("sse4.1"))) static inline VecU8 load(const unsigned char *_p)
+    {
+        return _mm_loadu_si128((const __m128i *)_p);
+    }
+    __attribute__((target("sse4.1"))) static inline void store(unsigned char *_p, VecU8 _v)
+    {
+        _mm_storeu_si128((__m128i *)_p, _v);
+    }
+    __attribute__((target("sse4.1"))) static inline VecU8 min(VecU8 _a, VecU8 _b) { return _mm_min_epu8(_a, _b); }
+    __attribute__((target("sse4.1"))) static inline VecU8 max(VecU8 _a, VecU8 _b) { return _mm_max_epu8(_a, _b); }
+
+    __attribute__((target("sse4.1"))) static inline VecU16 tap16(unsigned short _tap) { return _mm_set1_epi16((short)_tap); }
+    __attribute__((target("sse4.1"))) static inline VecU16 zero16() { return _mm_setzero_si128(); }
+    __attribute__((target("sse4.1"))) static inline VecU16 widen(const unsigned char *_p)
+    {
+        return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)_p));
+    }
+    __attribute__((target("sse4.1"))) static inline VecU16 madd16(VecU16 _sum, VecU16 _a, VecU16 _tap)
+    {
+        return _mm_add_epi16(_sum, _mm_mullo_epi16(_a, _tap));
+    }
+    __attribute__((target("sse4.1"))) static inline void store16(unsigned short *_p, VecU16 _v)
+    {
+        _mm_storeu_si128((__m128i *)_p, _v);
+    }
+
+    __attribute__((target("sse4.1"))) static inline Tap32 tap32(unsigned int _tap) { return _mm_set1_epi32((int)_tap); }
+    __attribute__((target("sse4.1"))) static inline Acc accZero()
+    {
+        Acc acc = { _mm_setzero_si128(), _mm_setzero_si128() };
+        return acc;
+    }
+    __attribute__((target("sse4.1"))) static inline void accMadd(Acc &_acc, const unsigned short *_p, Tap32 _tap)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i *)_p);
+
+        _acc.lo = _mm_add_epi32(_acc.lo, _mm_mullo_epi32(_mm_cvtepu16_epi32(words), _tap));
+        _acc.hi = _mm_add_epi32(_acc.hi, _mm_mullo_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(words, 8)), _tap));
+    }
+    __attribute__((target("sse4.1"))) static inline void accStore(unsigned char *_p, const Acc &_acc)
+    {
+        const __m128i round = _mm_set1_epi32(1 << (2 * FILTER_TAP_BITS - 1));
+        __m128i lo = _mm_srli_epi32(_mm_add_epi32(_acc.lo, round), 2 * FILTER_TAP_BITS);
+        __m128i hi = _mm_srli_epi32(_mm_add_epi32(_acc.hi, round), 2 * FILTER_TAP_BITS);
+        __m128i words = _mm_packus_epi32(lo, hi);
+
+        _mm_storel_epi64((__m128i *)_p, _mm_packus_epi16(words, words));
+    }
+};
+
+struct KernelOpsAVX2
+{
+    typedef __m256i VecU8;
+    typedef __m256i VecU16;
+    typedef __m256i Tap32;
+    typedef struct { __m256i lo; __m256i hi; } Acc;
+    enum { ByteLanes = 32, WordLanes = 16 };
+
+    __attribute__((target("avx2"))) static inline VecU8 load(const unsigned char *_p)
+    {
+        return _mm256_loadu_si256((const __m256i *)_p);
+    }
+    __attribute__((target("avx2"))) static inline void store(unsigned char *_p, VecU8 _v)
+    {
+        _mm256_storeu_si256((__m256i *)_p, _v);
+    }
+    __attribute__((target("avx2"))) static inline VecU8 min(VecU8 _a, VecU8 _b) { return _mm256_min_epu8(_a, _b); }
+    __attribute__((target("avx2"))) static inline VecU8 max(VecU8 _a, VecU8 _b) { return _mm256_max_epu8(_a, _b); }
+
+    __attribute__((target("avx2"))) static inline VecU16 tap16(unsigned short _tap) { return _mm256_set1_epi16((short)_tap); }
+    __attribute__((target("avx2"))) static inline VecU16 zero16() { return _mm256_setzero_si256(); }
+    __attribute__((target("avx2"))) static inline VecU16 widen(const unsigned char *_p)
+    {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)_p));
+    }
+    __attribute__((target("avx2"))) static inline VecU16 madd16(VecU16 _sum, VecU16 _a, VecU16 _tap)
+    {
+        return _mm256_add_epi16(_sum, _mm256_mullo_epi16(_a, _tap));
+    }
+    __attribute__((target("avx2"))) static inline void store16(unsigned short *_p, VecU16 _v)
+    {
+        _mm256_storeu_si256((__m256i *)_p, _v);
+    }
+
+    __attribute__((target("avx2"))) static inline Tap32 tap32(unsigned int _tap) { return _mm256_set1_epi32((int)_tap); }
+    __attribute__((target("avx2"))) static inline Acc accZero()
+    {
+        Acc acc = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+        return acc;
+    }
+    __attribute__((target("avx2"))) static inline void accMadd(Acc &_acc, const unsigned short *_p, Tap32 _tap)
+    {
+        __m256i words = _mm256_loadu_si256((const __m256i *)_p);
+
+        _acc.lo = _mm256_add_epi32(_acc.lo, _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(words)), _tap));
+        _acc.hi = _mm256_add_epi32(_acc.hi, _mm256_mullo_epi32(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1)), _tap));
+    }
+    __attribute__((target("avx2"))) static inline void accStore(unsigned char *_p, const Acc &_acc)
+    {
+        const __m256i round = _mm256_set1_epi32(1 << (2 * FILTER_TAP_BITS - 1));
+        __m256i lo = _mm256_srli_epi32(_mm256_add_epi32(_acc.lo, round), 2 * FILTER_TAP_BITS);
+        __m256i hi = _mm256_srli_epi32(_mm256_add_epi32(_acc.hi, round), 2 * FILTER_TAP_BITS);
+        // Packing works within 128-bit lanes: restore the order of the words
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+
+        _mm_storeu_si128((__m128i *)_p, _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                                         _mm256_extracti128_si256(words, 1)));
+    }
+};
+
+struct KernelOpsAVX512
+{
+    typedef __m512i VecU8;
+    typedef __m512i VecU16;
+    typedef __m512i Tap32;
+    typedef struct { __m512i lo; __m512i hi; } Acc;
+    enum { ByteLanes = 64, WordLanes = 32 };
+
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU8 load(const unsigned char *_p)
+    {
+        return _mm512_loadu_si512((const void *)_p);
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline void store(unsigned char *_p, VecU8 _v)
+    {
+        _mm512_storeu_si512((void *)_p, _v);
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU8 min(VecU8 _a, VecU8 _b) { return _mm512_min_epu8(_a, _b); }
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU8 max(VecU8 _a, VecU8 _b) { return _mm512_max_epu8(_a, _b); }
+
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU16 tap16(unsigned short _tap)
+    {
+        return _mm512_set1_epi16((short)_tap);
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU16 zero16() { return _mm512_setzero_si512(); }
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU16 widen(const unsigned char *_p)
+    {
+        return _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)_p));
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline VecU16 madd16(VecU16 _sum, VecU16 _a, VecU16 _tap)
+    {
+        return _mm512_add_epi16(_sum, _mm512_mullo_epi16(_a, _tap));
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline void store16(unsigned short *_p, VecU16 _v)
+    {
+        _mm512_storeu_si512((void *)_p, _v);
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) static inline Tap32 tap32(unsigned int _tap)
+    {
+        return _mm512_set1_epi32((int)_tap);
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline Acc accZero()
+    {
+        Acc acc = { _mm512_setzero_si512(), _mm512_setzero_si512() };
+        return acc;
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline void accMadd(Acc &_acc, const unsigned short *_p, Tap32 _tap)
+    {
+        __m512i lo = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)_p));
+        __m512i hi = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(_p + 16)));
+
+        _acc.lo = _mm512_add_epi32(_acc.lo, _mm512_mullo_epi32(lo, _tap));
+        _acc.hi = _mm512_add_epi32(_acc.hi, _mm512_mullo_epi32(hi, _tap));
+    }
+    __attribute__((target("avx512f,avx512bw"))) static inline void accStore(unsigned char *_p, const Acc &_acc)
+    {
+        const __m512i round = _mm512_set1_epi32(1 << (2 * FILTER_TAP_BITS - 1));
+        __m512i lo = _mm512_srli_epi32(_mm512_add_epi32(_acc.lo, round), 2 * FILTER_TAP_BITS);
+        __m512i hi = _mm512_srli_epi32(_mm512_add_epi32(_acc.hi, round), 2 * FILTER_TAP_BITS);
+
+        _mm_storeu_si128((__m128i *)_p, _mm512_cvtepi32_epi8(lo));
+        _mm_storeu_si128((__m128i *)(_p + 16), _mm512_cvtepi32_epi8(hi));
+    }
+};
+#endif
+
+/**
+*************************************************************************
+@verbatim
++ borderIndex() - Map a row or column index outside of the image to the
++                 one it reads
++ ----------------
++ Parameters : _index   index, may be outside of [0, _length)
++              _length  number of rows or columns
++              _bReflect TRUE to reflect without repeating the edge
++                       (cv::BORDER_REFLECT_101), FALSE to replicate it
++ Returns    : int the index inside of the image
+@endverbatim
+***************************************************************************/
+static inline int borderIndex(int _index, int _length, bool _bReflect)
+{
+    if(_length == 1)
+        return 0;
+
+    if(!_bReflect)
+        return std::min(std::max(_index, 0), _length - 1);
+
+    while( (_index < 0) || (_index >= _length) )
+    {
+        if(_index < 0)
+            _index = -_index;
+        if(_index >= _length)
+            _index = 2 * _length - 2 - _index;
+    }
+
+    return _index;
+}
+
+/**
+*************************************************************************
+@verbatim
++ padRow() - Copy a BGR row extended by _radius pixels on both sides
++ ----------------
++ Parameters : _src     source row
++              _width   width of the row in pixels
++              _radius  pixels added on each side
++              _bReflect border mode, see borderIndex()
++              _dst     destination, (_width + 2 * _radius) pixels
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void padRow(const unsigned char *_src, int _width, int _radius, bool _bReflect, unsigned char *_dst)
+{
+    std::memcpy(_dst + 3 * _radius, _src, 3 * (size_t)_width);
+
+    for(int x = 1; x <= _radius; x++)
+    {
+        std::memcpy(_dst + 3 * (_radius - x), _src + 3 * borderIndex(-x, _width, _bReflect), 3);
+        std::memcpy(_dst + 3 * (_radius + _width - 1 + x), _src + 3 * borderIndex(_width - 1 + x, _width, _bReflect), 3);
+    }
+}
+
+/*
+ * Row buffers indexed by source row: a row prepared once is kept while the
+ * next output rows need it. The rows of a window are within _slots
+ * consecutive indices, so they never share a slot
+ */
+template<typename T>
+class RowRing
+{
+public:
+    RowRing(int _length, int _slots) :
+        m_length(_length),
+        m_buffer((size_t)_length * _slots),
+        m_rows(_slots, -1)
+    {
+    }
+
+    // Buffer of the row, _bFill set when it has to be prepared
+    T *row(int _index, bool &_bFill)
+    {
+        int slot = _index % (int)m_rows.size();
+
+        _bFill = (m_rows[slot] != _index);
+        m_rows[slot] = _index;
+
+        return &m_buffer[(size_t)slot * m_length];
+    }
+
+private:
+    int m_length;
+    std::vector<T> m_buffer;
+    std::vector<int> m_rows;
+};
+
+template<class Ops>
+static inline void sortPair(typename Ops::VecU8 &_a, typename Ops::VecU8 &_b)
+{
+    typename Ops::VecU8 low = Ops::min(_a, _b);
+
+    _b = Ops::max(_a, _b);
+    _a = low;
+}
+
+/*
+ * Forgetful selection unrolled at compile time: Size values are kept, the
+ * minimum is moved to the first one and the maximum to the last one, the
+ * next value M of the window replaces the minimum and the maximum is
+ * forgotten. Ends with the median of the last three values
+ */
+template<class Ops, int J, int Size>
+struct MinimumPass
+{
+    static inline void run(typename Ops::VecU8 *_v)
+    {
+        sortPair<Ops>(_v[0], _v[J]);
+        MinimumPass<Ops, J + 1, Size>::run(_v);
+    }
+};
+
+template<class Ops, int Size>
+struct MinimumPass<Ops, Size, Size>
+{
+    static inline void run(typename Ops::VecU8 *) {}
+};
+
+template<class Ops, int J, int Size>
+struct MaximumPass
+{
+    static inline void run(typename Ops::VecU8 *_v)
+    {
+        sortPair<Ops>(_v[J], _v[Size - 1]);
+        MaximumPass<Ops, J + 1, Size>::run(_v);
+    }
+};
+
+template<class Ops, int Size>
+struct MaximumPass<Ops, Size - 1, Size>
+{
+    static inline void run(typename Ops::VecU8 *) {}
+};
+
+template<class Ops, int K, int M>
+struct ForgetfulStep
+{
+    enum { Size = K * K + 3 - M };
+
+    static inline void run(typename Ops::VecU8 *_v, const unsigned char *const *_rows, int _offset)
+    {
+        MinimumPass<Ops, 1, Size>::run(_v);
+        MaximumPass<Ops, 1, Size>::run(_v);
+        _v[0] = Ops::load(_rows[M / K] + _offset + 3 * (M % K));
+        ForgetfulStep<Ops, K, M + 1>::run(_v, _rows, _offset);
+    }
+};
+
+template<class Ops, int K>
+struct ForgetfulStep<Ops, K, K * K>
+{
+    static inline void run(typename Ops::VecU8 *, const unsigned char *const *, int) {}
+};
+
+/**
+*************************************************************************
+@verbatim
++ medianBlock() - Median of K x K values for ByteLanes consecutive bytes
++                 by forgetful selection: only K*K/2 + 2 values are kept,
++                 the minimum and maximum are discarded before each new
++                 value is read. Channels stay interleaved, the neighbours
++                 of a byte are 3 bytes apart
++ ----------------
++ Parameters : _rows    K padded rows of the window
++              _offset  first byte of the block
++              _dst     destination of the block
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+template<class Ops, int K>
+static inline void medianBlock(const unsigned char *const *_rows, int _offset, unsigned char *_dst)
+{
+    const int kept = K * K / 2 + 2;
+    typename Ops::VecU8 v[kept];
+
+    for(int m = 0; m < kept; m++)
+    {
+        v[m] = Ops::load(_rows[m / K] + _offset + 3 * (m % K));
+    }
+
+    ForgetfulStep<Ops, K, kept>::run(v, _rows, _offset);
+
+    Ops::store(_dst, Ops::max(Ops::min(v[0], v[1]), Ops::min(Ops::max(v[0], v[1]), v[2])));
+}
+
+template<class Ops, int K>
+static inline void medianRow(const unsigned char *const *_rows, unsigned char *_dst, int _count)
+{
+    int i = 0;
+
+    for(; i + Ops::ByteLanes <= _count; i += Ops::ByteLanes)
+    {
+        medianBlock<Ops, K>(_rows, i, _dst + i);
+    }
+
+    // Remaining bytes
+    for(; i < _count; i++)
+    {
+        medianBlock<KernelOpsScalar, K>(_rows, i, _dst + i);
+    }
+}
+
+template<class Ops, int K>
+static inline void medianImage(const FilterImage &_image)
+{
+    const int radius = K / 2;
+
+    if(_image.width <= 0)
+        return;
+
+    RowRing<unsigned char> padded(3 * (_image.width + 2 * radius), K);
+    const unsigned char *rows[K];
+
+    for(int y = _image.firstRow; y < _image.firstRow + _image.rows; y++)
+    {
+        for(int j = 0; j < K; j++)
+        {
+            int index = borderIndex(y - radius + j, _image.height, false);
+            bool bFill;
+            unsigned char *row = padded.row(index, bFill);
+
+            if(bFill)
+            {
+                padRow(_image.src + (size_t)index * _image.srcStride, _image.width, radius, false, row);
+            }
+            rows[j] = row;
+        }
+
+        medianRow<Ops, K>(rows, _image.dst + (size_t)y * _image.dstStride, 3 * _image.width);
+    }
+}
+
+template<class Ops>
+static inline bool medianSize(const FilterImage &_image, int _aperture)
+{
+    switch(_aperture)
+    {
+    case 3:
+        medianImage<Ops, 3>(_image);
+        return true;
+    case 5:
+        medianImage<Ops, 5>(_image);
+        return true;
+    case 7:
+        medianImage<Ops, 7>(_image);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Gaussian taps unrolled at compile time. Horizontal: sum of the K taps
+ * applied to bytes 3 apart (same channel). Vertical: accumulation of the
+ * K rows of the horizontal pass
+ */
+template<class Ops, int J, int K>
+struct HorizontalTaps
+{
+    static inline typename Ops::VecU16 sum(const unsigned char *_src, const typename Ops::VecU16 *_taps)
+    {
+        return Ops::madd16(HorizontalTaps<Ops, J + 1, K>::sum(_src, _taps), Ops::widen(_src + 3 * J), _taps[J]);
+    }
+};
+
+template<class Ops, int K>
+struct HorizontalTaps<Ops, K, K>
+{
+    static inline typename Ops::VecU16 sum(const unsigned char *, const typename Ops::VecU16 *)
+    {
+        return Ops::zero16();
+    }
+};
+
+template<class Ops, int J, int K>
+struct VerticalTaps
+{
+    static inline void accumulate(typename Ops::Acc &_acc, const unsigned short *const *_rows, int _offset,
+                                  const typename Ops::Tap32 *_taps)
+    {
+        Ops::accMadd(_acc, _rows[J] + _offset, _taps[J]);
+        VerticalTaps<Ops, J + 1, K>::accumulate(_acc, _rows, _offset, _taps);
+    }
+};
+
+template<class Ops, int K>
+struct VerticalTaps<Ops, K, K>
+{
+    static inline void accumulate(typename Ops::Acc &, const unsigned short *const *, int, const typename Ops::Tap32 *)
+    {
+    }
+};
+
+template<class Ops, int K>
+static inline void horizontalRow(const unsigned char *_src, unsigned short *_dst, int _count,
+                                 const typename Ops::VecU16 *_taps, const unsigned short *_scalarTaps)
+{
+    int i = 0;
+
+    for(; i + Ops::WordLanes <= _count; i += Ops::WordLanes)
+    {
+        Ops::store16(_dst + i, HorizontalTaps<Ops, 0, K>::sum(_src + i, _taps));
+    }
+
+    // Remaining bytes
+    for(; i < _count; i++)
+    {
+        _dst[i] = HorizontalTaps<KernelOpsScalar, 0, K>::sum(_src + i, _scalarTaps);
+    }
+}
+
+template<class Ops, int K>
+static inline void verticalRow(const unsigned short *const *_rows, unsigned char *_dst, int _count,
+                               const typename Ops::Tap32 *_taps, const unsigned int *_scalarTaps)
+{
+    int i = 0;
+
+    for(; i + Ops::WordLanes <= _count; i += Ops::WordLanes)
+    {
+        typename Ops::Acc acc = Ops::accZero();
+
+        VerticalTaps<Ops, 0, K>::accumulate(acc, _rows, i, _taps);
+        Ops::accStore(_dst + i, acc);
+    }
+
+    // Remaining bytes
+    for(; i < _count; i++)
+    {
+        KernelOpsScalar::Acc acc = KernelOpsScalar::accZero();
+
+        VerticalTaps<KernelOpsScalar, 0, K>::accumulate(acc, _rows, i, _scalarTaps);
+        KernelOpsScalar::accStore(_dst + i, acc);
+    }
+}
+
+template<class Ops, int KX, int KY>
+static inline void gaussianImage(const FilterImage &_image, const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    const int radiusX = KX / 2;
+    const int radiusY = KY / 2;
+    const int count = 3 * _image.width;
+
+    if(_image.width <= 0)
+        return;
+
+    std::vector<unsigned char> padded(3 * (_image.width + 2 * radiusX));
+    RowRing<unsigned short> horizontal(count, KY);
+    const unsigned short *rows[KY];
+    typename Ops::VecU16 tapsX[KX];
+    typename Ops::Tap32 tapsY[KY];
+    unsigned int scalarTapsY[KY];
+
+    for(int j = 0; j < KX; j++)
+    {
+        tapsX[j] = Ops::tap16(_tapsX[j]);
+    }
+    for(int j = 0; j < KY; j++)
+    {
+        tapsY[j] = Ops::tap32(_tapsY[j]);
+        scalarTapsY[j] = _tapsY[j];
+    }
+
+    for(int y = _image.firstRow; y < _image.firstRow + _image.rows; y++)
+    {
+        for(int j = 0; j < KY; j++)
+        {
+            int index = borderIndex(y - radiusY + j, _image.height, true);
+            bool bFill;
+            unsigned short *row = horizontal.row(index, bFill);
+
+            if(bFill)
+            {
+                padRow(_image.src + (size_t)index * _image.srcStride, _image.width, radiusX, true, padded.data());
+                horizontalRow<Ops, KX>(padded.data(), row, count, tapsX, _tapsX);
+            }
+            rows[j] = row;
+        }
+
+        verticalRow<Ops, KY>(rows, _image.dst + (size_t)y * _image.dstStride, count, tapsY, scalarTapsY);
+    }
+}
+
+template<class Ops, int KX>
+static inline bool gaussianSizeY(const FilterImage &_image, int _kernelHeight,
+                                 const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    switch(_kernelHeight)
+    {
+    case 3:
+        gaussianImage<Ops, KX, 3>(_image, _tapsX, _tapsY);
+        return true;
+    case 5:
+        gaussianImage<Ops, KX, 5>(_image, _tapsX, _tapsY);
+        return true;
+    case 7:
+        gaussianImage<Ops, KX, 7>(_image, _tapsX, _tapsY);
+        return true;
+    default:
+        return false;
+    }
+}
+
+template<class Ops>
+static inline bool gaussianSize(const FilterImage &_image, int _kernelWidth, int _kernelHeight,
+                                const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    switch(_kernelWidth)
+    {
+    case 3:
+        return gaussianSizeY<Ops, 3>(_image, _kernelHeight, _tapsX, _tapsY);
+    case 5:
+        return gaussianSizeY<Ops, 5>(_image, _kernelHeight, _tapsX, _tapsY);
+    case 7:
+        return gaussianSizeY<Ops, 7>(_image, _kernelHeight, _tapsX, _tapsY);
+    default:
+        return false;
+    }
+}
+
+typedef bool (*GaussianKernelFunc)(const FilterImage &, int, int, const unsigned short *, const unsigned short *);
+typedef bool (*MedianKernelFunc)(const FilterImage &, int);
+
+/*
+ * Entry points of each instruction set: the generic templates and the
+ * operations are inlined (flatten) and compiled for the target
+ */
+FILTER_FLATTEN static bool gaussianScalar(const FilterImage &_image, int _kernelWidth, int _kernelHeight,
+                                          const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    return gaussianSize<KernelOpsScalar>(_image, _kernelWidth, _kernelHeight, _tapsX, _tapsY);
+}
+
+FILTER_FLATTEN static bool medianScalar(const FilterImage &_image, int _aperture)
+{
+    return medianSize<KernelOpsScalar>(_image, _aperture);
+}
+
+#ifdef FILTERKERNELS_X86
+__attribute__((target("sse4.1"), flatten))
+static bool gaussianSSE4(const FilterImage &_image, int _kernelWidth, int _kernelHeight,
+                         const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    return gaussianSize<KernelOpsSSE4>(_image, _kernelWidth, _kernelHeight, _tapsX, _tapsY);
+}
+
+__attribute__((target("sse4.1"), flatten))
+static bool medianSSE4(const FilterImage &_image, int _aperture)
+{
+    return medianSize<KernelOpsSSE4>(_image, _aperture);
+}
+
+__attribute__((target("avx2"), flatten))
+static bool gaussianAVX2(const FilterImage &_image, int _kernelWidth, int _kernelHeight,
+                         const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    return gaussianSize<KernelOpsAVX2>(_image, _kernelWidth, _kernelHeight, _tapsX, _tapsY);
+}
+
+__attribute__((target("avx2"), flatten))
+static bool medianAVX2(const FilterImage &_image, int _aperture)
+{
+    return medianSize<KernelOpsAVX2>(_image, _aperture);
+}
+
+__attribute__((target("avx512f,avx512bw"), flatten))
+static bool gaussianAVX512(const FilterImage &_image, int _kernelWidth, int _kernelHeight,
+                           const unsigned short *_tapsX, const unsigned short *_tapsY)
+{
+    return gaussianSize<KernelOpsAVX512>(_image, _kernelWidth, _kernelHeight, _tapsX, _tapsY);
+}
+
+__attribute__((target("avx512f,avx512bw"), flatten))
+static bool medianAVX512(const FilterImage &_image, int _aperture)
+{
+    return medianSize<KernelOpsAVX512>(_image, _aperture);
+}
+#endif
+
+typedef struct
+{
+    const char *isa;
+    GaussianKernelFunc gaussian;
+    MedianKernelFunc median;
+} FilterKernelSet;
+
+/**
+*************************************************************************
+@verbatim
++ selectFilterKernels() - Select the best implementations for the running
++                         CPU
++ ----------------
++ Parameters : NONE
++ Returns    : FilterKernelSet the selected implementations
+@endverbatim
+***************************************************************************/
+static FilterKernelSet selectFilterKernels()
+{
+    FilterKernelSet set = { "scalar", gaussianScalar, medianScalar };
+
+#ifdef FILTERKERNELS_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        set.isa = "avx512";
+        set.gaussian = gaussianAVX512;
+        set.median = medianAVX512;
+    }
+    else if(__builtin_cpu_supports("avx2"))
+    {
+        set.isa = "avx2";
+        set.gaussian = gaussianAVX2;
+        set.median = medianAVX2;
+    }
+    else if(__builtin_cpu_supports("sse4.1"))
+    {
+        set.isa = "sse4.1";
+        set.gaussian = gaussianSSE4;
+        set.median = medianSSE4;
+    }
+#endif
+
+    return set;
+}
+
+static FilterKernelSet g_filterKernels = selectFilterKernels();
+
+/**
+*************************************************************************
+@verbatim
++ gaussianTaps() - Compute the fixed point taps of a Gaussian kernel as
++                  the 8-bit cv::GaussianBlur() does, for identical
++                  results: fixed tables when sigma <= 0, otherwise
++                  exp(-x²/2σ²) scaled by the inverse of their sum. The
++                  outer taps are rounded (half to even) from the border
++                  inwards, each one carrying the error of the previous,
++                  and the centre tap completes the sum to 1
++ ----------------
++ Parameters : _size    number of taps (3, 5 or 7)
++              _sigma   standard deviation, <= 0 for the size default
++              _taps    receives the taps (FILTER_TAP_BITS fractional bits)
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void gaussianTaps(int _size, double _sigma, unsigned short *_taps)
+{
+    // Outer half of the symmetric kernels, up to the centre tap
+    static const double smallTaps[3][FILTER_MAX_SIZE / 2 + 1] =
+    {
+        { 0.25, 0.5 },
+        { 0.0625, 0.25, 0.375 },
+        { 0.03125, 0.109375, 0.21875, 0.28125 }
+    };
+    double taps[FILTER_MAX_SIZE / 2];
+    int half = _size / 2;
+    double error = 0;
+    int sum = 0;
+
+    if(_sigma > 0)
+    {
+        // x counted in half pixels from the centre (odd sizes)
+        double scale = -0.125 / (_sigma * _sigma);
+        double total = 1;
+
+        for(int i = 0; i < half; i++)
+        {
+            int x = 2 * i + 1 - _size;
+
+            taps[i] = std::exp((double)(x * x) * scale);
+            total += 2 * taps[i];
+        }
+
+        for(int i = 0; i < half; i++)
+            taps[i] *= 1 / total;
+    }
+    else
+    {
+        for(int i = 0; i < half; i++)
+            taps[i] = smallTaps[half - 1][i];
+    }
+
+    for(int i = 0; i < half; i++)
+    {
+        double value = taps[i] * (1 << FILTER_TAP_BITS) + error;
+        int tap = (int)std::nearbyint(value);
+
+        error = value - tap;
+        _taps[i] = (unsigned short)tap;
+        _taps[_size - 1 - i] = (unsigned short)tap;
+        sum += tap;
+    }
+    _taps[half] = (unsigned short)((1 << FILTER_TAP_BITS) - 2 * sum);
+}
+
+/**
+*************************************************************************
+@verbatim
++ makeFilterImage() - Describe the band of rows processed by a call
++ ----------------
++ Parameters : see bGaussianBlurKernel()
++ Returns    : FilterImage the band, no rows when out of the image
+@endverbatim
+***************************************************************************/
+static FilterImage makeFilterImage(const unsigned char *_src, int _srcStride, unsigned char *_dst, int _dstStride,
+                                   int _width, int _height, int _firstRow, int _rows)
+{
+    FilterImage image;
+
+    image.src = _src;
+    image.srcStride = _srcStride;
+    image.dst = _dst;
+    image.dstStride = _dstStride;
+    image.width = _width;
+    image.height = _height;
+    image.firstRow = std::min(std::max(_firstRow, 0), std::max(_height, 0));
+    image.rows = (_rows > 0) ? std::min(_rows, _height - image.firstRow) : _height - image.firstRow;
+
+    if(_width <= 0)
+        image.rows = 0;
+
+    return image;
+}
+
+bool bIsFilterKernelSize(int _size)
+{
+    return (_size == 3) || (_size == 5) || (_size == 7);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bGaussianBlurKernel() - Separable Gaussian blur in fixed point: the
++                         horizontal pass keeps 16-bit words, the vertical
++                         one accumulates in 32 bits and rounds once, as
++                         the 8-bit cv::GaussianBlur() (same results).
++                         Rows of the horizontal pass are shared by the KY
++                         output rows reading them
++ ----------------
++ Parameters : _src         source BGR buffer
++              _srcStride   source row stride in bytes
++              _dst         destination buffer
++              _dstStride   destination row stride in bytes
++              _width       width in pixels
++              _height      height in pixels
++              _firstRow    first destination row computed
++              _rows        destination rows computed (<= 0: to the end)
++              _kernelWidth / _kernelHeight  taps (3, 5 or 7)
++              _sigma       standard deviation (<= 0: from the size)
++ Returns    : TRUE if the size has a specialized implementation
+@endverbatim
+***************************************************************************/
+bool bGaussianBlurKernel(const unsigned char *_src, int _srcStride,
+                         unsigned char *_dst, int _dstStride,
+                         int _width, int _height, int _firstRow, int _rows,
+                         int _kernelWidth, int _kernelHeight, double _sigma)
+{
+    FilterImage image = makeFilterImage(_src, _srcStride, _dst, _dstStride, _width, _height, _firstRow, _rows);
+    unsigned short tapsX[FILTER_MAX_SIZE];
+    unsigned short tapsY[FILTER_MAX_SIZE];
+
+    if(!bIsFilterKernelSize(_kernelWidth) || !bIsFilterKernelSize(_kernelHeight))
+        return false;
+
+    if(image.rows <= 0)
+        return true;
+
+    gaussianTaps(_kernelWidth, _sigma, tapsX);
+    gaussianTaps(_kernelHeight, _sigma, tapsY);
+
+    return g_filterKernels.gaussian(image, _kernelWidth, _kernelHeight, tapsX, tapsY);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bMedianBlurKernel() - Median blur of each channel
++ ----------------
++ Parameters : see bGaussianBlurKernel()
++              _aperture    side of the window (3, 5 or 7)
++ Returns    : TRUE if the aperture has a specialized implementation
+@endverbatim
+***************************************************************************/
+bool bMedianBlurKernel(const unsigned char *_src, int _srcStride,
+                       unsigned char *_dst, int _dstStride,
+                       int _width, int _height, int _firstRow, int _rows,
+                       int _aperture)
+{
+    FilterImage image = makeFilterImage(_src, _srcStride, _dst, _dstStride, _width, _height, _firstRow, _rows);
+
+    if(!bIsFilterKernelSize(_aperture))
+        return false;
+
+    if(image.rows <= 0)
+        return true;
+
+    return g_filterKernels.median(image, _aperture);
+}
+
+/**
+*************************************************************************
+@verbatim
++ filterKernelISA() - Return the instruction set used by the filter kernels
++ ----------------
++ Parameters : NONE
++ Returns    : const char * name of the instruction set
+@endverbatim
+***************************************************************************/
+const char *filterKernelISA()
+{
+    return g_filterKernels.isa;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bSelectFilterKernelISA() - Use the kernels of an instruction set instead
++                            of the best one, to compare them. Not thread
++                            safe: call it when no filter runs
++ ----------------
++ Parameters : _isa     "scalar", "sse4.1", "avx2" or "avx512"
++ Returns    : TRUE if selected; FALSE if unknown or not supported by the CPU
+@endverbatim
+***************************************************************************/
+bool bSelectFilterKernelISA(const char *_isa)
+{
+    FilterKernelSet set = { "scalar", gaussianScalar, medianScalar };
+
+    if(std::strcmp(_isa, set.isa) != 0)
+    {
+#ifdef FILTERKERNELS_X86
+        __builtin_cpu_init();
+
+        if( (std::strcmp(_isa, "avx512") == 0) && __builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512bw") )
+        {
+            set.isa = "avx512";
+            set.gaussian = gaussianAVX512;
+            set.median = medianAVX512;
+        }
+        else if( (std::strcmp(_isa, "avx2") == 0) && __builtin_cpu_supports("avx2") )
+        {
+            set.isa = "avx2";
+            set.gaussian = gaussianAVX2;
+            set.median = medianAVX2;
+        }
+        else if( (std::strcmp(_isa, "sse4.1") == 0) && __builtin_cpu_supports("sse4.1") )
+        {
+            set.isa = "sse4.1";
+            set.gaussian = gaussianSSE4;
+            set.median = medianSSE4;
+        }
+        else
+        {
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    g_filterKernels = set;
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef FILTERKERNELS_H
+#define FILTERKERNELS_H
+
+/*
+ * Gaussian & median filters specialized for 8-bit BGR images and kernel
+ * sizes 3, 5 and 7 (taps unrolled at compile time). Each one is built for
+ * several instruction sets, the best one for the running CPU is selected
+ * at startup. No dependency on Qt nor OpenCV.
+ *
+ * Both work on a band of rows of the destination (_firstRow, _rows), so that
+ * the bands of one image can be processed in parallel; _rows <= 0 processes
+ * the rows up to the end. Source & destination shall not overlap.
+ */
+
+// TRUE if the kernel size has a specialized implementation
+bool bIsFilterKernelSize(int _size);
+
+// Gaussian blur, _kernelWidth x _kernelHeight taps, _sigma <= 0 derives it
+// from the size. Reflected borders. Identical to the 8-bit cv::GaussianBlur
+// (same fixed point taps & rounding). FALSE for other sizes
+bool bGaussianBlurKernel(const unsigned char *_src, int _srcStride,
+                         unsigned char *_dst, int _dstStride,
+                         int _width, int _height, int _firstRow, int _rows,
+                         int _kernelWidth, int _kernelHeight, double _sigma);
+
+// Median of each channel over _aperture x _aperture pixels. Replicated
+// borders (as cv::medianBlur). FALSE for other apertures
+bool bMedianBlurKernel(const unsigned char *_src, int _srcStride,
+                       unsigned char *_dst, int _dstStride,
+                       int _width, int _height, int _firstRow, int _rows,
+                       int _aperture);
+
+// Name of the instruction set used by the filter kernels
+const char *filterKernelISA();
+
+// Use the kernels of an instruction set ("scalar", "sse4.1", "avx2" or
+// "avx512") instead of the best one, for tests. FALSE if not supported
+bool bSelectFilterKernelISA(const char *_isa);
+
+#endif // FILTERKERNELS_H
@@ -0,0 +1,195 @@
+#include "imagecore.h"
+
+#include <exception>
+#include <iostream>
+
+#include <opencv2/core.hpp>
+
+#include "filterkernels.h"
+#include "imageprocessor.h"
+#include "workpool.h"
+
+// Header on the pixels of a caller buffer (no copy, no ownership)
+static cv::Mat wrapBuffer(const ImageBuffer &_buffer)
+{
+    return cv::Mat(_buffer.height, _buffer.width, CV_8UC3, _buffer.data, (size_t)_buffer.stride);
+}
+
+void ImageCore::setThreads(int _threads)
+{
+    WorkPool::instance().configure(_threads);
+}
+
+const char *ImageCore::filterISA()
+{
+    return filterKernelISA();
+}
+
+bool ImageCore::bCheckDenoizeParams(ProcessType _type, ProcessParameters &_params)
+{
+    return ImageProcessor::bCheckDenoizeParams(_type, _params);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bEdit() - Apply Brightness, Contrast, Hue & Saturation to a caller
++           buffer, into a caller buffer. The editing is per pixel: the
++           output may be the input
++ ----------------
++ Parameters : _in          input BGR8 buffer
++              _out         output BGR8 or RGB8 buffer, same size
++              _params      editing values
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageCore::bEdit(const ImageBuffer &_in, const ImageBuffer &_out, const EditParameters &_params,
+                      TaskControl *_control)
+{
+    ColorEditKernel kernel;
+    int meanHue = 0;
+    int meanSaturation = 0;
+    int hue;
+    int saturation;
+    cv::Mat in;
+    cv::Mat out;
+
+    if( !bIsValidBuffer(_in) || !bIsValidBuffer(_out) || !bIsSameGeometry(_in, _out) ||
+        (_in.format != PixelFormatBGR8) )
+    {
+        std::cerr << __func__ << " Bad buffers!" << std::endl;
+        return false;
+    }
+
+    // In place only on the very same pixels
+    if( bOverlap(_in, _out) && ((_in.data != _out.data) || (_in.stride != _out.stride)) )
+    {
+        std::cerr << __func__ << " Overlapping buffers!" << std::endl;
+        return false;
+    }
+
+    // OpenCV errors (cv::Exception) shall not reach the caller
+    try
+    {
+        in = wrapBuffer(_in);
+        out = wrapBuffer(_out);
+
+        // Hue & saturation are shifted relative to the mean levels
+        ImageProcessor::computeMeanHueSaturation(in, meanHue, meanSaturation);
+        hue = (_params.hue < 0) ? meanHue : _params.hue;
+        saturation = (_params.saturation < 0) ? meanSaturation : _params.saturation;
+
+        if(!ImageProcessor::bCheckImageEditingValues(_params.brightness, _params.contrast, hue, saturation))
+        {
+            std::cerr << __func__ << " Bad editing values!" << std::endl;
+            return false;
+        }
+
+        ImageProcessor::buildEditKernel(kernel, _params.brightness, _params.contrast, hue, saturation,
+                                        meanHue, meanSaturation);
+
+        return ImageProcessor::bEditImage(in, out, kernel, _out.format == PixelFormatRGB8, _control) &&
+               (out.data == _out.data);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << __func__ << " " << e.what() << std::endl;
+        return false;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoize() - Denoize a caller buffer into a caller buffer. In place,
++              the input is first copied into the scratch buffer, which
++              the filter reads
++ ----------------
++ Parameters : _in          input buffer
++              _out         output buffer, same size & format (may be _in)
++              _type        type of denoizing process
++              _params      parameters checked by bCheckDenoizeParams()
++              _scratch     buffer of the size of the input, required in
++                           place only, may be NULL
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageCore::bDenoize(const ImageBuffer &_in, const ImageBuffer &_out, ProcessType _type,
+                         const ProcessParameters &_params, const ImageBuffer *_scratch, TaskControl *_control)
+{
+    ProcessParameters params = _params;
+    cv::Mat in;
+    cv::Mat out;
+    cv::Mat scratch;
+
+    if( !bIsValidBuffer(_in) || !bIsValidBuffer(_out) || !bIsSameGeometry(_in, _out) ||
+        (_in.format != _out.format) )
+    {
+        std::cerr << __func__ << " Bad buffers!" << std::endl;
+        return false;
+    }
+
+    // Colour models of these types assume the BGR order
+    if( (_in.format != PixelFormatBGR8) && ((_type == TypeNlMeans) || (_type == TypeBilateralGrid)) )
+    {
+        std::cerr << __func__ << " BGR8 buffers required!" << std::endl;
+        return false;
+    }
+
+    if(!ImageProcessor::bCheckDenoizeParams(_type, params))
+    {
+        std::cerr << __func__ << " Bad parameters!" << std::endl;
+        return false;
+    }
+
+    // OpenCV errors (cv::Exception) shall not reach the caller
+    try
+    {
+        in = wrapBuffer(_in);
+        out = wrapBuffer(_out);
+
+        if(bOverlap(_in, _out))
+        {
+            if( (_scratch == nullptr) || !bIsValidBuffer(*_scratch) || !bIsSameGeometry(_in, *_scratch) ||
+                bOverlap(*_scratch, _in) || bOverlap(*_scratch, _out) )
+            {
+                std::cerr << __func__ << " In place denoizing needs a scratch buffer!" << std::endl;
+                return false;
+            }
+
+            scratch = wrapBuffer(*_scratch);
+            in.copyTo(scratch);
+            in = scratch;
+        }
+
+        // The output header shall still be on the caller pixels
+        return ImageProcessor::bDenoizeImage(in, out, _type, params, _control) && (out.data == _out.data);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << __func__ << " " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool ImageCore::bIsValidBuffer(const ImageBuffer &_buffer)
+{
+    return (_buffer.data != nullptr) && (_buffer.width > 0) && (_buffer.height > 0) &&
+           ((long long)_buffer.stride >= 3LL * _buffer.width) &&
+           ((_buffer.format == PixelFormatBGR8) || (_buffer.format == PixelFormatRGB8));
+}
+
+bool ImageCore::bIsSameGeometry(const ImageBuffer &_first, const ImageBuffer &_second)
+{
+    return (_first.width == _second.width) && (_first.height == _second.height);
+}
+
+bool ImageCore::bOverlap(const ImageBuffer &_first, const ImageBuffer &_second)
+{
+    const unsigned char *firstEnd = _first.data + (size_t)(_first.height - 1) * _first.stride + (size_t)3 * _first.width;
+    const unsigned char *secondEnd = _second.data + (size_t)(_second.height - 1) * _second.stride + (size_t)3 * _second.width;
+
+    return (_first.data < secondEnd) && (_second.data < firstEnd);
+}
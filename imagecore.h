@@ -0,0 +1,76 @@
+#ifndef IMAGECORE_H
+#define IMAGECORE_H
+
+#include "processtypes.h"
+#include "taskcontrol.h"
+
+typedef enum
+{
+    PixelFormatBGR8 = 0,
+    // Display order
+    PixelFormatRGB8 = 1
+} PixelFormat;
+
+/*
+ * Image buffer owned by the caller: 8-bit, 3 channels per pixel
+ */
+typedef struct
+{
+    unsigned char *data;
+    int width;
+    int height;
+    // Bytes from the start of a row to the next, >= 3 * width
+    int stride;
+    PixelFormat format;
+} ImageBuffer;
+
+typedef struct
+{
+    // 1 to 200, 100 leaves the levels unchanged
+    int brightness;
+    int contrast;
+    // Targets of the mean hue (0 to 179) and saturation (0 to 255)
+    // levels, < 0 keeps the mean level of the image
+    int hue;
+    int saturation;
+} EditParameters;
+
+/*
+ * Plain C++ API of the processing library (core/core.pro), without Qt
+ * nor OpenCV in the interface, for services embedding the processing.
+ *
+ * Images are described by ImageBuffer and stay owned by the caller: the
+ * result is written into the output buffer, which may be the input one
+ * (in place). No image buffer is allocated for the input nor the output,
+ * only the working memory of the filters (tiles, intermediate planes).
+ * Calls are thread safe and run on the shared work pool. They do not
+ * throw: errors, OpenCV ones included, are reported by a FALSE return.
+ */
+class ImageCore
+{
+public:
+    // Threads of the work pool (<= 0: one per CPU), call it when idle
+    static void setThreads(int _threads);
+    // Name of the instruction set of the specialized filter kernels
+    static const char *filterISA();
+
+    // Check the parameters of a denoizing, and make the sizes odd
+    static bool bCheckDenoizeParams(ProcessType _type, ProcessParameters &_params);
+
+    // Input BGR8, output BGR8 or RGB8
+    static bool bEdit(const ImageBuffer &_in, const ImageBuffer &_out, const EditParameters &_params,
+                      TaskControl *_control = nullptr);
+    // Input & output of the same format. NlMeans & BilateralGrid need BGR8,
+    // the other types work on each channel. In place, _scratch receives a
+    // copy of the input (neighbourhood filters read the pixels they replace)
+    static bool bDenoize(const ImageBuffer &_in, const ImageBuffer &_out, ProcessType _type,
+                         const ProcessParameters &_params, const ImageBuffer *_scratch = nullptr,
+                         TaskControl *_control = nullptr);
+
+private:
+    static bool bIsValidBuffer(const ImageBuffer &_buffer);
+    static bool bIsSameGeometry(const ImageBuffer &_first, const ImageBuffer &_second);
+    static bool bOverlap(const ImageBuffer &_first, const ImageBuffer &_second);
+};
+
+#endif // IMAGECORE_H
@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Processing library: editing & denoizing of image buffers, without Qt
+# (API in imagecore.h). Built alone by core/core.pro, compiled into the
+# application and the benchmark
+#
+#-------------------------------------------------
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/imagecore.cpp \
+    $$PWD/imageprocessor.cpp \
+    $$PWD/filterkernels.cpp \
+    $$PWD/imagekernels.cpp \
+    $$PWD/tiledexecutor.cpp \
+    $$PWD/workpool.cpp \
+    $$PWD/taskcontrol.cpp \
+    $$PWD/imagestatistics.cpp \
+    $$PWD/stagetimer.cpp
+
+HEADERS += \
+    $$PWD/imagecore.h \
+    $$PWD/imageprocessor.h \
+    $$PWD/filterkernels.h \
+    $$PWD/imagekernels.h \
+    $$PWD/tiledexecutor.h \
+    $$PWD/workpool.h \
+    $$PWD/taskcontrol.h \
+    $$PWD/imagestatistics.h \
+    $$PWD/stagetimer.h \
+    $$PWD/processtypes.h
@@ -3,417 +3,1088 @@
 #include <opencv2/opencv.hpp>
 
 #include <QImage>
+#include <QImageReader>
+#include <QMutex>
 #include <QPixmap>
 #include <QDebug>
 
-ImageDenoizeAPI::ImageDenoizeAPI()
+// Stage names of the jobs, indexed by JobType
+static const char *g_jobStageNames[] =
 {
+    "job:load", "job:edit", "job:denoize", "job:denoizePreview", "job:previewSize", "job:chain", "job:compare"
+};
+
+// Edited previews whose statistics are kept
+#define STATISTICS_CACHE_SIZE 16
+
+ImageDenoizeAPI::ImageDenoizeAPI() :
+    m_imageVersion(0),
+    m_previewWidth(0),
+    m_previewHeight(0),
+    m_meanHue(0),
+    m_meanSaturation(0),
+    m_statisticsCache(STATISTICS_CACHE_SIZE),
+    m_requiredBytes(0),
+    bRunning(false),
+    m_bJobRunning(false),
+    m_runningJobType(JobLoadImage)
+{
+    // Frames are transferred to the UI through queued connections
+    qRegisterMetaType<ImageFrame>("ImageFrame");
+    qRegisterMetaType<StageTimings>("StageTimings");
+    qRegisterMetaType<ImageStatistics>("ImageStatistics");
+    qRegisterMetaType<Comparison>("Comparison");
+
+    // Recomputable images are released when the memory budget is exceeded:
+    // cached results first, then intermediate nodes
+    m_storeEvictorIds[0] = ImageStore::addEvictor([this](qint64 _bytes) { m_resultCache.trim(_bytes); });
+    m_storeEvictorIds[1] = ImageStore::addEvictor([this](qint64) { m_fullGraph.releaseIntermediates(); });
 
+    // Reported by the chunks of the job being processed, from any thread
+    m_control.setProgressFunction([this](int _percent) { emit progress(_percent); });
+
+    (void)QObject::connect(&m_encoder, SIGNAL(saved(EncodeResult)), this, SIGNAL(imageSaved(EncodeResult)));
 }
 
 ImageDenoizeAPI::~ImageDenoizeAPI()
 {
+    stop();
+
+    ImageStore::removeEvictor(m_storeEvictorIds[0]);
+    ImageStore::removeEvictor(m_storeEvictorIds[1]);
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bLoadImage() - Load the target image into the API
++ start() - Start the worker thread servicing the job queue
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::start()
+{
+    m_jobMutex.lock();
+    bRunning = true;
+    m_jobMutex.unlock();
+
+    QThread::start();
+}
+
+/**
+*************************************************************************
+@verbatim
++ stop() - Stop the worker thread. Pending jobs are dropped, the job
++          being processed (if any) is cancelled and the call returns
++          once it is stopped
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::stop()
+{
+    m_jobMutex.lock();
+    bRunning = false;
+    m_jobs.clear();
+    m_control.cancel();
+    m_jobAvailable.wakeAll();
+    m_jobMutex.unlock();
+
+    wait();
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestLoadImage() - Queue the loading of a new image. Every pending job
++                      is dropped since it relates to the previous image
 + ----------------
 + Parameters : _file the path of the target image
-+ Returns    : TRUE if success; FALSE otherwise
++ Returns    : NONE
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bLoadImage(QString _file)
+void ImageDenoizeAPI::requestLoadImage(QString _file)
 {
-    cv::Mat input;
-    cv::Mat output;
+    Job job;
+    job.type = JobLoadImage;
+    job.file = _file;
 
-    input = cv::imread(_file.toStdString());
+    postJob(job);
+}
 
-    if(input.empty())
+/**
+*************************************************************************
+@verbatim
++ requestImageEditing() - Queue an image editing. If an editing is already
++                         pending, it is replaced by this one
++ ----------------
++ Parameters : _brightness brightness value between 1 and 200
++              _contrast   constrast value between 1 and 200
++              _hue        hue value between 0 and 179
++              _saturation saturation value between 0 and 255
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::requestImageEditing(int _brigthness, int _contrast, int _hue, int _saturation)
+{
+    Job job;
+    job.type = JobImageEditing;
+    job.brightness = _brigthness;
+    job.contrast = _contrast;
+    job.hue = _hue;
+    job.saturation = _saturation;
+
+    postJob(job);
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestDenoize() - Queue a denoizing process. If a denoizing is already
++                    pending, it is replaced by this one
++ ----------------
++ Parameters : _type     type of denoizing process
++              _params   parameters related to the requested type
++              _bPreview TRUE to only process the preview proxy
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::requestDenoize(ProcessType _type, ProcessParameters _params, bool _bPreview)
+{
+    Job job;
+    job.type = _bPreview ? JobDenoizePreview : JobDenoize;
+    job.processType = _type;
+    job.params = _params;
+
+    postJob(job);
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestChain() - Queue the commit of the last full resolution denoizing:
++                  its result becomes the input of the next denoizing
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::requestChain()
+{
+    Job job;
+    job.type = JobChain;
+
+    postJob(job);
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestCompare() - Queue a comparison of denoizing methods on the full
++                    resolution image. If a comparison is already pending,
++                    it is replaced by this one
++ ----------------
++ Parameters : _candidates  methods & parameters to compare
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::requestCompare(QVector<DenoizeCandidate> _candidates)
+{
+    Job job;
+    job.type = JobCompare;
+    job.candidates = _candidates;
+
+    postJob(job);
+}
+
+/**
+*************************************************************************
+@verbatim
++ postJob() - Add a job to the queue and wake up the worker thread.
++             Latest request wins: a pending job of the same type is
++             replaced in place so that only the newest one is computed.
++             Full resolution and preview denoizing are distinct types.
++             The job being processed is cancelled as well when the new
++             one makes it obsolete (same type, or a new image)
++ ----------------
++ Parameters : _job     job to queue
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::postJob(const Job &_job)
+{
+    bool bReplaced = false;
+
+    QMutexLocker locker(&m_jobMutex);
+
+    if(_job.type == JobLoadImage)
     {
-        qDebug() << "Error while loading file into Object Mat!";
-        return false;
+        // Every pending processing is obsolete once a new image is requested
+        for(int i = m_jobs.size() - 1; i >= 0; i--)
+        {
+            if(m_jobs[i].type != JobPreviewSize)
+                m_jobs.removeAt(i);
+        }
     }
 
-    // Store original image (used as base reference)
-    m_originalImg = input.clone();
-    // Set current image as initial
-    m_curImg = m_originalImg.clone();
+    for(int i = 0; i < m_jobs.size(); i++)
+    {
+        if(m_jobs[i].type == _job.type)
+        {
+            m_jobs[i] = _job;
+            bReplaced = true;
+            break;
+        }
+    }
+
+    if(!bReplaced)
+        m_jobs.append(_job);
+
+    // Stop the obsolete job at its next chunk instead of queueing behind it.
+    // Chaining is not repeated, a second request shall not cancel the first
+    if( m_bJobRunning && ((_job.type == JobLoadImage) ||
+                          ((_job.type == m_runningJobType) && (_job.type != JobChain))) )
+    {
+        m_control.cancel();
+    }
 
-    // Convert the image back to the RGB color space
-    cv::cvtColor(m_originalImg, output, cv::COLOR_BGR2RGB);
+    m_jobAvailable.wakeOne();
+}
 
-    // Transmit original image to who is interested
-    emit updatedEditedImg(QImage(output.data, output.cols, output.rows, output.step, QImage::Format_RGB888).copy());
+/**
+*************************************************************************
+@verbatim
++ cancel() - Cancel the job being processed. It stops at its next chunk
++            and jobCancelled() is emitted. Pending jobs are kept
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::cancel()
+{
+    QMutexLocker locker(&m_jobMutex);
 
-    return true;
+    if(m_bJobRunning)
+        m_control.cancel();
 }
 
+/**
+*************************************************************************
+@verbatim
++ run() - Worker thread loop. Sleep until a job is available, then
++         process the jobs in order
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
 void ImageDenoizeAPI::run()
 {
-    while(bRunning)
+    forever
     {
-        // Run the object on separated thread for real time processing
-        // For now, just sleep the thread and allow time for other stuff
-        msleep(1);
+        Job job;
+
+        m_jobMutex.lock();
+        while(bRunning && m_jobs.isEmpty())
+        {
+            m_jobAvailable.wait(&m_jobMutex);
+        }
+
+        if(!bRunning)
+        {
+            m_jobMutex.unlock();
+            break;
+        }
+
+        job = m_jobs.takeFirst();
+        // Reset under the lock: a cancel posted from now on targets this job
+        m_bJobRunning = true;
+        m_runningJobType = job.type;
+        m_control.reset();
+        m_jobMutex.unlock();
+
+        executeJob(job);
+
+        m_jobMutex.lock();
+        m_bJobRunning = false;
+        m_jobMutex.unlock();
     }
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bApplyImageEditing() - Apply Brightness & Constrat to an image. The result
-+                        is transferred via signal
++ executeJob() - Process a job on the worker thread. Results are
++                transferred via signals. A cancelled job is reported by
++                jobCancelled(), its stack nodes stay to be computed
 + ----------------
-+ Parameters : _brightness brightness value between 1 and 200
-+              _contrast   constrast value between 1 and 200
++ Parameters : _job     job to process
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::executeJob(const Job &_job)
+{
+    bool bOK = false;
+    int mark = Profiler::mark();
+
+    m_requiredBytes = 0;
+
+    // Whole job, including its stages
+    {
+        ScopedTimer jobTimer(g_jobStageNames[_job.type]);
+
+        switch(_job.type)
+        {
+        case JobLoadImage:
+            bOK = bLoadImage(_job.file);
+            if(bOK)
+            {
+                emit imageLoaded(m_meanHue, m_meanSaturation);
+            }
+            break;
+        case JobImageEditing:
+            bOK = bApplyImageEditing(_job.brightness, _job.contrast, _job.hue, _job.saturation);
+            break;
+        case JobDenoize:
+            bOK = bApplyDenoize(_job.processType, _job.params, false);
+            break;
+        case JobDenoizePreview:
+            bOK = bApplyDenoize(_job.processType, _job.params, true);
+            break;
+        case JobPreviewSize:
+            bOK = bResizePreview(_job.previewWidth, _job.previewHeight);
+            break;
+        case JobChain:
+            bOK = bChainDenoize();
+            break;
+        case JobCompare:
+            bOK = bCompareDenoizers(_job.candidates);
+            break;
+        default:
+            qDebug() << __func__ << " Unkown job type!";
+            break;
+        }
+    }
+
+    // Transmit stage durations of the job to who is interested
+    if(Profiler::bIsEnabled())
+    {
+        emit stageTimings(_job.type, Profiler::stageTimingsSince(mark));
+    }
+
+    // Transmit memory usage to who is interested
+    emit memoryUsage(ImageStore::bytes(), ImageStore::budget());
+
+    if(bOK)
+    {
+        m_control.complete();
+    }
+    else if(m_control.bIsCancelled())
+    {
+        qDebug() << g_jobStageNames[_job.type] << "cancelled";
+        emit jobCancelled(_job.type);
+    }
+    else if(m_requiredBytes > 0)
+    {
+        emit memoryBudgetExceeded(_job.type, m_requiredBytes / (1024.0 * 1024.0));
+    }
+    else
+    {
+        emit jobFailed(_job.type);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bReserveMemory() - Check that new images fit in the memory budget,
++                    releasing cached images if needed
++ ----------------
++ Parameters : _bytes   size of the images about to be allocated
++ Returns    : TRUE if they fit; FALSE otherwise (job is refused)
+@endverbatim
+***************************************************************************/
+bool ImageDenoizeAPI::bReserveMemory(qint64 _bytes)
+{
+    if(ImageStore::bReserve(_bytes))
+        return true;
+
+    m_requiredBytes = _bytes;
+
+    return false;
+}
+
+/**
+*************************************************************************
+@verbatim
++ setMemoryBudget() - Set the memory budget of all the images (originals,
++                     intermediates, caches & display), 0 for no budget
++ ----------------
++ Parameters : _bytes   budget in bytes
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::setMemoryBudget(qint64 _bytes)
+{
+    ImageStore::setBudget(_bytes);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bLoadImage() - Load the target image into the API
++ ----------------
++ Parameters : _file the path of the target image
 + Returns    : TRUE if success; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bApplyImageEditing(int _brigthness, int _contrast, int _hue, int _saturation)
+bool ImageDenoizeAPI::bLoadImage(QString _file)
 {
-    bool bOK = true;
-    cv::Mat tmp;
-    cv::Mat out;
-    cv::Mat hsvImage;
-    std::vector<cv::Mat> channels;
+    cv::Mat input;
+    QSize size;
+    QString format;
+    ScopedTimer timer("imread");
 
-    if(m_originalImg.empty())
+    // Header only probe
+    if(!bProbeImage(_file, size, format))
     {
         qDebug() << "Error while loading file into Object Mat!";
         return false;
     }
 
-    // Get original image
-    m_curImg = m_originalImg.clone();
+    // Previous image and its results are released before decoding
+    m_resultCache.clear();
+    m_statisticsCache.clear();
+    m_fullGraph.clear();
+    m_fullGraph.setSource(cv::Mat(), m_imageVersion, 0, 0);
+    m_previewGraph.clear();
+    m_previewGraph.setSource(cv::Mat(), m_imageVersion, 0, 0);
 
-    // Check if request brightness value is valid
-    if(!bCheckImageEditingValues(_brigthness, _contrast, _hue, _saturation))
+    if(!bReserveMemory((qint64)size.width() * size.height() * 3))
+        return false;
+
+    // Paint a reduced decode first, the full decode takes much longer
+    paintReducedImage(_file, size, format);
+
+    // Decoding can not be split, a newer image is checked around it
+    if(m_control.bIsCancelled())
+        return false;
+
+    input = cv::imread(_file.toStdString());
+    timer.setBytes(input.total() * input.elemSize());
+
+    if(m_control.bIsCancelled())
+        return false;
+
+    if(input.empty())
     {
-        qDebug() << __func__ << " Bad brightness value!";
+        qDebug() << "Error while loading file into Object Mat!";
         return false;
     }
 
-    /*
-     * Brightness & Contrast
-     */
-    // Increase/Decrease brightness & contrast
-    m_curImg.convertTo(tmp, -1, ((double)_contrast / 100), _brigthness - 100);
+    // Single pass histograms: reference levels for hue & saturation
+    // editing, auto-levels
+    {
+        ScopedTimer statisticsTimer("statistics", input.total() * input.elemSize());
+        ImageStatistics statistics = ImageStatistics::compute(input);
+        QMutexLocker locker(&m_statisticsMutex);
 
-    /*
-     * Hue & Saturation
-     */
-    // Convert the image to the HSV color space
-    cv::cvtColor(tmp, hsvImage, cv::COLOR_BGR2HSV);
+        m_sourceStatistics = statistics;
+        m_meanHue = (int)statistics.mean(ChannelHue);
+        m_meanSaturation = (int)statistics.mean(ChannelSaturation);
+    }
 
-    // Split the image into its individual channels
-    cv::split(hsvImage, channels);
+    // Signatures of the previous image will never be requested again
+    m_imageVersion++;
 
-    // Modify the hue channel
-    //channels[0] = _hue;
+    // New operation stack: editing values matching the unedited image
+    m_fullGraph.clear();
+    m_fullGraph.append(makeEditOperation(100, 100, m_meanHue, m_meanSaturation));
+    m_fullGraph.setSource(input, m_imageVersion, m_meanHue, m_meanSaturation);
 
-    // Modify the saturation channel
-    //channels[1] = _saturation;
+    m_previewGraph.clear();
+    m_previewGraph.append(makeEditOperation(100, 100, m_meanHue, m_meanSaturation));
 
-    // Merge the modified channels back into a single image
-    cv::merge(channels, hsvImage);
+    // Build the preview proxy from the original image
+    updateProxy();
 
-    // Convert the image back to the BGR color space
-    cv::cvtColor(hsvImage, out, cv::COLOR_HSV2BGR);
+    // Transmit original proxy to who is interested
+    emit updatedEditedImg(ImageFrame(m_previewGraph.source()));
+    emitPreviewStatistics(-1, m_previewGraph.source());
 
-    // Update current image
-    m_curImg = out.clone();
+    return true;
+}
 
-    // Convert the image to the RGB color space
-    cv::cvtColor(m_curImg, out, cv::COLOR_BGR2RGB);
+/**
+*************************************************************************
+@verbatim
++ bProbeImage() - Read the size and format of an image from its header,
++                 without decoding it
++ ----------------
++ Parameters : _file    the path of the image
++              _size    receives the image size
++              _format  receives the image format (jpeg, png, tiff, ...)
++ Returns    : TRUE if the header could be read; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageDenoizeAPI::bProbeImage(const QString &_file, QSize &_size, QString &_format)
+{
+    QImageReader reader(_file);
 
-    if(bOK && !out.empty())
-    {
-        // Transmit processed image to who is interested
-        emit updatedEditedImg(QImage(out.data, out.cols, out.rows, out.step, QImage::Format_RGB888).copy());
-    }
+    _size = reader.size();
+    _format = QString::fromLatin1(reader.format());
 
-    return bOK;
+    return _size.isValid();
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bApplyDenoize() - Apply Denoizing process to current image using type and parameters and
-+              transfer the result via signal
++ paintReducedImage() - Decode a JPEG image at 1/2, 1/4 or 1/8 of its size
++                       (DCT scaling, a fraction of the full decode cost)
++                       and transmit it as first preview. The reduction
++                       keeps the image at least as large as the preview.
++                       Other formats have no cheap reduced decode and are
++                       painted once fully decoded
 + ----------------
-+ Parameters : type     type of denoizing process
-+              params   parameters related to the requested type
-+ Returns    : TRUE if success; FALSE otherwise
++ Parameters : _file    the path of the image
++              _size    the image size
++              _format  the image format
++ Returns    : NONE
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bApplyDenoize(ProcessType _type, ProcessParameters _params)
+void ImageDenoizeAPI::paintReducedImage(const QString &_file, const QSize &_size, const QString &_format)
 {
-    bool bOK = true;
-    cv::Mat in;
-    cv::Mat tmp;
-    cv::Mat out;
+    const int flags[] = { cv::IMREAD_REDUCED_COLOR_8, cv::IMREAD_REDUCED_COLOR_4, cv::IMREAD_REDUCED_COLOR_2 };
+    const int reductions[] = { 8, 4, 2 };
+    double scale;
+    cv::Mat reduced;
+
+    if( (_format != "jpeg") || (m_previewWidth <= 0) || (m_previewHeight <= 0) )
+        return;
 
-    if(m_curImg.empty())
+    // Scale of the proxy that will be displayed
+    scale = std::min((double)m_previewWidth / _size.width(), (double)m_previewHeight / _size.height());
+
+    for(int i = 0; i < 3; i++)
     {
-        qDebug() << "Error while loading file into Object Mat!";
-        return false;
+        if(reductions[i] * scale <= 1.0)
+        {
+            ScopedTimer timer("imreadReduced");
+
+            reduced = cv::imread(_file.toStdString(), flags[i]);
+            timer.setBytes(reduced.total() * reduced.elemSize());
+            break;
+        }
     }
 
-    // Check if encoded parameters are in range & make them odd
-    if(!bCheckDenoizeParams(_type, _params))
+    if(!reduced.empty())
     {
-        qDebug() << __func__ << " Bad parameters!";
-        return false;
+        // Transmit first preview to who is interested
+        emit updatedEditedImg(ImageFrame(reduced));
     }
+}
 
-    // Get current image
-    in = m_curImg.clone();
+/**
+*************************************************************************
+@verbatim
++ setPreviewSize() - Set the size of the widget displaying the previews.
++                    The proxy image is rebuilt to match it
++ ----------------
++ Parameters : _width   width of the preview widget
++              _height  height of the preview widget
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::setPreviewSize(int _width, int _height)
+{
+    Job job;
+    job.type = JobPreviewSize;
+    job.previewWidth = _width;
+    job.previewHeight = _height;
 
-    // Apply Denoizing type
-    switch(_type)
-    {
-    case TypeGaussianBlur:
-        qDebug() << "Apply GaussianBlur Denoizing type";
-        cv::GaussianBlur(in, tmp, cv::Size(_params.kernelSizeWidth, _params.kernelSizeHeight), (float)(_params.sigma / 10));
-        break;
-    case TypeMedianBlur:
-        qDebug() << "Apply MedianBlur Denoizing type";
-        cv::medianBlur(in, tmp, _params.aperture);
-        break;
-    case TypeNlMeans:
-        qDebug() << "Apply NlMeans Denoizing type";
-        cv::fastNlMeansDenoisingColored(in, tmp);
-        break;
-    default:
-        qDebug() << __func__ << " Unkown type!";
-        bOK = false;
-        break;
-    }
+    postJob(job);
+}
 
-    // Change coding order from BGR to RGB
-    cv::cvtColor(tmp, out, cv::COLOR_BGR2RGB);
+/**
+*************************************************************************
+@verbatim
++ setResultCacheBudget() - Set the memory budget of the denoized images
++                          cache (thread safe)
++ ----------------
++ Parameters : _bytes   budget in bytes
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::setResultCacheBudget(qint64 _bytes)
+{
+    m_resultCache.setBudget(_bytes);
+}
 
-    if(bOK && !out.empty())
+/**
+*************************************************************************
+@verbatim
++ bResizePreview() - Store the new preview size and rebuild the proxy
++                    image accordingly. The operation stack is re-applied
++                    to the new proxy
++ ----------------
++ Parameters : _width   width of the preview widget
++              _height  height of the preview widget
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageDenoizeAPI::bResizePreview(int _width, int _height)
+{
+    if( (_width <= 0) || (_height <= 0) )
     {
-        // Transmit denoized image to who is interested
-        emit updatedDenoizeImg(QImage(out.data, out.cols, out.rows, out.step, QImage::Format_RGB888).copy());
+        qDebug() << __func__ << " Bad preview size!";
+        return false;
     }
 
-    return bOK;
+    if( (_width == m_previewWidth) && (_height == m_previewHeight) )
+        return true;
+
+    m_previewWidth = _width;
+    m_previewHeight = _height;
+
+    if(m_fullGraph.source().empty())
+        return true;
+
+    updateProxy();
+
+    return bEmitEditedPreview();
 }
 
 /**
 *************************************************************************
 @verbatim
-+ GetImage() - Return current modified image into a QImage
++ updateProxy() - Downscale the original image to fit the preview size
++                 (keeping its aspect ratio) and use it as source of the
++                 preview operation stack. The proxy is never upscaled
 + ----------------
 + Parameters : NONE
-+ Returns    : QImage the current modified image
++ Returns    : NONE
 @endverbatim
 ***************************************************************************/
-QImage ImageDenoizeAPI::GetImage()
+void ImageDenoizeAPI::updateProxy()
 {
-    return QImage(m_curImg.data, m_curImg.cols, m_curImg.rows, m_curImg.step, QImage::Format_RGB888).copy();
+    const cv::Mat &original = m_fullGraph.source();
+    cv::Mat proxy;
+    double scale = 1.0;
+    ScopedTimer timer("proxyResize", original.total() * original.elemSize());
+
+    if( (m_previewWidth > 0) && (m_previewHeight > 0) )
+    {
+        scale = std::min((double)m_previewWidth / original.cols,
+                         (double)m_previewHeight / original.rows);
+    }
+
+    if(scale < 1.0)
+    {
+        cv::Size size(std::max(1, cvRound(original.cols * scale)),
+                      std::max(1, cvRound(original.rows * scale)));
+        cv::resize(original, proxy, size, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+        // Image already fits the preview, share its buffer
+        proxy = original;
+    }
+
+    // A proxy sharing the original buffer is accounted as original
+    m_previewGraph.setSource(proxy, m_imageVersion, m_meanHue, m_meanSaturation, StoreIntermediate);
 }
 
 /**
 *************************************************************************
 @verbatim
-+ GetImageSaturation() - Return the mean saturation level of the current
-+                        loaded image
++ bEmitEditedPreview() - Evaluate the preview stack up to the input of the
++                        active denoizing stage and transmit it
 + ----------------
 + Parameters : NONE
-+ Returns    : int the mean saturation level
++ Returns    : TRUE if success; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-int ImageDenoizeAPI::GetImageSaturation()
+bool ImageDenoizeAPI::bEmitEditedPreview()
 {
-    // Convert the image to the HSV color space
-    cv::Mat hsvImage;
-    cv::cvtColor(m_curImg, hsvImage, cv::COLOR_BGR2HSV);
+    cv::Mat out;
 
-    // Split the image into its individual channels
-    std::vector<cv::Mat> channels;
-    cv::split(hsvImage, channels);
+    if(!m_previewGraph.bEvaluate(m_previewGraph.stageInput(), out, &m_control))
+        return false;
 
-    // Retrieve the saturation channel
-    cv::Mat saturation = channels[1];
+    // Transmit processed proxy to who is interested
+    emit updatedEditedImg(ImageFrame(out));
+    emitPreviewStatistics(m_previewGraph.stageInput(), out);
 
-    // Calculate the mean saturation value for the entire image
-    cv::Scalar meanSaturation = cv::mean(saturation);
+    return true;
+}
 
-    qDebug() << "Original Image Saturation: " + QString::number(meanSaturation[0]);
+/**
+*************************************************************************
+@verbatim
++ emitPreviewStatistics() - Transmit the statistics of an edited preview.
++                           They are computed once per node output: the
++                           cache key changes only with the pixels (image
++                           version, operations and proxy size)
++ ----------------
++ Parameters : _index   node of the preview stack; -1 for the proxy
++              _preview output of the node
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::emitPreviewStatistics(int _index, const cv::Mat &_preview)
+{
+    QString key = QString("%1@%2x%3").arg(m_previewGraph.signature(_index)).arg(_preview.cols).arg(_preview.rows);
+    ImageStatistics *statistics = m_statisticsCache.object(key);
 
-    return meanSaturation[0];
+    if(statistics == nullptr)
+    {
+        ScopedTimer timer("previewStatistics", _preview.total() * _preview.elemSize());
+
+        statistics = new ImageStatistics(ImageStatistics::compute(_preview));
+        m_statisticsCache.insert(key, statistics);
+    }
+
+    emit statisticsUpdated(*statistics);
 }
 
 /**
 *************************************************************************
 @verbatim
-+ GetImageHue() - Return the mean hue level of the current
-+                        loaded image
++ makeEditOperation() - Build an editing operation of the stack
 + ----------------
-+ Parameters : NONE
-+ Returns    : int the mean hue level
++ Parameters : _brightness brightness value between 1 and 200
++              _contrast   constrast value between 1 and 200
++              _hue        hue value between 0 and 179
++              _saturation saturation value between 0 and 255
++ Returns    : Operation the editing operation
 @endverbatim
 ***************************************************************************/
-int ImageDenoizeAPI::GetImageHue()
+Operation ImageDenoizeAPI::makeEditOperation(int _brigthness, int _contrast, int _hue, int _saturation)
 {
-    // Convert the image to the HSV color space
-    cv::Mat hsvImage;
-    cv::cvtColor(m_curImg, hsvImage, cv::COLOR_BGR2HSV);
+    Operation operation;
 
-    // Split the image into its individual channels
-    std::vector<cv::Mat> channels;
-    cv::split(hsvImage, channels);
+    operation.type = OperationEdit;
+    operation.brightness = _brigthness;
+    operation.contrast = _contrast;
+    operation.hue = _hue;
+    operation.saturation = _saturation;
+    operation.processType = TypeGaussianBlur;
+    operation.params = ProcessParameters();
 
-    // Retrieve the saturation channel
-    cv::Mat hue = channels[0];
+    return operation;
+}
 
-    // Calculate the mean saturation value for the entire image
-    cv::Scalar meanHue = cv::mean(hue);
+/**
+*************************************************************************
+@verbatim
++ makeDenoizeOperation() - Build a denoizing operation of the stack
++ ----------------
++ Parameters : _type     type of denoizing process
++              _params   checked parameters related to the requested type
++ Returns    : Operation the denoizing operation
+@endverbatim
+***************************************************************************/
+Operation ImageDenoizeAPI::makeDenoizeOperation(ProcessType _type, const ProcessParameters &_params)
+{
+    Operation operation;
 
-    qDebug() << "Original Image Hue: " + QString::number(meanHue[0]);
+    operation.type = OperationDenoize;
+    operation.brightness = 100;
+    operation.contrast = 100;
+    operation.hue = 0;
+    operation.saturation = 0;
+    operation.processType = _type;
+    operation.params = _params;
 
-    return meanHue[0];
+    return operation;
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bSaveImage() - Save image at target location
++ bApplyImageEditing() - Apply Brightness, Constrat, Hue & Saturation to the preview proxy.
++                        The result is transferred via signal. The editing
++                        is the first operation of the stacks: the full
++                        resolution one is only evaluated when needed
++                        (denoizing)
 + ----------------
-+ Parameters : file     string containing filename
-+              image    image data to be saved
++ Parameters : _brightness brightness value between 1 and 200
++              _contrast   constrast value between 1 and 200
++              _hue        hue value between 0 and 179
++              _saturation saturation value between 0 and 255
 + Returns    : TRUE if success; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bSaveImage(QString _file, QImage _image)
+bool ImageDenoizeAPI::bApplyImageEditing(int _brigthness, int _contrast, int _hue, int _saturation)
 {
-    if(_image.byteCount() <= 0)
+    Operation operation;
+
+    if(m_fullGraph.source().empty())
     {
-        qDebug() << __func__ << " Error Image Size == null!";
+        qDebug() << "Error while loading file into Object Mat!";
         return false;
     }
 
-    if(_image.save(_file))
-        return true;
-    else
+    // Check if request brightness value is valid
+    if(!ImageProcessor::bCheckImageEditingValues(_brigthness, _contrast, _hue, _saturation))
     {
-        qDebug() << __func__ << " Could not save image!";
+        qDebug() << __func__ << " Bad brightness value!";
         return false;
     }
+
+    // Downstream nodes are invalidated only if the values changed
+    operation = makeEditOperation(_brigthness, _contrast, _hue, _saturation);
+    m_fullGraph.setOperation(0, operation);
+    m_previewGraph.setOperation(0, operation);
+
+    return bEmitEditedPreview();
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bCheckDenoizeParams() - Checks input parameters related to the current denoizing type.
-+                  If requested parameters are not odd, make them odd
++ bApplyDenoize() - Set the active denoizing stage of the operation stack
++              and transfer its result via signal. In preview mode, the
++              preview proxy stack is evaluated only
 + ----------------
-+ Parameters : type     denoizing process type
-+              params   reference to parameters related to the requested type
-+ Returns    : TRUE if params are OK; FALSE otherwise
++ Parameters : type     type of denoizing process
++              params   parameters related to the requested type
++              bPreview TRUE to process the preview proxy
++ Returns    : TRUE if success; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bCheckDenoizeParams(ProcessType _type, ProcessParameters &params)
+bool ImageDenoizeAPI::bApplyDenoize(ProcessType _type, ProcessParameters _params, bool _bPreview)
 {
-    bool bOK = false;
+    cv::Mat out;
 
-    switch(_type)
+    if(m_fullGraph.source().empty())
     {
-    case TypeGaussianBlur:
-        // Check value ranges according to GaussianBlur() specification
-        if( ((params.kernelSizeHeight > 0) && (params.kernelSizeHeight < 25)) &&
-            ((params.kernelSizeWidth > 0) && (params.kernelSizeWidth < 25)) &&
-            ((params.sigma > 0) && (params.sigma < 100)) )
+        qDebug() << "Error while loading file into Object Mat!";
+        return false;
+    }
+
+    // Check if encoded parameters are in range & make them odd
+    if(!ImageProcessor::bCheckDenoizeParams(_type, _params))
+    {
+        qDebug() << __func__ << " Bad parameters!";
+        return false;
+    }
+
+    if(_bPreview)
+    {
+        // The NlMeans tier costs are those of full resolution images
+        ImageProcessor::UnmeasuredScope unmeasured;
+
+        // Upstream nodes of the preview stack are reused
+        m_previewGraph.setStage(makeDenoizeOperation(_type, _params));
+
+        if(!m_previewGraph.bEvaluate(m_previewGraph.count() - 1, out, &m_control))
+            return false;
+
+        // Transmit denoized proxy to who is interested
+        emit updatedDenoizePreviewImg(ImageFrame(out));
+    }
+    else
+    {
+        int index;
+        QString key;
+
+        m_fullGraph.setStage(makeDenoizeOperation(_type, _params));
+        index = m_fullGraph.count() - 1;
+        key = m_fullGraph.signature(index);
+
+        if(m_fullGraph.bIsCached(index))
         {
-            // Values cannot be odd
-            if(!bIsOdd(params.kernelSizeHeight))
-            {
-                params.kernelSizeHeight += 1;
-            }
-            if(!bIsOdd(params.kernelSizeWidth))
-            {
-                params.kernelSizeWidth += 1;
-            }
+            m_fullGraph.bEvaluate(index, out);
+        }
+        else if(m_resultCache.bLookup(key, out))
+        {
+            qDebug() << "Denoized image found in cache";
+            m_fullGraph.setResult(index, out);
+        }
+        else
+        {
+            // Each computed node allocates an image of the source size
+            qint64 bytes = m_fullGraph.source().total() * m_fullGraph.source().elemSize();
+
+            if(!bReserveMemory(bytes * m_fullGraph.pendingNodes(index)))
+                return false;
 
-            bOK = true;
+            // Only the nodes invalidated since the last evaluation are computed
+            if(!m_fullGraph.bEvaluate(index, out, &m_control))
+                return false;
+
+            m_resultCache.insert(key, out);
         }
-        break;
-    case TypeMedianBlur:
-        // Check value ranges according to MedianBlur() specification
-        if( (params.aperture > 1) && (params.aperture < 25) )
+
+        // Transmit denoized image to who is interested
+        emit updatedDenoizeImg(ImageFrame(out));
+        emit cacheStatistics(m_resultCache.hits(), m_resultCache.misses(), m_resultCache.bytes() / (1024.0 * 1024.0));
+
+        // Report measured cost of the tier (full resolution only)
+        if( (_type == TypeNlMeans) && (ImageProcessor::GetNlMeansTier(_params) >= 0) )
         {
-            // Values cannot be odd
-            if(!bIsOdd(params.aperture))
-            {
-                params.aperture +=1;
-            }
-            bOK = true;
+            int tier = ImageProcessor::GetNlMeansTier(_params);
+
+            if(ImageProcessor::GetNlMeansTierCost((NlMeansTier)tier) > 0)
+                emit nlMeansTierCost(tier, ImageProcessor::GetNlMeansTierCost((NlMeansTier)tier));
         }
-        break;
-    case TypeNlMeans:
-        bOK = true;
-        break;
-    default:
-        bOK = false;
     }
 
-    return bOK;
+    return true;
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bCheckImageEditingValues() - Checks input brightness & contrast values
++ bChainDenoize() - Commit the last full resolution denoizing: the active
++                   stage is sealed in both stacks so that its result is
++                   the input of the next denoizing
 + ----------------
-+ Parameters : brightness value of the brightness
-+              constrast value of the constrast
-+ Returns    : TRUE if params are OK; FALSE otherwise
++ Parameters : NONE
++ Returns    : TRUE if success; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bCheckImageEditingValues(int _brightness, int _contrast, int _hue, int _saturation)
+bool ImageDenoizeAPI::bChainDenoize()
 {
-    bool bOK = true;
+    if(!m_fullGraph.bHasStage())
+    {
+        qDebug() << __func__ << " No denoized image to chain!";
+        return false;
+    }
 
-    if( (_brightness < 1) || (_brightness > 200) )
-        bOK = false;
+    // Preview stack shall match the committed full resolution operation
+    m_previewGraph.setStage(m_fullGraph.operation(m_fullGraph.count() - 1));
 
-    if( (_contrast < 1) || (_contrast > 200) )
-        bOK = false;
+    m_fullGraph.seal();
+    m_previewGraph.seal();
 
-    if( (_hue < 0) || (_hue > 179) )
-        bOK = false;
+    // Committed result is the new base image
+    return bEmitEditedPreview();
+}
 
-    if( (_saturation < 0) || (_saturation > 255) )
-        bOK = false;
+/**
+*************************************************************************
+@verbatim
++ bCompareDenoizers() - Run the candidate denoizings concurrently on the
++                       input of the active stage (full resolution) and
++                       transfer their timings, scores & crops via signal
++ ----------------
++ Parameters : _candidates  methods & parameters to compare
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageDenoizeAPI::bCompareDenoizers(QVector<DenoizeCandidate> _candidates)
+{
+    Comparison comparison;
+    cv::Mat input;
+    qint64 bytes;
 
-    return bOK;
+    if(m_fullGraph.source().empty())
+    {
+        qDebug() << "Error while loading file into Object Mat!";
+        return false;
+    }
+
+    // Check if encoded parameters are in range & make them odd
+    for(int i = 0; i < _candidates.size(); i++)
+    {
+        if(!ImageProcessor::bCheckDenoizeParams(_candidates[i].type, _candidates[i].params))
+        {
+            qDebug() << __func__ << " Bad parameters!";
+            return false;
+        }
+    }
+
+    // Input node and one output per candidate
+    bytes = m_fullGraph.source().total() * m_fullGraph.source().elemSize();
+    if(!bReserveMemory(bytes * (m_fullGraph.pendingNodes(m_fullGraph.stageInput()) + _candidates.size())))
+        return false;
+
+    if(!m_fullGraph.bEvaluate(m_fullGraph.stageInput(), input, &m_control))
+        return false;
+
+    // Comparison progress restarts after the evaluation of the input
+    m_control.resetProgress();
+    if(!DenoizerComparison::bRun(input, _candidates, comparison, &m_control))
+        return false;
+
+    // Transmit comparison to who is interested
+    emit comparisonReady(comparison);
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetImageSaturation() - Return the mean saturation level of the current
++                        loaded image (no conversion, level computed at load)
++ ----------------
++ Parameters : NONE
++ Returns    : int the mean saturation level
+@endverbatim
+***************************************************************************/
+int ImageDenoizeAPI::GetImageSaturation()
+{
+    // Computed by the worker when the image is loaded
+    QMutexLocker locker(&m_statisticsMutex);
+    return m_meanSaturation;
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetImageHue() - Return the mean hue level of the current
++                        loaded image (no conversion, level computed at load)
++ ----------------
++ Parameters : NONE
++ Returns    : int the mean hue level
+@endverbatim
+***************************************************************************/
+int ImageDenoizeAPI::GetImageHue()
+{
+    // Computed by the worker when the image is loaded
+    QMutexLocker locker(&m_statisticsMutex);
+    return m_meanHue;
 }
 
 /**
 *************************************************************************
 @verbatim
-+ bCheckParams() - Checks if input integer is an odd number
++ GetImageStatistics() - Return the histograms of the current loaded
++                        image (no scan, computed at load)
 + ----------------
-+ Parameters : num    input number
-+ Returns    : TRUE if integer is an odd number; FALSE otherwise
++ Parameters : NONE
++ Returns    : ImageStatistics the statistics of the original image
 @endverbatim
 ***************************************************************************/
-bool ImageDenoizeAPI::bIsOdd(int _num)
+ImageStatistics ImageDenoizeAPI::GetImageStatistics()
 {
-  int i = 0;
-  bool odd = false;
+    QMutexLocker locker(&m_statisticsMutex);
 
-  while (i != _num)
-  {
-    odd = !odd;
-    i = i + 1;
-  }
+    return m_sourceStatistics;
+}
 
-  return odd;
+/**
+*************************************************************************
+@verbatim
++ requestSave() - Save an image at target location. The image is encoded
++                 directly from the frame on the encoder thread, the
++                 result is reported by imageSaved()
++ ----------------
++ Parameters : _frame   image to be saved (BGR)
++              _file    target file, its suffix selects the format
++              _options encoder options of the format
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageDenoizeAPI::requestSave(const ImageFrame &_frame, QString _file, const EncoderOptions &_options)
+{
+    m_encoder.requestSave(_frame, _file, _options);
 }
+
@@ -2,6 +2,11 @@
 #define IMAGEDENOIZE_H
 
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QCache>
+#include <QList>
+#include <QMetaType>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -9,22 +14,55 @@
 
 #include <QPixmap>
 
+#include "denoizercomparison.h"
+#include "filterkernels.h"
+#include "imageencoder.h"
+#include "imageframe.h"
+#include "imageprocessor.h"
+#include "imagestatistics.h"
+#include "imagestore.h"
+#include "imagekernels.h"
+#include "operationgraph.h"
+#include "processtypes.h"
+#include "profiler.h"
+#include "resultcache.h"
+#include "taskcontrol.h"
+#include "tiledexecutor.h"
+#include "workpool.h"
+
 typedef enum
 {
-    TypeGaussianBlur = 0,
-    TypeMedianBlur = 1,
-    TypeNlMeans = 2
-} ProcessType;
+    JobLoadImage = 0,
+    JobImageEditing = 1,
+    JobDenoize = 2,
+    JobDenoizePreview = 3,
+    JobPreviewSize = 4,
+    JobChain = 5,
+    JobCompare = 6
+} JobType;
 
 typedef struct
 {
-    // For GaussianBlur
-    int sigma;
-    int kernelSizeWidth;
-    int kernelSizeHeight;
-    // For MedianBlur
-    int aperture;
-} ProcessParameters;
+    JobType type;
+    // For JobLoadImage
+    QString file;
+    // For JobImageEditing
+    int brightness;
+    int contrast;
+    int hue;
+    int saturation;
+    // For JobDenoize & JobDenoizePreview
+    ProcessType processType;
+    ProcessParameters params;
+    // For JobPreviewSize
+    int previewWidth;
+    int previewHeight;
+    // For JobCompare
+    QVector<DenoizeCandidate> candidates;
+} Job;
+
+// Transferred to the UI through queued connections
+Q_DECLARE_METATYPE(ImageStatistics)
 
 class ImageDenoizeAPI : public QThread
 {
@@ -35,41 +73,126 @@ public:
 
 public slots:
     // Thread management
-    void start(void) { bRunning = true; QThread::start(); }
-    void stop(void) { bRunning = false; QThread::exit(); }
-
-    // Load image
-    bool bLoadImage(QString _file);
-
-    // Image processes
-    bool bApplyImageEditing(int _brigthness, int _contrast, int _hue, int _saturation);
-    bool bApplyDenoize(ProcessType _type, ProcessParameters _params);
+    void start(void);
+    void stop(void);
+
+    // Job requests (thread safe, processed asynchronously by the worker thread)
+    void requestLoadImage(QString _file);
+    void requestImageEditing(int _brigthness, int _contrast, int _hue, int _saturation);
+    void requestDenoize(ProcessType _type, ProcessParameters _params, bool _bPreview = false);
+    void requestChain(void);
+    void requestCompare(QVector<DenoizeCandidate> _candidates);
+    void setPreviewSize(int _width, int _height);
+    void setResultCacheBudget(qint64 _bytes);
+    void setMemoryBudget(qint64 _bytes);
+    void cancel(void);
 
     // Getter
-    QImage GetImage();
     int GetImageSaturation();
     int GetImageHue();
+    ImageStatistics GetImageStatistics();
 
-    // Save file
-    bool bSaveImage(QString _file, QImage _image);
+    // Save file (encoded asynchronously from the frame, see imageSaved())
+    void requestSave(const ImageFrame &_frame, QString _file, const EncoderOptions &_options);
 
     // Add other processing functions;
 
-private slots:
-    void run();
+    // Stateless processing lives in ImageProcessor (Qt-free)
+    static bool bProbeImage(const QString &_file, QSize &_size, QString &_format);
+
+protected:
+    void run() override;
 
 signals:
-    void updatedDenoizeImg(const QImage &_frame);
-    void updatedEditedImg(const QImage &_frame);
+    void updatedDenoizeImg(const ImageFrame &_frame);
+    void updatedDenoizePreviewImg(const ImageFrame &_frame);
+    void updatedEditedImg(const ImageFrame &_frame);
+    void imageLoaded(int _hue, int _saturation);
+    // Statistics of the image transmitted by updatedEditedImg()
+    void statisticsUpdated(const ImageStatistics &_statistics);
+    void jobFailed(int _type);
+    void nlMeansTierCost(int _tier, double _msPerMegaPixel);
+    void cacheStatistics(int _hits, int _misses, double _megaBytes);
+    void comparisonReady(const Comparison &_comparison);
+    // Emitted after each job when the Profiler is enabled
+    void stageTimings(int _type, const StageTimings &_timings);
+    // Emitted after each job: bytes held by all the images (see ImageStore)
+    void memoryUsage(qint64 _bytes, qint64 _budgetBytes);
+    // Emitted instead of jobFailed() when a job is refused by the memory budget
+    void memoryBudgetExceeded(int _type, double _requiredMegaBytes);
+    // Progress of the job being processed, between 0 and 100
+    void progress(int _percent);
+    // Emitted instead of jobFailed() when a job is cancelled (newer request or cancel())
+    void jobCancelled(int _type);
+    // Emitted once a file requested by requestSave() is written (or failed)
+    void imageSaved(const EncodeResult &_result);
 
 private:
-    bool bCheckDenoizeParams(ProcessType _type, ProcessParameters &_params);
-    bool bCheckImageEditingValues(int _brightness, int _contrast, int _hue, int _saturation);
-    bool bIsOdd(int _num);
+    // Job management
+    void postJob(const Job &_job);
+    void executeJob(const Job &_job);
 
-    cv::Mat m_originalImg;
-    cv::Mat m_curImg;
+    // Load image
+    bool bLoadImage(QString _file);
+    void paintReducedImage(const QString &_file, const QSize &_size, const QString &_format);
+
+    // Image processes
+    bool bApplyImageEditing(int _brigthness, int _contrast, int _hue, int _saturation);
+    bool bApplyDenoize(ProcessType _type, ProcessParameters _params, bool _bPreview);
+    bool bChainDenoize();
+    bool bCompareDenoizers(QVector<DenoizeCandidate> _candidates);
+    bool bReserveMemory(qint64 _bytes);
+
+    // Preview proxy
+    bool bResizePreview(int _width, int _height);
+    void updateProxy();
+    bool bEmitEditedPreview();
+    void emitPreviewStatistics(int _index, const cv::Mat &_preview);
+
+    static Operation makeEditOperation(int _brigthness, int _contrast, int _hue, int _saturation);
+    static Operation makeDenoizeOperation(ProcessType _type, const ProcessParameters &_params);
+
+
+    // Incremented each time a new image is loaded
+    quint64 m_imageVersion;
+    int m_previewWidth;
+    int m_previewHeight;
+
+    // Operation stacks (editing, denoizing, ...) applied to the original
+    // image and to its preview proxy. Nodes cache their outputs
+    OperationGraph m_fullGraph;
+    OperationGraph m_previewGraph;
+
+    // Mean levels of the original image, reference for hue & saturation editing
+    int m_meanHue;
+    int m_meanSaturation;
+
+    // Statistics of the original image (computed at load, read by the UI)
+    // and of the edited previews, keyed by signature & proxy size
+    QMutex m_statisticsMutex;
+    ImageStatistics m_sourceStatistics;
+    QCache<QString, ImageStatistics> m_statisticsCache;
+
+    // Full resolution denoized images already computed, keyed by signature
+    ResultCache m_resultCache;
+
+    // Memory budget: evictors registered in the ImageStore, bytes of the
+    // last refused allocation
+    int m_storeEvictorIds[2];
+    qint64 m_requiredBytes;
+
+    QMutex m_jobMutex;
+    QWaitCondition m_jobAvailable;
+    QList<Job> m_jobs;
     bool bRunning;
+
+    // Job being processed and its cancellation & progress (reset for each job)
+    bool m_bJobRunning;
+    JobType m_runningJobType;
+    TaskControl m_control;
+
+    // Saves run on the encoder thread, never on the UI or worker thread
+    ImageEncoder m_encoder;
 };
 
 #endif // IMAGEDENOIZE_H
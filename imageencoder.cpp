@@ -0,0 +1,218 @@
+#include "imageencoder.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "profiler.h"
+#include "workpool.h"
+
+// Formats written by the encoder (lower case suffixes)
+static const char *g_encoderSuffixes[] = { "jpg", "jpeg", "png", "tif", "tiff", "bmp" };
+
+ImageEncoder::ImageEncoder(QObject *_parent) :
+    QObject(_parent),
+    m_bSaving(false)
+{
+    // Results are transferred through queued connections
+    qRegisterMetaType<EncodeResult>("EncodeResult");
+}
+
+ImageEncoder::~ImageEncoder()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Pending saves are completed, never left half written
+    while(m_bSaving)
+    {
+        m_idle.wait(&m_mutex);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestSave() - Queue the save of a frame. The caller is not blocked,
++                 saved() is emitted once the file is written
++ ----------------
++ Parameters : _frame   image to save (BGR)
++              _file    target file, its suffix selects the format
++              _options format options
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageEncoder::requestSave(const ImageFrame &_frame, const QString &_file, const EncoderOptions &_options)
+{
+    QMutexLocker locker(&m_mutex);
+    SaveRequest request = { _frame, _file, _options };
+
+    m_saves.enqueue(request);
+
+    // A single task writes the saves, in request order
+    if(!m_bSaving)
+    {
+        m_bSaving = true;
+        WorkPool::instance().submit([this]() { drainSaves(); });
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ drainSaves() - Write the queued saves, run by the work pool. The frames
++                keep the images alive (shared, read-only) until encoded
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageEncoder::drainSaves()
+{
+    while(true)
+    {
+        SaveRequest request;
+        EncodeResult result;
+
+        {
+            QMutexLocker locker(&m_mutex);
+
+            if(m_saves.isEmpty())
+            {
+                m_bSaving = false;
+                m_idle.wakeAll();
+                return;
+            }
+            request = m_saves.dequeue();
+        }
+
+        bEncode(request.frame.mat(), request.file, request.options, result);
+
+        emit saved(result);
+    }
+}
+
+EncoderOptions ImageEncoder::defaultOptions()
+{
+    EncoderOptions options;
+
+    // OpenCV defaults
+    options.jpegQuality = 95;
+    options.bJpegProgressive = false;
+    options.bJpegOptimize = false;
+    options.pngCompression = 1;
+    options.tiffCompression = TiffCompressionLzw;
+
+    return options;
+}
+
+bool ImageEncoder::bIsSupportedSuffix(const QString &_suffix)
+{
+    for(const char *suffix : g_encoderSuffixes)
+    {
+        if(_suffix.compare(suffix, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+*************************************************************************
+@verbatim
++ encodeParameters() - Return the cv::imencode() parameters of a format
++ ----------------
++ Parameters : _suffix  file suffix of the format
++              _options format options
++ Returns    : std::vector<int> (parameter, value) pairs
+@endverbatim
+***************************************************************************/
+std::vector<int> ImageEncoder::encodeParameters(const QString &_suffix, const EncoderOptions &_options)
+{
+    QString suffix = _suffix.toLower();
+
+    if( (suffix == "jpg") || (suffix == "jpeg") )
+    {
+        return { cv::IMWRITE_JPEG_QUALITY, _options.jpegQuality,
+                 cv::IMWRITE_JPEG_PROGRESSIVE, _options.bJpegProgressive ? 1 : 0,
+                 cv::IMWRITE_JPEG_OPTIMIZE, _options.bJpegOptimize ? 1 : 0 };
+    }
+    else if(suffix == "png")
+    {
+        return { cv::IMWRITE_PNG_COMPRESSION, _options.pngCompression };
+    }
+    else if( (suffix == "tif") || (suffix == "tiff") )
+    {
+        return { cv::IMWRITE_TIFF_COMPRESSION, (int)_options.tiffCompression };
+    }
+
+    return std::vector<int>();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bEncode() - Encode an image in memory and write it. Encoding and
++             writing durations are measured separately
++ ----------------
++ Parameters : _img     image to save (BGR)
++              _file    target file, its suffix selects the format
++              _options format options
++              _result  receives the durations & sizes
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageEncoder::bEncode(const cv::Mat &_img, const QString &_file, const EncoderOptions &_options, EncodeResult &_result)
+{
+    QString suffix = QFileInfo(_file).suffix().toLower();
+    std::vector<uchar> buffer;
+    QElapsedTimer timer;
+    QFile file(_file);
+    bool bEncoded;
+
+    _result.file = _file;
+    _result.bOK = false;
+    _result.encodeMs = 0;
+    _result.writeMs = 0;
+    _result.bytes = 0;
+    _result.rawBytes = _img.total() * _img.elemSize();
+
+    if(_img.empty() || !bIsSupportedSuffix(suffix))
+    {
+        qDebug() << __func__ << " Unsupported image or format!";
+        return false;
+    }
+
+    timer.start();
+    {
+        ScopedTimer scopedTimer("encode", _result.rawBytes);
+        bEncoded = cv::imencode(("." + suffix).toStdString(), _img, buffer, encodeParameters(suffix, _options));
+    }
+    _result.encodeMs = timer.nsecsElapsed() / 1e6;
+
+    if(!bEncoded)
+    {
+        qDebug() << __func__ << " Could not encode image!";
+        return false;
+    }
+
+    timer.restart();
+    {
+        ScopedTimer scopedTimer("write", buffer.size());
+
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+           (file.write((const char *)buffer.data(), (qint64)buffer.size()) != (qint64)buffer.size()))
+        {
+            qDebug() << __func__ << " Could not save image!";
+            return false;
+        }
+        file.close();
+    }
+    _result.writeMs = timer.nsecsElapsed() / 1e6;
+    _result.bytes = (qint64)buffer.size();
+    _result.bOK = true;
+
+    return true;
+}
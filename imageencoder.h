@@ -0,0 +1,89 @@
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QWaitCondition>
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "imageframe.h"
+
+// TIFF compression schemes (libtiff codes)
+typedef enum
+{
+    TiffCompressionNone = 1,
+    TiffCompressionLzw = 5,
+    TiffCompressionDeflate = 8,
+    TiffCompressionPackBits = 32773
+} TiffCompression;
+
+typedef struct
+{
+    // JPEG quality between 0 and 100, progressive & optimized Huffman tables
+    int jpegQuality;
+    bool bJpegProgressive;
+    bool bJpegOptimize;
+    // PNG zlib level between 0 (fastest) and 9 (smallest)
+    int pngCompression;
+    TiffCompression tiffCompression;
+} EncoderOptions;
+
+typedef struct
+{
+    QString file;
+    bool bOK;
+    double encodeMs;
+    double writeMs;
+    // Size of the file and of the uncompressed image
+    qint64 bytes;
+    qint64 rawBytes;
+} EncodeResult;
+
+Q_DECLARE_METATYPE(EncodeResult)
+
+/*
+ * Encode images directly from their cv::Mat, with tunable format options.
+ * Asynchronous saves run on the work pool one at a time, in request
+ * order, and are reported by saved().
+ */
+class ImageEncoder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ImageEncoder(QObject *_parent = nullptr);
+    ~ImageEncoder();
+
+    void requestSave(const ImageFrame &_frame, const QString &_file, const EncoderOptions &_options);
+
+    static EncoderOptions defaultOptions();
+    static bool bIsSupportedSuffix(const QString &_suffix);
+    static bool bEncode(const cv::Mat &_img, const QString &_file, const EncoderOptions &_options, EncodeResult &_result);
+    static std::vector<int> encodeParameters(const QString &_suffix, const EncoderOptions &_options);
+
+signals:
+    void saved(const EncodeResult &_result);
+
+private:
+    typedef struct
+    {
+        ImageFrame frame;
+        QString file;
+        EncoderOptions options;
+    } SaveRequest;
+
+    void drainSaves();
+
+    // Saves not started yet, and whether a pool task is writing them
+    QMutex m_mutex;
+    QWaitCondition m_idle;
+    QQueue<SaveRequest> m_saves;
+    bool m_bSaving;
+};
+
+#endif // IMAGEENCODER_H
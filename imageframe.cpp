@@ -0,0 +1,96 @@
+#include "imageframe.h"
+#include "profiler.h"
+
+#include <opencv2/imgproc.hpp>
+
+/**
+*************************************************************************
+@verbatim
++ releaseImageRef() - QImage cleanup function releasing the reference
++                     holding the buffer
++ ----------------
++ Parameters : _info    heap allocated ImageRef
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void releaseImageRef(void *_info)
+{
+    delete static_cast<ImageRef *>(_info);
+}
+
+ImageFrame::ImageFrame()
+{
+
+}
+
+/**
+*************************************************************************
+@verbatim
++ ImageFrame() - Wrap a BGR image. The buffer is shared, not copied: the
++                caller shall not write into it afterwards
++ ----------------
++ Parameters : _img     8-bit BGR image to wrap
+@endverbatim
+***************************************************************************/
+ImageFrame::ImageFrame(const cv::Mat &_img) :
+    m_img(_img, StoreDisplay)
+{
+
+}
+
+bool ImageFrame::isNull() const
+{
+    return m_img.empty();
+}
+
+int ImageFrame::width() const
+{
+    return m_img.mat().cols;
+}
+
+int ImageFrame::height() const
+{
+    return m_img.mat().rows;
+}
+
+const cv::Mat &ImageFrame::mat() const
+{
+    return m_img.mat();
+}
+
+/**
+*************************************************************************
+@verbatim
++ toQImage() - Return a read-only QImage view on the frame buffer. The
++              view holds a reference on the buffer until it is destroyed.
++              No channel swap nor copy is needed with Qt >= 5.14
++ ----------------
++ Parameters : NONE
++ Returns    : QImage the view on the frame
+@endverbatim
+***************************************************************************/
+QImage ImageFrame::toQImage() const
+{
+    const cv::Mat &img = m_img.mat();
+    ImageRef *ref;
+
+    if(img.empty())
+        return QImage();
+
+    ScopedTimer timer("toQImage", img.total() * img.elemSize());
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    ref = new ImageRef(m_img);
+
+    return QImage((const uchar *)img.data, img.cols, img.rows, (int)img.step,
+                  QImage::Format_BGR888, releaseImageRef, ref);
+#else
+    // No BGR format available, swap channels once into a buffer owned by the view
+    cv::Mat rgb;
+    cv::cvtColor(img, rgb, cv::COLOR_BGR2RGB);
+    ref = new ImageRef(rgb, StoreDisplay);
+
+    return QImage((const uchar *)rgb.data, rgb.cols, rgb.rows, (int)rgb.step,
+                  QImage::Format_RGB888, releaseImageRef, ref);
+#endif
+}
@@ -0,0 +1,37 @@
+#ifndef IMAGEFRAME_H
+#define IMAGEFRAME_H
+
+#include <QImage>
+#include <QMetaType>
+
+#include <opencv2/core.hpp>
+
+#include "imagestore.h"
+
+/*
+ * Reference counted, read-only frame shared between the processing
+ * thread and the UI. The pixel buffer of the wrapped cv::Mat is never
+ * copied: copies of the frame and the QImage views share it. Buffers only
+ * referenced by frames are accounted as display memory.
+ */
+class ImageFrame
+{
+public:
+    ImageFrame();
+    explicit ImageFrame(const cv::Mat &_img);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    const cv::Mat &mat() const;
+
+    // Read-only QImage view on the frame buffer
+    QImage toQImage() const;
+
+private:
+    ImageRef m_img;
+};
+
+Q_DECLARE_METATYPE(ImageFrame)
+
+#endif // IMAGEFRAME_H
@@ -0,0 +1,591 @@
+#include "imagekernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGEKERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Pixels processed per SIMD block
+#define KERNEL_BLOCK 8
+
+// Hue in sixths of a turn (one per sector of the HSV hexcone)
+#define KERNEL_HUE_SECTORS 6.0f
+
+typedef void (*ColorEditRowFunc)(const ColorEditKernel &, const unsigned char *, unsigned char *, int, bool);
+
+/**
+*************************************************************************
+@verbatim
++ clampToByte() - Round a float to the nearest integer and clamp it to
++                 the [0, 255] range
++ ----------------
++ Parameters : _value   value to convert
++ Returns    : unsigned char the converted value
+@endverbatim
+***************************************************************************/
+static inline unsigned char clampToByte(float _value)
+{
+    long v = std::lrint(_value);
+
+    if(v < 0)
+        return 0;
+    if(v > 255)
+        return 255;
+
+    return (unsigned char)v;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bScaleUsesFma() - TRUE if cv::Mat::convertTo() scales with a fused
++                   multiply-add (its AVX2 implementation), which rounds
++                   some .5 ties differently than a multiply then an add
++ ----------------
++ Parameters : NONE
++ Returns    : TRUE if the LUT shall be computed with std::fma()
+@endverbatim
+***************************************************************************/
+static bool bScaleUsesFma()
+{
+#ifdef IMAGEKERNELS_X86
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+/**
+*************************************************************************
+@verbatim
++ buildColorEditKernel() - Precompute the tables of the fused editing kernel.
++                          Contrast & brightness are stored in a LUT matching
++                          cv::Mat::convertTo() rounding. Hue rotation and
++                          saturation scaling are applied in the HSV model
++                          of cv::cvtColor(), without its 8-bit quantization
++ ----------------
++ Parameters : _kernel          kernel to build
++              _brightness      brightness value between 1 and 200 (100 = none)
++              _contrast        contrast value between 1 and 200 (100 = none)
++              _hueShiftDeg     hue rotation in degrees
++              _saturationScale saturation factor (1.0 = none)
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void buildColorEditKernel(ColorEditKernel &_kernel, int _brightness, int _contrast, float _hueShiftDeg, float _saturationScale)
+{
+    const float alpha = (float)_contrast / 100;
+    const float beta = (float)(_brightness - 100);
+    const bool bFused = bScaleUsesFma();
+
+    // Contrast & brightness
+    for(int i = 0; i < 256; i++)
+    {
+        _kernel.lut[i] = clampToByte(bFused ? std::fma((float)i, alpha, beta) : i * alpha + beta);
+    }
+
+    // Hue rotation within [0, 6) sectors
+    _kernel.hueShift = std::fmod(_hueShiftDeg / 60.0f, KERNEL_HUE_SECTORS);
+    if(_kernel.hueShift < 0)
+        _kernel.hueShift += KERNEL_HUE_SECTORS;
+
+    _kernel.saturationScale = std::max(_saturationScale, 0.0f);
+    _kernel.bLutOnly = (_kernel.hueShift == 0.0f) && (_kernel.saturationScale == 1.0f);
+}
+
+/**
+*************************************************************************
+@verbatim
++ hueWeight() - Weight of the chroma removed from a channel of a hue, as
++               cv::cvtColor() HSV to BGR: V - V.S.weight(n), n = 1 (blue),
++               3 (green) or 5 (red)
++ ----------------
++ Parameters : _hue     hue in sectors, [0, 6)
++              _channel channel offset n
++ Returns    : float the weight, in [0, 1]
+@endverbatim
+***************************************************************************/
+static inline float hueWeight(float _hue, float _channel)
+{
+    float k = _channel + _hue;
+
+    if(k >= KERNEL_HUE_SECTORS)
+        k -= KERNEL_HUE_SECTORS;
+
+    return std::min(std::max(std::min(k, 4.0f - k), 0.0f), 1.0f);
+}
+
+/**
+*************************************************************************
+@verbatim
++ editRowScalar() - Portable implementation of the fused editing kernel
++                   for one row
++ ----------------
++ Parameters : _kernel      kernel tables
++              _src         source BGR row
++              _dst         destination row
++              _width       number of pixels
++              _bRgbOutput  TRUE to write RGB order
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void editRowScalar(const ColorEditKernel &_kernel, const unsigned char *_src, unsigned char *_dst, int _width, bool _bRgbOutput)
+{
+    const int first = _bRgbOutput ? 2 : 0;
+    const int last = _bRgbOutput ? 0 : 2;
+
+    for(int x = 0; x < _width; x++)
+    {
+        float b = _kernel.lut[_src[3 * x + 0]];
+        float g = _kernel.lut[_src[3 * x + 1]];
+        float r = _kernel.lut[_src[3 * x + 2]];
+        // Value, chroma (V.S) & hue of the pixel
+        float v = std::max(std::max(b, g), r);
+        float chroma = v - std::min(std::min(b, g), r);
+        float inverse = (chroma > 0) ? 1 / chroma : 0;
+        float hue;
+
+        if(v == r)
+            hue = (g - b) * inverse;
+        else if(v == g)
+            hue = 2 + (b - r) * inverse;
+        else
+            hue = 4 + (r - g) * inverse;
+
+        hue += _kernel.hueShift;
+        if(hue < 0)
+            hue += KERNEL_HUE_SECTORS;
+        if(hue >= KERNEL_HUE_SECTORS)
+            hue -= KERNEL_HUE_SECTORS;
+
+        // Saturation up to 1
+        chroma = std::min(chroma * _kernel.saturationScale, v);
+
+        _dst[3 * x + first] = clampToByte(v - chroma * hueWeight(hue, 1));
+        _dst[3 * x + 1]     = clampToByte(v - chroma * hueWeight(hue, 3));
+        _dst[3 * x + last]  = clampToByte(v - chroma * hueWeight(hue, 5));
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ lutRow() - Contrast & brightness only implementation for one row, used
++            when hue and saturation are untouched
++ ----------------
++ Parameters : _kernel      kernel tables
++              _src         source BGR row
++              _dst         destination row
++              _width       number of pixels
++              _bRgbOutput  TRUE to write RGB order
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void lutRow(const ColorEditKernel &_kernel, const unsigned char *_src, unsigned char *_dst, int _width, bool _bRgbOutput)
+{
+    if(_bRgbOutput)
+    {
+        for(int x = 0; x < _width; x++)
+        {
+            unsigned char b = _kernel.lut[_src[3 * x + 0]];
+            unsigned char g = _kernel.lut[_src[3 * x + 1]];
+            unsigned char r = _kernel.lut[_src[3 * x + 2]];
+
+            _dst[3 * x + 0] = r;
+            _dst[3 * x + 1] = g;
+            _dst[3 * x + 2] = b;
+        }
+    }
+    else
+    {
+        for(int x = 0; x < 3 * _width; x++)
+        {
+            _dst[x] = _kernel.lut[_src[x]];
+        }
+    }
+}
+
+#ifdef IMAGEKERNELS_X86
+/**
+*************************************************************************
+@verbatim
++ gatherBlock() - Deinterleave a block of pixels through the LUT into
++                 planar float arrays, one by one (SSE2 has no byte
++                 shuffle)
++ ----------------
++ Parameters : _kernel  kernel tables
++              _src     first source pixel of the block
++              _b/_g/_r planar outputs of KERNEL_BLOCK floats
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static inline void gatherBlock(const ColorEditKernel &_kernel, const unsigned char *_src, float *_b, float *_g, float *_r)
+{
+    for(int i = 0; i < KERNEL_BLOCK; i++)
+    {
+        _b[i] = _kernel.lut[_src[3 * i + 0]];
+        _g[i] = _kernel.lut[_src[3 * i + 1]];
+        _r[i] = _kernel.lut[_src[3 * i + 2]];
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ scatterBlock() - Interleave a block of planar clamped integers into the
++                  destination row
++ ----------------
++ Parameters : _dst         first destination pixel of the block
++              _c0/_c1/_c2  planar channels in BGR order
++              _bRgbOutput  TRUE to write RGB order
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static inline void scatterBlock(unsigned char *_dst, const int *_c0, const int *_c1, const int *_c2, bool _bRgbOutput)
+{
+    const int *first = _bRgbOutput ? _c2 : _c0;
+    const int *last = _bRgbOutput ? _c0 : _c2;
+
+    for(int i = 0; i < KERNEL_BLOCK; i++)
+    {
+        _dst[3 * i + 0] = (unsigned char)first[i];
+        _dst[3 * i + 1] = (unsigned char)_c1[i];
+        _dst[3 * i + 2] = (unsigned char)last[i];
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ editRowSSE() - SSE implementation of the fused editing kernel for one
++                row, as editRowScalar()
++ ----------------
++ Parameters : see editRowScalar()
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+__attribute__((target("sse2")))
+static void editRowSSE(const ColorEditKernel &_kernel, const unsigned char *_src, unsigned char *_dst, int _width, bool _bRgbOutput)
+{
+    alignas(16) float b[KERNEL_BLOCK];
+    alignas(16) float g[KERNEL_BLOCK];
+    alignas(16) float r[KERNEL_BLOCK];
+    alignas(16) int out[3][KERNEL_BLOCK];
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 sectors = _mm_set1_ps(KERNEL_HUE_SECTORS);
+    const __m128 max = _mm_set1_ps(255.0f);
+    const __m128 hueShift = _mm_set1_ps(_kernel.hueShift);
+    const __m128 saturationScale = _mm_set1_ps(_kernel.saturationScale);
+    const __m128 channels[3] = { one, _mm_set1_ps(3.0f), _mm_set1_ps(5.0f) };
+    int x = 0;
+
+    for(; x + KERNEL_BLOCK <= _width; x += KERNEL_BLOCK)
+    {
+        gatherBlock(_kernel, _src + 3 * x, b, g, r);
+
+        for(int h = 0; h < KERNEL_BLOCK; h += 4)
+        {
+            __m128 vb = _mm_load_ps(b + h);
+            __m128 vg = _mm_load_ps(g + h);
+            __m128 vr = _mm_load_ps(r + h);
+            __m128 v = _mm_max_ps(_mm_max_ps(vb, vg), vr);
+            __m128 chroma = _mm_sub_ps(v, _mm_min_ps(_mm_min_ps(vb, vg), vr));
+            // 1 / 0 is masked out (gray pixels have no hue)
+            __m128 inverse = _mm_and_ps(_mm_cmpgt_ps(chroma, zero), _mm_div_ps(one, chroma));
+            __m128 bRed = _mm_cmpeq_ps(v, vr);
+            __m128 bGreen = _mm_andnot_ps(bRed, _mm_cmpeq_ps(v, vg));
+            __m128 bBlue = _mm_andnot_ps(_mm_or_ps(bRed, bGreen), _mm_cmpeq_ps(v, v));
+            __m128 hue;
+
+            hue = _mm_or_ps(_mm_or_ps(_mm_and_ps(bRed, _mm_mul_ps(_mm_sub_ps(vg, vb), inverse)),
+                                      _mm_and_ps(bGreen, _mm_add_ps(_mm_set1_ps(2.0f), _mm_mul_ps(_mm_sub_ps(vb, vr), inverse)))),
+                            _mm_and_ps(bBlue, _mm_add_ps(four, _mm_mul_ps(_mm_sub_ps(vr, vg), inverse))));
+            hue = _mm_add_ps(hue, hueShift);
+            hue = _mm_add_ps(hue, _mm_and_ps(_mm_cmplt_ps(hue, zero), sectors));
+            hue = _mm_sub_ps(hue, _mm_and_ps(_mm_cmpge_ps(hue, sectors), sectors));
+            chroma = _mm_min_ps(_mm_mul_ps(chroma, saturationScale), v);
+
+            for(int c = 0; c < 3; c++)
+            {
+                __m128 k = _mm_add_ps(channels[c], hue);
+                __m128 weight;
+                __m128 value;
+
+                k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpge_ps(k, sectors), sectors));
+                weight = _mm_min_ps(_mm_max_ps(_mm_min_ps(k, _mm_sub_ps(four, k)), zero), one);
+                value = _mm_sub_ps(v, _mm_mul_ps(chroma, weight));
+                value = _mm_min_ps(_mm_max_ps(value, zero), max);
+                _mm_store_si128((__m128i *)(out[c] + h), _mm_cvtps_epi32(value));
+            }
+        }
+
+        scatterBlock(_dst + 3 * x, out[0], out[1], out[2], _bRgbOutput);
+    }
+
+    // Remaining pixels
+    editRowScalar(_kernel, _src + 3 * x, _dst + 3 * x, _width - x, _bRgbOutput);
+}
+
+/**
+*************************************************************************
+@verbatim
++ gatherBlockAVX2() - gatherBlock() into vectors: the bytes go through the
++                     LUT one by one, then are deinterleaved by shuffles
++ ----------------
++ Parameters : _kernel  kernel tables
++              _src     first source pixel of the block
++              _b/_g/_r receive the channels of the KERNEL_BLOCK pixels
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+__attribute__((target("avx2")))
+static inline void gatherBlockAVX2(const ColorEditKernel &_kernel, const unsigned char *_src,
+                                   __m256 &_b, __m256 &_g, __m256 &_r)
+{
+    alignas(16) unsigned char bytes[16 + 8];
+    __m128i low;
+    __m128i high;
+
+    for(int i = 0; i < 3 * KERNEL_BLOCK; i++)
+    {
+        bytes[i] = _kernel.lut[_src[i]];
+    }
+
+    low = _mm_load_si128((const __m128i *)bytes);
+    high = _mm_loadl_epi64((const __m128i *)(bytes + 16));
+
+    // Channel c of the pixels: bytes c, c + 3, ... of the 16 + 8 bytes
+    _b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_or_si128(
+             _mm_shuffle_epi8(low, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+             _mm_shuffle_epi8(high, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1)))));
+    _g = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_or_si128(
+             _mm_shuffle_epi8(low, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+             _mm_shuffle_epi8(high, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1)))));
+    _r = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_or_si128(
+             _mm_shuffle_epi8(low, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+             _mm_shuffle_epi8(high, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1)))));
+}
+
+/**
+*************************************************************************
+@verbatim
++ scatterBlockAVX2() - scatterBlock() from vectors: packed to bytes, then
++                      interleaved by shuffles. Writes the 3 * KERNEL_BLOCK
++                      bytes of the block only
++ ----------------
++ Parameters : _dst         first destination pixel of the block
++              _c0/_c1/_c2  channels in BGR order, in [0, 255]
++              _bRgbOutput  TRUE to write RGB order
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+__attribute__((target("avx2")))
+static inline void scatterBlockAVX2(unsigned char *_dst, __m256i _c0, __m256i _c1, __m256i _c2, bool _bRgbOutput)
+{
+    // Each 128-bit lane: 4 bytes of c0, c1, c2, c2 (pixels 0-3, then 4-7)
+    __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(_c0, _c1), _mm256_packus_epi32(_c2, _c2));
+    __m128i order = _bRgbOutput ? _mm_setr_epi8(8, 4, 0, 9, 5, 1, 10, 6, 2, 11, 7, 3, -1, -1, -1, -1)
+                                : _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1);
+    __m128i first = _mm_shuffle_epi8(_mm256_castsi256_si128(bytes), order);
+    __m128i second = _mm_shuffle_epi8(_mm256_extracti128_si256(bytes, 1), order);
+
+    _mm_storeu_si128((__m128i *)_dst, _mm_or_si128(first, _mm_slli_si128(second, 12)));
+    _mm_storel_epi64((__m128i *)(_dst + 16), _mm_srli_si128(second, 4));
+}
+
+/**
+*************************************************************************
+@verbatim
++ editRowAVX2() - AVX2/FMA implementation of the fused editing kernel for
++                 one row, as editRowScalar()
++ ----------------
++ Parameters : see editRowScalar()
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+__attribute__((target("avx2,fma")))
+static void editRowAVX2(const ColorEditKernel &_kernel, const unsigned char *_src, unsigned char *_dst, int _width, bool _bRgbOutput)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 sectors = _mm256_set1_ps(KERNEL_HUE_SECTORS);
+    const __m256 max = _mm256_set1_ps(255.0f);
+    const __m256 hueShift = _mm256_set1_ps(_kernel.hueShift);
+    const __m256 saturationScale = _mm256_set1_ps(_kernel.saturationScale);
+    const __m256 channels[3] = { one, _mm256_set1_ps(3.0f), _mm256_set1_ps(5.0f) };
+    int x = 0;
+
+    for(; x + KERNEL_BLOCK <= _width; x += KERNEL_BLOCK)
+    {
+        __m256 vb;
+        __m256 vg;
+        __m256 vr;
+        __m256i out[3];
+
+        gatherBlockAVX2(_kernel, _src + 3 * x, vb, vg, vr);
+
+        __m256 v = _mm256_max_ps(_mm256_max_ps(vb, vg), vr);
+        __m256 chroma = _mm256_sub_ps(v, _mm256_min_ps(_mm256_min_ps(vb, vg), vr));
+        // 1 / 0 is masked out (gray pixels have no hue)
+        __m256 inverse = _mm256_and_ps(_mm256_cmp_ps(chroma, zero, _CMP_GT_OQ), _mm256_div_ps(one, chroma));
+        __m256 hue;
+
+        // Blue sector, replaced by the green then the red one where they hold the maximum
+        hue = _mm256_fmadd_ps(_mm256_sub_ps(vr, vg), inverse, four);
+        hue = _mm256_blendv_ps(hue, _mm256_fmadd_ps(_mm256_sub_ps(vb, vr), inverse, _mm256_set1_ps(2.0f)),
+                               _mm256_cmp_ps(v, vg, _CMP_EQ_OQ));
+        hue = _mm256_blendv_ps(hue, _mm256_mul_ps(_mm256_sub_ps(vg, vb), inverse), _mm256_cmp_ps(v, vr, _CMP_EQ_OQ));
+        hue = _mm256_add_ps(hue, hueShift);
+        hue = _mm256_add_ps(hue, _mm256_and_ps(_mm256_cmp_ps(hue, zero, _CMP_LT_OQ), sectors));
+        hue = _mm256_sub_ps(hue, _mm256_and_ps(_mm256_cmp_ps(hue, sectors, _CMP_GE_OQ), sectors));
+        chroma = _mm256_min_ps(_mm256_mul_ps(chroma, saturationScale), v);
+
+        for(int c = 0; c < 3; c++)
+        {
+            __m256 k = _mm256_add_ps(channels[c], hue);
+            __m256 weight;
+            __m256 value;
+
+            k = _mm256_sub_ps(k, _mm256_and_ps(_mm256_cmp_ps(k, sectors, _CMP_GE_OQ), sectors));
+            weight = _mm256_min_ps(_mm256_max_ps(_mm256_min_ps(k, _mm256_sub_ps(four, k)), zero), one);
+            value = _mm256_fnmadd_ps(chroma, weight, v);
+            value = _mm256_min_ps(_mm256_max_ps(value, zero), max);
+            out[c] = _mm256_cvtps_epi32(value);
+        }
+
+        scatterBlockAVX2(_dst + 3 * x, out[0], out[1], out[2], _bRgbOutput);
+    }
+
+    // Remaining pixels
+    editRowScalar(_kernel, _src + 3 * x, _dst + 3 * x, _width - x, _bRgbOutput);
+}
+#endif
+
+/**
+*************************************************************************
+@verbatim
++ selectEditRow() - Select the best row implementation for the running CPU
++ ----------------
++ Parameters : _isa     receives the name of the selected instruction set
++ Returns    : ColorEditRowFunc the selected implementation
+@endverbatim
+***************************************************************************/
+static ColorEditRowFunc selectEditRow(const char **_isa)
+{
+#ifdef IMAGEKERNELS_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        *_isa = "avx2";
+        return editRowAVX2;
+    }
+    if(__builtin_cpu_supports("sse2"))
+    {
+        *_isa = "sse2";
+        return editRowSSE;
+    }
+#endif
+
+    *_isa = "scalar";
+    return editRowScalar;
+}
+
+static const char *g_editRowISA = "scalar";
+static ColorEditRowFunc g_editRow = selectEditRow(&g_editRowISA);
+
+/**
+*************************************************************************
+@verbatim
++ applyColorEditKernel() - Apply contrast, brightness, hue and saturation
++                          in a single pass over the pixels. Source and
++                          destination may be the same buffer
++ ----------------
++ Parameters : _kernel      kernel tables built by buildColorEditKernel()
++              _src         source BGR buffer
++              _srcStride   source row stride in bytes
++              _dst         destination buffer
++              _dstStride   destination row stride in bytes
++              _width       width in pixels
++              _height      height in pixels
++              _bRgbOutput  TRUE to write RGB (display) order
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void applyColorEditKernel(const ColorEditKernel &_kernel,
+                          const unsigned char *_src, int _srcStride,
+                          unsigned char *_dst, int _dstStride,
+                          int _width, int _height, bool _bRgbOutput)
+{
+    ColorEditRowFunc row = _kernel.bLutOnly ? lutRow : g_editRow;
+
+    for(int y = 0; y < _height; y++)
+    {
+        row(_kernel, _src + (size_t)y * _srcStride, _dst + (size_t)y * _dstStride, _width, _bRgbOutput);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ colorEditKernelISA() - Return the instruction set used by the kernel
++ ----------------
++ Parameters : NONE
++ Returns    : const char * name of the instruction set
+@endverbatim
+***************************************************************************/
+const char *colorEditKernelISA()
+{
+    return g_editRowISA;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bSelectColorEditKernelISA() - Use the implementation of an instruction
++                               set instead of the best one, to compare
++                               them. Not thread safe: call it when no
++                               editing runs
++ ----------------
++ Parameters : _isa     "scalar", "sse2" or "avx2"
++ Returns    : TRUE if selected; FALSE if unknown or not supported by the CPU
+@endverbatim
+***************************************************************************/
+bool bSelectColorEditKernelISA(const char *_isa)
+{
+    if(std::strcmp(_isa, "scalar") == 0)
+    {
+        g_editRowISA = "scalar";
+        g_editRow = editRowScalar;
+        return true;
+    }
+
+#ifdef IMAGEKERNELS_X86
+    __builtin_cpu_init();
+
+    if( (std::strcmp(_isa, "avx2") == 0) && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+    {
+        g_editRowISA = "avx2";
+        g_editRow = editRowAVX2;
+        return true;
+    }
+    if( (std::strcmp(_isa, "sse2") == 0) && __builtin_cpu_supports("sse2") )
+    {
+        g_editRowISA = "sse2";
+        g_editRow = editRowSSE;
+        return true;
+    }
+#endif
+
+    return false;
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+/*
+ * Low level pixel kernels working on raw 8-bit BGR buffers.
+ * No dependency on Qt nor OpenCV.
+ */
+
+typedef struct
+{
+    // Contrast & brightness lookup table
+    unsigned char lut[256];
+    // Hue rotation in sixths of a turn [0, 6) & saturation factor, in the
+    // HSV model of cv::cvtColor()
+    float hueShift;
+    float saturationScale;
+    // TRUE when hue & saturation are unchanged (LUT only)
+    bool bLutOnly;
+} ColorEditKernel;
+
+// Build kernel tables from editing values
+void buildColorEditKernel(ColorEditKernel &_kernel, int _brightness, int _contrast, float _hueShiftDeg, float _saturationScale);
+
+// Apply kernel to rows of a BGR image. Output is BGR, or RGB (display order) if _bRgbOutput.
+// Each pixel is read before it is written: _dst may be _src (same stride)
+void applyColorEditKernel(const ColorEditKernel &_kernel,
+                          const unsigned char *_src, int _srcStride,
+                          unsigned char *_dst, int _dstStride,
+                          int _width, int _height, bool _bRgbOutput);
+
+// Name of the instruction set used by applyColorEditKernel()
+const char *colorEditKernelISA();
+
+// Use the implementation of an instruction set ("scalar", "sse2" or "avx2")
+// instead of the best one, for tests. FALSE if not supported
+bool bSelectColorEditKernelISA(const char *_isa);
+
+#endif // IMAGEKERNELS_H
@@ -0,0 +1,1099 @@
+#include "imageprocessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
+
+#include "filterkernels.h"
+#include "stagetimer.h"
+#include "workpool.h"
+
+// Search & template windows of the NlMeans tiers. Cost grows with the
+// search window area: each tier is about an order of magnitude apart
+// (7x7, 21x21 & 63x63, 9x each)
+static const int g_nlMeansTierWindows[NlMeansTierCount][2] =
+{
+    { 5, 7 },   // Draft
+    { 7, 21 },  // Balanced (OpenCV defaults)
+    { 7, 63 }   // Best
+};
+
+// Cancellable processing runs in chunks: tile side of the cheap filters,
+// targeted duration of a NlMeans tile (bounds the cancel latency)
+#define CHUNK_TILE_SIZE 1024
+#define CHUNK_NLMEANS_TILE_MS 40.0
+// Rows of the editing bands
+#define CHUNK_EDIT_ROWS 64
+// Rows of the bands of the specialized filter kernels
+#define CHUNK_FILTER_ROWS 128
+
+// FastGaussian: below this sigma (x10) the boxes are 1 or 3 pixels wide
+// and do not approximate the Gaussian, which is then computed exactly
+#define FAST_GAUSSIAN_MIN_SIGMA 20
+
+// Bilateral grid: the grid of a whole image does not fit in memory, it is
+// always processed by tiles (working memory relative to the tile pixels)
+#define GRID_WORKING_SET_FACTOR 8.0
+
+// Fraction of the pixels clipped at each end by the auto-levels
+#define AUTO_LEVELS_CLIP 0.005
+
+// Measured NlMeans runtime per megapixel of each tier (0 if not measured yet)
+static std::mutex g_nlMeansCostMutex;
+static double g_nlMeansCost[NlMeansTierCount] = { 0, 0, 0 };
+// Nesting of the UnmeasuredScope of the current thread
+static thread_local int t_unmeasuredDepth = 0;
+
+static std::atomic<bool> g_bVerbose(false);
+
+void ImageProcessor::setVerbose(bool _bVerbose)
+{
+    g_bVerbose = _bVerbose;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bIsCallerOutput() - Check whether an output is a buffer of the caller
++                     to be written in place: a header on external
++                     memory (not allocated by OpenCV) of the input size
++                     and of the output type, not overlapping the input
++ ----------------
++ Parameters : _in          input image
++              _out         output image
++              _type        type of the output
++              _bInPlace    TRUE if the processing may write its input
++                           (same pixels, same stride)
++ Returns    : TRUE to write _out; FALSE to allocate a new output
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bIsCallerOutput(const cv::Mat &_in, const cv::Mat &_out, int _type, bool _bInPlace)
+{
+    if( _out.empty() || (_out.u != nullptr) || (_out.size() != _in.size()) || (_out.type() != _type) )
+        return false;
+
+    // Disjoint buffers, or exactly the input when allowed
+    if( (_out.dataend <= _in.datastart) || (_in.dataend <= _out.datastart) )
+        return true;
+
+    return _bInPlace && (_out.data == _in.data) && (_out.step == _in.step);
+}
+
+/**
+*************************************************************************
+@verbatim
++ buildEditKernel() - Build the fused editing kernel from the slider
++                     values. Hue and saturation values are targets for
++                     the mean levels of the image
++ ----------------
++ Parameters : _kernel          kernel to build
++              _brightness      brightness value between 1 and 200
++              _contrast        constrast value between 1 and 200
++              _hue             hue value between 0 and 179
++              _saturation      saturation value between 0 and 255
++              _meanHue         mean hue level of the image
++              _meanSaturation  mean saturation level of the image
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageProcessor::buildEditKernel(ColorEditKernel &_kernel, int _brigthness, int _contrast, int _hue, int _saturation,
+                                     int _meanHue, int _meanSaturation)
+{
+    // OpenCV 8-bit hue unit is 2 degrees
+    float hueShift = (float)(_hue - _meanHue) * 2.0f;
+    float saturationScale = 1.0f;
+
+    // A gray image has no saturation to scale
+    if(_meanSaturation > 0)
+    {
+        saturationScale = (float)_saturation / _meanSaturation;
+    }
+
+    buildColorEditKernel(_kernel, _brigthness, _contrast, hueShift, saturationScale);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bEditImage() - Apply Brightness, Constrat, Hue & Saturation to an image
++                in a single pass using the fused editing kernel. Row
++                bands are processed in parallel, the control is checked
++                between bands
++ ----------------
++ Parameters : _in         input BGR image
++              _out        output image
++              _kernel     editing kernel
++              _bRgbOutput TRUE to write RGB (display) order
++              _control    cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bEditImage(const cv::Mat &_in, cv::Mat &_out, const ColorEditKernel &_kernel, bool _bRgbOutput,
+                                TaskControl *_control)
+{
+    int bands = (_in.rows + CHUNK_EDIT_ROWS - 1) / CHUNK_EDIT_ROWS;
+    std::atomic<int> doneBands(0);
+    int64 start;
+    double seconds;
+
+    if(_in.empty() || (_in.type() != CV_8UC3))
+    {
+        std::cerr << __func__ << " Unsupported image format!" << std::endl;
+        return false;
+    }
+
+    // A caller buffer is written, even the input itself (per pixel
+    // kernel). Else always allocate a new buffer: the previous one may be
+    // shared with the input or with frames already handed to the UI
+    if(!bIsCallerOutput(_in, _out, CV_8UC3, true))
+    {
+        _out.release();
+        _out.create(_in.size(), CV_8UC3);
+    }
+
+    ScopedTimer timer("edit", 2 * _in.total() * _in.elemSize());
+    start = cv::getTickCount();
+
+    // Process row bands in parallel
+    WorkPool::instance().parallelFor(bands, [&](int _begin, int _end)
+    {
+        for(int band = _begin; band < _end; band++)
+        {
+            int row = band * CHUNK_EDIT_ROWS;
+
+            if( (_control != nullptr) && _control->bIsCancelled() )
+                return;
+
+            applyColorEditKernel(_kernel,
+                                 _in.ptr(row), (int)_in.step,
+                                 _out.ptr(row), (int)_out.step,
+                                 _in.cols, std::min(CHUNK_EDIT_ROWS, _in.rows - row), _bRgbOutput);
+
+            if(_control != nullptr)
+                _control->setProgress(++doneBands, bands);
+        }
+    });
+
+    if( (_control != nullptr) && _control->bIsCancelled() )
+    {
+        _out.release();
+        return false;
+    }
+
+    seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+    if(g_bVerbose && (seconds > 0))
+    {
+        std::cerr << "Editing kernel (" << colorEditKernelISA() << "): "
+                  << (_in.total() * _in.elemSize()) / (seconds * 1e6) << " MB/s" << std::endl;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoizeImage() - Apply Denoizing process to an image using type and parameters.
++                   With a control, the image is processed in chunks
++                   (tiles) and the control is checked between them
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image
++              _type    type of denoizing process
++              _params  checked parameters related to the requested type
++              _control cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bDenoizeImage(const cv::Mat &_in, cv::Mat &_out, ProcessType _type, const ProcessParameters &_params,
+                                   TaskControl *_control)
+{
+    // Input read & output written
+    long long bytes = 2 * _in.total() * _in.elemSize();
+    int halo = GetProcessHalo(_type, _params);
+
+    // Apply Denoizing type
+    switch(_type)
+    {
+    case TypeGaussianBlur:
+    {
+        ScopedTimer timer("GaussianBlur", bytes);
+        if(g_bVerbose)
+            std::cerr << "Apply GaussianBlur Denoizing type (filter kernels: " << filterKernelISA() << ")" << std::endl;
+        return bRunInChunks(_in, _out, halo, GetDenoizeFunction(_type, _params), _control);
+    }
+    case TypeMedianBlur:
+    {
+        ScopedTimer timer("MedianBlur", bytes);
+        if(g_bVerbose)
+            std::cerr << "Apply MedianBlur Denoizing type (filter kernels: " << filterKernelISA() << ")" << std::endl;
+        return bRunInChunks(_in, _out, halo, GetDenoizeFunction(_type, _params), _control);
+    }
+    case TypeNlMeans:
+    {
+        ScopedTimer timer("NlMeans", bytes);
+        if(g_bVerbose)
+            std::cerr << "Apply NlMeans Denoizing type" << std::endl;
+        return bDenoizeNlMeansTiled(_in, _out, _params, _control);
+    }
+    case TypeFastGaussian:
+    {
+        ScopedTimer timer("FastGaussian", bytes);
+        if(g_bVerbose)
+            std::cerr << "Apply FastGaussian Denoizing type" << std::endl;
+        return bRunInChunks(_in, _out, halo, GetDenoizeFunction(_type, _params), _control);
+    }
+    case TypeGuidedFilter:
+    {
+        ScopedTimer timer("GuidedFilter", bytes);
+        if(g_bVerbose)
+            std::cerr << "Apply GuidedFilter Denoizing type" << std::endl;
+        return bRunInChunks(_in, _out, halo, GetDenoizeFunction(_type, _params), _control);
+    }
+    case TypeBilateralGrid:
+    {
+        ScopedTimer timer("BilateralGrid", bytes);
+        TiledExecutor executor;
+
+        if(g_bVerbose)
+            std::cerr << "Apply BilateralGrid Denoizing type" << std::endl;
+        executor.setTileSize(CHUNK_TILE_SIZE);
+        executor.setHalo(halo);
+        executor.setWorkingSetFactor(GRID_WORKING_SET_FACTOR);
+        return executor.bRun(_in, _out, GetDenoizeFunction(_type, _params), _control);
+    }
+    default:
+        std::cerr << __func__ << " Unkown type!" << std::endl;
+        return false;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetDenoizeFunction() - Return the raw denoizing of an image or of a
++                        tile, without tiling, timing nor logging. The
++                        parameters are copied into the function
++ ----------------
++ Parameters : _type    type of denoizing process
++              _params  checked parameters related to the requested type
++ Returns    : TileFunction the denoizing (leaves the output empty for an
++              unknown type)
+@endverbatim
+***************************************************************************/
+TileFunction ImageProcessor::GetDenoizeFunction(ProcessType _type, const ProcessParameters &_params)
+{
+    ProcessParameters params = _params;
+
+    switch(_type)
+    {
+    case TypeGaussianBlur:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            // Specialized kernels for the small sizes of BGR images
+            if( (_in.type() == CV_8UC3) &&
+                bIsFilterKernelSize(params.kernelSizeWidth) && bIsFilterKernelSize(params.kernelSizeHeight) )
+            {
+                bRunFilterKernel(_in, _out, [&params](const cv::Mat &_src, cv::Mat &_dst, int _firstRow, int _rows)
+                {
+                    return bGaussianBlurKernel(_src.ptr(), (int)_src.step, _dst.ptr(), (int)_dst.step,
+                                               _src.cols, _src.rows, _firstRow, _rows,
+                                               params.kernelSizeWidth, params.kernelSizeHeight, params.sigma / 10.0);
+                });
+                return;
+            }
+
+            cv::GaussianBlur(_in, _out, cv::Size(params.kernelSizeWidth, params.kernelSizeHeight), params.sigma / 10.0);
+        };
+    case TypeMedianBlur:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            if( (_in.type() == CV_8UC3) && bIsFilterKernelSize(params.aperture) )
+            {
+                bRunFilterKernel(_in, _out, [&params](const cv::Mat &_src, cv::Mat &_dst, int _firstRow, int _rows)
+                {
+                    return bMedianBlurKernel(_src.ptr(), (int)_src.step, _dst.ptr(), (int)_dst.step,
+                                             _src.cols, _src.rows, _firstRow, _rows, params.aperture);
+                });
+                return;
+            }
+
+            cv::medianBlur(_in, _out, params.aperture);
+        };
+    case TypeNlMeans:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            cv::fastNlMeansDenoisingColored(_in, _out, (float)params.h, (float)params.hColor,
+                                            params.templateWindowSize, params.searchWindowSize);
+        };
+    case TypeFastGaussian:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            bDenoizeFastGaussian(_in, _out, params);
+        };
+    case TypeGuidedFilter:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            bDenoizeGuidedFilter(_in, _out, params);
+        };
+    case TypeBilateralGrid:
+        return [params](const cv::Mat &_in, cv::Mat &_out)
+        {
+            bDenoizeBilateralGrid(_in, _out, params);
+        };
+    default:
+        return [](const cv::Mat &, cv::Mat &_out) { _out.release(); };
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetProcessHalo() - Return the number of pixels a denoizing reads around
++                    a pixel, so that tiles or strips extended by this
++                    halo give the same result as the whole image
++ ----------------
++ Parameters : _type    type of denoizing process
++              _params  checked parameters related to the requested type
++ Returns    : int the halo in pixels
+@endverbatim
+***************************************************************************/
+int ImageProcessor::GetProcessHalo(ProcessType _type, const ProcessParameters &_params)
+{
+    switch(_type)
+    {
+    case TypeGaussianBlur:
+        return std::max(_params.kernelSizeWidth, _params.kernelSizeHeight) / 2;
+    case TypeMedianBlur:
+        return _params.aperture / 2;
+    case TypeNlMeans:
+        return _params.searchWindowSize / 2 + _params.templateWindowSize / 2;
+    case TypeFastGaussian:
+        // Three box passes, about 3 sigma in total
+        return (int)std::ceil(3.0 * _params.sigma / 10.0) + 4;
+    case TypeGuidedFilter:
+        // Two box passes
+        return 2 * _params.guidedRadius;
+    case TypeBilateralGrid:
+        // Splat, blur & slice reach 3.5 cells. A multiple of the cell size
+        // keeps the grids of tiles aligned with the grid of the image
+        return 4 * _params.gridCellSize;
+    default:
+        return 0;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRunInChunks() - Apply a processing by tiles extended by the halo, run
++                  in parallel by the work pool and cancellable between
++                  tiles, or in one go for a single tile. Both give the
++                  same output
++ ----------------
++ Parameters : _in          input BGR image
++              _out         output BGR image
++              _halo        support of the processing in pixels
++              _function    processing of the image or of a tile
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bRunInChunks(const cv::Mat &_in, cv::Mat &_out, int _halo, const TileFunction &_function,
+                                  TaskControl *_control)
+{
+    TiledExecutor executor;
+
+    executor.setTileSize(CHUNK_TILE_SIZE);
+    executor.setHalo(_halo);
+
+    if(executor.tileCount(_in) <= 1)
+    {
+        // Output may be shared with frames handed to the UI
+        if(!bIsCallerOutput(_in, _out, _in.type()))
+            _out.release();
+        _function(_in, _out);
+        return !_out.empty();
+    }
+
+    return executor.bRun(_in, _out, _function, _control);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRunFilterKernel() - Run a specialized filter kernel on bands of rows
++                      in parallel
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image, a new buffer unless
++                       written by the caller
++              _kernel  filters the rows (_firstRow, _rows) of _out
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bRunFilterKernel(const cv::Mat &_in, cv::Mat &_out,
+                                      const std::function<bool(const cv::Mat &, cv::Mat &, int, int)> &_kernel)
+{
+    int bands = (_in.rows + CHUNK_FILTER_ROWS - 1) / CHUNK_FILTER_ROWS;
+    std::atomic<bool> bOK(true);
+
+    // The kernels can not work in place
+    if(!bIsCallerOutput(_in, _out, _in.type()))
+    {
+        _out.release();
+        _out.create(_in.size(), _in.type());
+    }
+
+    WorkPool::instance().parallelFor(bands, [&](int _begin, int _end)
+    {
+        for(int band = _begin; band < _end; band++)
+        {
+            if(!_kernel(_in, _out, band * CHUNK_FILTER_ROWS, CHUNK_FILTER_ROWS))
+                bOK = false;
+        }
+    });
+
+    if(!bOK)
+    {
+        std::cerr << __func__ << " Unsupported filter kernel!" << std::endl;
+        _out.release();
+    }
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoizeFastGaussian() - Approximate a Gaussian blur with three
++                          successive box filters. Box sizes are chosen
++                          so that the total variance matches sigma^2.
++                          Box filters use running sums, so the cost per
++                          pixel does not depend on sigma. Intermediate
++                          passes are kept in 16-bit fixed point to avoid
++                          accumulating rounding errors. Against
++                          cv::GaussianBlur(), from sigma 2 to 100: at
++                          most 8 levels and 1 level on average (pure
++                          noise is the worst case). Below sigma 2 the
++                          blur is cv::GaussianBlur() itself (<= 13 taps)
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image
++              _params  checked parameters (sigma x10)
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bDenoizeFastGaussian(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params)
+{
+    const int passes = 3;
+    double sigma = _params.sigma / 10.0;
+    double idealWidth = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lowerWidth = (int)std::floor(idealWidth);
+    int upperWidth;
+    int lowerPasses;
+    cv::Mat tmp;
+
+    // Box widths shall be odd
+    if(!bIsOdd(lowerWidth))
+        lowerWidth--;
+    upperWidth = lowerWidth + 2;
+
+    // Number of passes using the lower width so that variances sum to sigma^2
+    lowerPasses = cvRound((12.0 * sigma * sigma - passes * lowerWidth * lowerWidth - 4.0 * passes * lowerWidth - 3.0 * passes)
+                          / (-4.0 * lowerWidth - 4.0));
+    lowerPasses = std::min(std::max(lowerPasses, 0), passes);
+
+    // Output may be shared with frames handed to the UI
+    if(!bIsCallerOutput(_in, _out, CV_8UC3))
+        _out.release();
+
+    if(_params.sigma < FAST_GAUSSIAN_MIN_SIGMA)
+    {
+        cv::GaussianBlur(_in, _out, cv::Size(0, 0), sigma);
+        return !_out.empty();
+    }
+
+    _in.convertTo(tmp, CV_16U, 256);
+
+    for(int i = 0; i < passes; i++)
+    {
+        int width = (i < lowerPasses) ? lowerWidth : upperWidth;
+
+        if(width > 1)
+        {
+            cv::blur(tmp, tmp, cv::Size(width, width));
+        }
+    }
+
+    tmp.convertTo(_out, CV_8U, 1.0 / 256);
+
+    return !_out.empty();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoizeGuidedFilter() - Edge preserving smoothing of each channel by a
++                          self-guided filter: a linear model fitted in
++                          each window keeps the edges whose variance is
++                          above epsilon^2 and averages the flat areas.
++                          Only box filters are used (running sums), so
++                          the cost per pixel does not depend on the radius
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image
++              _params  checked parameters (radius, epsilon in levels)
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bDenoizeGuidedFilter(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params)
+{
+    cv::Size window(2 * _params.guidedRadius + 1, 2 * _params.guidedRadius + 1);
+    double epsilon = (double)_params.guidedEpsilon * _params.guidedEpsilon;
+    cv::Mat guide;
+    cv::Mat mean;
+    cv::Mat variance;
+    cv::Mat a;
+    cv::Mat b;
+
+    _in.convertTo(guide, CV_32F);
+
+    // Mean & variance of each window
+    cv::boxFilter(guide, mean, CV_32F, window);
+    cv::boxFilter(guide.mul(guide), variance, CV_32F, window);
+    variance -= mean.mul(mean);
+
+    // Model q = a * I + b of each window: a tends to 1 on edges, to 0 on
+    // flat areas where the output is the mean
+    cv::divide(variance, variance + cv::Scalar::all(epsilon), a);
+    b = mean - a.mul(mean);
+
+    // Average of the models of the windows covering each pixel
+    cv::boxFilter(a, a, CV_32F, window);
+    cv::boxFilter(b, b, CV_32F, window);
+
+    // Output may be shared with frames handed to the UI
+    if(!bIsCallerOutput(_in, _out, CV_8UC3))
+        _out.release();
+    cv::Mat(a.mul(guide) + b).convertTo(_out, CV_8U);
+
+    return !_out.empty();
+}
+
+// Luminance of a BGR pixel, range coordinate of the bilateral grid
+static inline int gridLuminance(const cv::Vec3b &_pixel)
+{
+    return (29 * _pixel[0] + 150 * _pixel[1] + 77 * _pixel[2] + 128) >> 8;
+}
+
+// Blur a bilateral grid along one axis with a [1 4 6 4 1] / 16 kernel.
+// Cells outside of the grid are empty
+static void blurGridAxis(const std::vector<cv::Vec4f> &_src, std::vector<cv::Vec4f> &_dst, int _stride, int _length)
+{
+    static const float weights[5] = { 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+    int cells = (int)_src.size();
+
+    for(int i = 0; i < cells; i++)
+    {
+        int position = (i / _stride) % _length;
+        cv::Vec4f sum(0, 0, 0, 0);
+
+        for(int k = -2; k <= 2; k++)
+        {
+            if( (position + k >= 0) && (position + k < _length) )
+            {
+                sum += _src[i + k * _stride] * weights[k + 2];
+            }
+        }
+        _dst[i] = sum;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoizeBilateralGrid() - Approximate a bilateral filter on a grid
++                           downsampled in space (cell size) and range
++                           (luminance / range sigma): colours are
++                           accumulated into the grid, the grid is blurred,
++                           then interpolated at each pixel. Cost is linear
++                           in pixels plus grid cells, whatever the spatial
++                           extent of the filter. Cells are aligned on the
++                           top-left corner of the input
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image
++              _params  checked parameters (cell size, range sigma)
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bDenoizeBilateralGrid(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params)
+{
+    const int cell = _params.gridCellSize;
+    const int range = _params.gridRangeSigma;
+    int width;
+    int height;
+    int depth;
+
+    if(_in.empty() || (_in.type() != CV_8UC3))
+        return false;
+
+    // One more cell on each axis for the interpolation
+    width = (_in.cols - 1) / cell + 2;
+    height = (_in.rows - 1) / cell + 2;
+    depth = 255 / range + 2;
+
+    std::vector<cv::Vec4f> grid((size_t)width * height * depth, cv::Vec4f(0, 0, 0, 0));
+    std::vector<cv::Vec4f> blurred(grid.size());
+
+    // Splat: colour sums & count of the pixels nearest to each cell
+    for(int y = 0; y < _in.rows; y++)
+    {
+        const cv::Vec3b *row = _in.ptr<cv::Vec3b>(y);
+        int gridY = (y + cell / 2) / cell;
+
+        for(int x = 0; x < _in.cols; x++)
+        {
+            const cv::Vec3b &pixel = row[x];
+            int gridX = (x + cell / 2) / cell;
+            int gridZ = (gridLuminance(pixel) + range / 2) / range;
+            cv::Vec4f &sum = grid[((size_t)gridY * width + gridX) * depth + gridZ];
+
+            sum[0] += pixel[0];
+            sum[1] += pixel[1];
+            sum[2] += pixel[2];
+            sum[3] += 1.0f;
+        }
+    }
+
+    // Blur along range, x and y
+    blurGridAxis(grid, blurred, 1, depth);
+    blurGridAxis(blurred, grid, depth, width);
+    blurGridAxis(grid, blurred, width * depth, height);
+
+    // Slice: trilinear interpolation at the position & luminance of each
+    // pixel, colour sums normalised by the count. Output may be shared
+    // with frames handed to the UI
+    if(!bIsCallerOutput(_in, _out, CV_8UC3))
+    {
+        _out.release();
+        _out.create(_in.size(), CV_8UC3);
+    }
+
+    for(int y = 0; y < _in.rows; y++)
+    {
+        const cv::Vec3b *inRow = _in.ptr<cv::Vec3b>(y);
+        cv::Vec3b *outRow = _out.ptr<cv::Vec3b>(y);
+        int y0 = y / cell;
+        float wy = (float)(y % cell) / cell;
+
+        for(int x = 0; x < _in.cols; x++)
+        {
+            int luminance = gridLuminance(inRow[x]);
+            int x0 = x / cell;
+            int z0 = luminance / range;
+            float wx = (float)(x % cell) / cell;
+            float wz = (float)(luminance % range) / range;
+            const cv::Vec4f *c = &blurred[((size_t)y0 * width + x0) * depth + z0];
+            const int dz = 1;
+            const int dx = depth;
+            const int dy = width * depth;
+            cv::Vec4f top = (c[0] * (1 - wz) + c[dz] * wz) * (1 - wx) + (c[dx] * (1 - wz) + c[dx + dz] * wz) * wx;
+            cv::Vec4f bottom = (c[dy] * (1 - wz) + c[dy + dz] * wz) * (1 - wx) +
+                               (c[dy + dx] * (1 - wz) + c[dy + dx + dz] * wz) * wx;
+            cv::Vec4f sum = top * (1 - wy) + bottom * wy;
+
+            if(sum[3] > 0)
+            {
+                outRow[x] = cv::Vec3b(cv::saturate_cast<uchar>(sum[0] / sum[3]),
+                                      cv::saturate_cast<uchar>(sum[1] / sum[3]),
+                                      cv::saturate_cast<uchar>(sum[2] / sum[3]));
+            }
+            else
+            {
+                outRow[x] = inRow[x];
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bDenoizeNlMeansTiled() - Apply NlMeans denoizing by overlapping tiles
++                          processed in parallel within the tile memory
++                          budget. The halo covers the search and template
++                          windows so the output matches the untiled one.
++                          With a control, tiles are sized from the
++                          measured tier cost so that each one lasts about
++                          CHUNK_NLMEANS_TILE_MS (cancel latency)
++ ----------------
++ Parameters : _in      input BGR image
++              _out     output BGR image
++              _params  checked NlMeans parameters
++              _control cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bDenoizeNlMeansTiled(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params,
+                                          TaskControl *_control)
+{
+    TiledExecutor executor;
+    int tier = GetNlMeansTier(_params);
+    int64 start = cv::getTickCount();
+    double msPerMegaPixel;
+    bool bOK;
+
+    TileFunction nlMeans = GetDenoizeFunction(TypeNlMeans, _params);
+
+    auto denoize = [&nlMeans](const cv::Mat &_tileIn, cv::Mat &_tileOut)
+    {
+        ScopedTimer timer("NlMeansTile", _tileIn.total() * _tileIn.elemSize());
+        nlMeans(_tileIn, _tileOut);
+    };
+
+    // A pixel depends on its search window extended by the template window
+    executor.setHalo(GetProcessHalo(TypeNlMeans, _params));
+    // Colored NlMeans works on a Lab copy plus output and internal buffers
+    executor.setWorkingSetFactor(4.0);
+
+    if(_control != nullptr)
+    {
+        // Measured cost is the wall time of all the threads, a tile runs on one
+        double cost = (tier >= 0) ? GetNlMeansTierCost((NlMeansTier)tier) : 0;
+        int tileSize = 256;
+
+        if(cost > 0)
+        {
+            double megaPixels = CHUNK_NLMEANS_TILE_MS / (cost * WorkPool::instance().threadCount());
+            tileSize = std::min(std::max((int)std::sqrt(megaPixels * 1e6), 128), 512);
+        }
+        executor.setTileSize(tileSize);
+    }
+
+    if(executor.tileCount(_in) <= 1)
+    {
+        // Small images are processed in one go
+        if(!bIsCallerOutput(_in, _out, _in.type()))
+            _out.release();
+        denoize(_in, _out);
+        bOK = !_out.empty();
+    }
+    else
+    {
+        if(g_bVerbose)
+        {
+            std::cerr << "NlMeans on " << executor.tileCount(_in) << " tiles, "
+                      << executor.maxTilesInFlight(_in) << " in flight" << std::endl;
+        }
+        bOK = executor.bRun(_in, _out, denoize, _control);
+    }
+
+    // Record measured cost of the tier, full resolution runs only
+    msPerMegaPixel = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() / (_in.total() / 1e6);
+    if(bOK && (tier >= 0) && (t_unmeasuredDepth == 0))
+    {
+        std::lock_guard<std::mutex> locker(g_nlMeansCostMutex);
+        g_nlMeansCost[tier] = (g_nlMeansCost[tier] > 0) ? (g_nlMeansCost[tier] + msPerMegaPixel) / 2 : msPerMegaPixel;
+    }
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetNlMeansTierParameters() - Fill the NlMeans window sizes of a tier.
++                              Filter strengths (h, hColor) are kept
++ ----------------
++ Parameters : _tier    requested tier
++              _params  parameters to fill
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageProcessor::GetNlMeansTierParameters(NlMeansTier _tier, ProcessParameters &_params)
+{
+    if( (_tier < 0) || (_tier >= NlMeansTierCount) )
+        _tier = NlMeansBalanced;
+
+    _params.templateWindowSize = g_nlMeansTierWindows[_tier][0];
+    _params.searchWindowSize = g_nlMeansTierWindows[_tier][1];
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetNlMeansTier() - Return the tier matching NlMeans window sizes
++ ----------------
++ Parameters : _params  NlMeans parameters
++ Returns    : int the matching NlMeansTier; -1 for custom windows
+@endverbatim
+***************************************************************************/
+int ImageProcessor::GetNlMeansTier(const ProcessParameters &_params)
+{
+    for(int tier = 0; tier < NlMeansTierCount; tier++)
+    {
+        if( (_params.templateWindowSize == g_nlMeansTierWindows[tier][0]) &&
+            (_params.searchWindowSize == g_nlMeansTierWindows[tier][1]) )
+            return tier;
+    }
+
+    return -1;
+}
+
+/**
+*************************************************************************
+@verbatim
++ GetNlMeansTierCost() - Return the measured runtime per megapixel of a tier
++ ----------------
++ Parameters : _tier    requested tier
++ Returns    : double runtime in ms per megapixel; 0 if not measured yet
+@endverbatim
+***************************************************************************/
+double ImageProcessor::GetNlMeansTierCost(NlMeansTier _tier)
+{
+    if( (_tier < 0) || (_tier >= NlMeansTierCount) )
+        return 0;
+
+    std::lock_guard<std::mutex> locker(g_nlMeansCostMutex);
+    return g_nlMeansCost[_tier];
+}
+
+/**
+*************************************************************************
+@verbatim
++ computeMeanHueSaturation() - Compute the mean hue and saturation levels
++                              of an image with a single HSV conversion
++ ----------------
++ Parameters : _img         BGR image
++              _hue         receives the mean hue level
++              _saturation  receives the mean saturation level
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageProcessor::computeMeanHueSaturation(const cv::Mat &_img, int &_hue, int &_saturation)
+{
+    ScopedTimer timer("meanHueSaturation", _img.total() * _img.elemSize());
+    ImageStatistics statistics = ImageStatistics::compute(_img);
+
+    _hue = (int)statistics.mean(ChannelHue);
+    _saturation = (int)statistics.mean(ChannelSaturation);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bGetAutoLevels() - Compute the brightness & contrast values stretching
++                    the B, G, R levels of an image to the full range.
++                    AUTO_LEVELS_CLIP of the pixels are clipped at each
++                    end so that a few outliers do not limit the stretch
++ ----------------
++ Parameters : _statistics  statistics of the image
++              _brightness  receives the brightness value (1 to 200)
++              _contrast    receives the contrast value (1 to 200)
++ Returns    : TRUE if success; FALSE otherwise (empty or flat image)
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bGetAutoLevels(const ImageStatistics &_statistics, int &_brightness, int &_contrast)
+{
+    int low = 255;
+    int high = 0;
+
+    if(_statistics.pixelCount() == 0)
+        return false;
+
+    for(int c = ChannelBlue; c <= ChannelRed; c++)
+    {
+        low = std::min(low, _statistics.percentile((StatisticsChannel)c, AUTO_LEVELS_CLIP));
+        high = std::max(high, _statistics.percentile((StatisticsChannel)c, 1.0 - AUTO_LEVELS_CLIP));
+    }
+
+    if(high <= low)
+    {
+        std::cerr << __func__ << " Flat image, no levels to stretch!" << std::endl;
+        return false;
+    }
+
+    // Editing maps a level v to v * contrast / 100 + brightness - 100
+    _contrast = std::min(std::max(cvRound(100.0 * 255 / (high - low)), 1), 200);
+    _brightness = std::min(std::max(cvRound(100.0 - low * _contrast / 100.0), 1), 200);
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCheckDenoizeParams() - Checks input parameters related to the current denoizing type.
++                  If requested parameters are not odd, make them odd
++ ----------------
++ Parameters : type     denoizing process type
++              params   reference to parameters related to the requested type
++ Returns    : TRUE if params are OK; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bCheckDenoizeParams(ProcessType _type, ProcessParameters &params)
+{
+    bool bOK = false;
+
+    switch(_type)
+    {
+    case TypeGaussianBlur:
+        // Check value ranges according to GaussianBlur() specification
+        if( ((params.kernelSizeHeight > 0) && (params.kernelSizeHeight < 25)) &&
+            ((params.kernelSizeWidth > 0) && (params.kernelSizeWidth < 25)) &&
+            ((params.sigma > 0) && (params.sigma < 100)) )
+        {
+            // Values cannot be odd
+            if(!bIsOdd(params.kernelSizeHeight))
+            {
+                params.kernelSizeHeight += 1;
+            }
+            if(!bIsOdd(params.kernelSizeWidth))
+            {
+                params.kernelSizeWidth += 1;
+            }
+
+            bOK = true;
+        }
+        break;
+    case TypeMedianBlur:
+        // Check value ranges according to MedianBlur() specification
+        if( (params.aperture > 1) && (params.aperture < 25) )
+        {
+            // Values cannot be odd
+            if(!bIsOdd(params.aperture))
+            {
+                params.aperture +=1;
+            }
+            bOK = true;
+        }
+        break;
+    case TypeFastGaussian:
+        // Cost does not depend on sigma, only the box sizes must fit in the image
+        if( (params.sigma > 0) && (params.sigma <= 1000) )
+        {
+            bOK = true;
+        }
+        break;
+    case TypeNlMeans:
+        // Check value ranges according to fastNlMeansDenoisingColored() specification
+        if( ((params.h > 0) && (params.h <= 100)) &&
+            ((params.hColor > 0) && (params.hColor <= 100)) &&
+            ((params.templateWindowSize >= 3) && (params.templateWindowSize < 16)) &&
+            ((params.searchWindowSize >= params.templateWindowSize) && (params.searchWindowSize < 66)) )
+        {
+            // Values cannot be odd
+            if(!bIsOdd(params.templateWindowSize))
+            {
+                params.templateWindowSize += 1;
+            }
+            if(!bIsOdd(params.searchWindowSize))
+            {
+                params.searchWindowSize += 1;
+            }
+            bOK = true;
+        }
+        break;
+    case TypeGuidedFilter:
+        // Cost does not depend on the radius (box filters)
+        if( ((params.guidedRadius > 0) && (params.guidedRadius <= 64)) &&
+            ((params.guidedEpsilon > 0) && (params.guidedEpsilon <= 255)) )
+        {
+            bOK = true;
+        }
+        break;
+    case TypeBilateralGrid:
+        // Grid size is bounded by the smallest cell & range sigma
+        if( ((params.gridCellSize >= 8) && (params.gridCellSize <= 64)) &&
+            ((params.gridRangeSigma >= 8) && (params.gridRangeSigma <= 128)) )
+        {
+            // Cell size shall be a power of two, so that tiles and strips
+            // starting on multiples of 64 pixels share the image grid
+            int cellSize = 8;
+
+            while(cellSize < params.gridCellSize)
+            {
+                cellSize *= 2;
+            }
+            params.gridCellSize = cellSize;
+            bOK = true;
+        }
+        break;
+    default:
+        bOK = false;
+    }
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCheckImageEditingValues() - Checks input brightness & contrast values
++ ----------------
++ Parameters : brightness value of the brightness
++              constrast value of the constrast
++ Returns    : TRUE if params are OK; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bCheckImageEditingValues(int _brightness, int _contrast, int _hue, int _saturation)
+{
+    bool bOK = true;
+
+    if( (_brightness < 1) || (_brightness > 200) )
+        bOK = false;
+
+    if( (_contrast < 1) || (_contrast > 200) )
+        bOK = false;
+
+    if( (_hue < 0) || (_hue > 179) )
+        bOK = false;
+
+    if( (_saturation < 0) || (_saturation > 255) )
+        bOK = false;
+
+    return bOK;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCheckParams() - Checks if input integer is an odd number
++ ----------------
++ Parameters : num    input number
++ Returns    : TRUE if integer is an odd number; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageProcessor::bIsOdd(int _num)
+{
+  int i = 0;
+  bool odd = false;
+
+  while (i != _num)
+  {
+    odd = !odd;
+    i = i + 1;
+  }
+
+  return odd;
+}
+
+ImageProcessor::UnmeasuredScope::UnmeasuredScope()
+{
+    t_unmeasuredDepth++;
+}
+
+ImageProcessor::UnmeasuredScope::~UnmeasuredScope()
+{
+    t_unmeasuredDepth--;
+}
@@ -0,0 +1,75 @@
+#ifndef IMAGEPROCESSOR_H
+#define IMAGEPROCESSOR_H
+
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+#include "imagekernels.h"
+#include "imagestatistics.h"
+#include "processtypes.h"
+#include "taskcontrol.h"
+#include "tiledexecutor.h"
+
+/*
+ * Stateless editing & denoizing of 8-bit BGR images, shared by the GUI
+ * worker thread, the batch, strip, video and daemon modes. No dependency
+ * on Qt: this is the processing library, see imagecore.h for its API on
+ * caller-owned buffers.
+ *
+ * Outputs are new buffers, as they may be shared with frames handed to
+ * the UI, except for caller-owned buffers (headers on external memory)
+ * of the right size & type, which are written in place.
+ */
+class ImageProcessor
+{
+public:
+    static bool bCheckDenoizeParams(ProcessType _type, ProcessParameters &_params);
+    static bool bCheckImageEditingValues(int _brightness, int _contrast, int _hue, int _saturation);
+    static void buildEditKernel(ColorEditKernel &_kernel, int _brigthness, int _contrast, int _hue, int _saturation,
+                                int _meanHue, int _meanSaturation);
+    static bool bEditImage(const cv::Mat &_in, cv::Mat &_out, const ColorEditKernel &_kernel, bool _bRgbOutput,
+                           TaskControl *_control = nullptr);
+    static bool bDenoizeImage(const cv::Mat &_in, cv::Mat &_out, ProcessType _type, const ProcessParameters &_params,
+                              TaskControl *_control = nullptr);
+    static int GetProcessHalo(ProcessType _type, const ProcessParameters &_params);
+    static TileFunction GetDenoizeFunction(ProcessType _type, const ProcessParameters &_params);
+    static void computeMeanHueSaturation(const cv::Mat &_img, int &_hue, int &_saturation);
+    static bool bGetAutoLevels(const ImageStatistics &_statistics, int &_brightness, int &_contrast);
+
+    // NlMeans speed/quality tiers
+    static void GetNlMeansTierParameters(NlMeansTier _tier, ProcessParameters &_params);
+    static int GetNlMeansTier(const ProcessParameters &_params);
+    static double GetNlMeansTierCost(NlMeansTier _tier);
+
+    /*
+     * NlMeans runs of this thread are left out of the tier costs while in
+     * scope, e.g. previews: a small proxy on few threads does not cost
+     * what a full resolution image does
+     */
+    class UnmeasuredScope
+    {
+    public:
+        UnmeasuredScope();
+        ~UnmeasuredScope();
+    };
+
+    // TRUE if _out is a caller-owned buffer the processing shall write
+    static bool bIsCallerOutput(const cv::Mat &_in, const cv::Mat &_out, int _type, bool _bInPlace = false);
+
+    // Print the informational messages on stderr (errors always are)
+    static void setVerbose(bool _bVerbose);
+
+private:
+    static bool bRunInChunks(const cv::Mat &_in, cv::Mat &_out, int _halo, const TileFunction &_function,
+                             TaskControl *_control);
+    static bool bRunFilterKernel(const cv::Mat &_in, cv::Mat &_out, const std::function<bool(const cv::Mat &, cv::Mat &, int, int)> &_kernel);
+    static bool bDenoizeFastGaussian(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params);
+    static bool bDenoizeGuidedFilter(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params);
+    static bool bDenoizeBilateralGrid(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params);
+    static bool bDenoizeNlMeansTiled(const cv::Mat &_in, cv::Mat &_out, const ProcessParameters &_params,
+                                     TaskControl *_control);
+    static bool bIsOdd(int _num);
+};
+
+#endif // IMAGEPROCESSOR_H
@@ -0,0 +1,163 @@
+#include "imagestatistics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <opencv2/imgproc.hpp>
+
+#include "workpool.h"
+
+// Rows converted to HSV at once: the conversion stays in cache and no
+// full size HSV copy is allocated
+#define STATISTICS_BAND_ROWS 32
+
+ImageStatistics::ImageStatistics()
+{
+    clear();
+}
+
+void ImageStatistics::clear()
+{
+    m_pixels = 0;
+    std::memset(m_histograms, 0, sizeof(m_histograms));
+}
+
+/**
+*************************************************************************
+@verbatim
++ accumulate() - Add the pixels of a BGR image. Row bands are converted to
++                HSV (vectorized by OpenCV) and counted in per thread
++                histograms, merged once per thread
++ ----------------
++ Parameters : _img     8-bit BGR image
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageStatistics::accumulate(const cv::Mat &_img)
+{
+    std::mutex mutex;
+    int bands;
+
+    if(_img.empty() || (_img.type() != CV_8UC3))
+        return;
+
+    bands = (_img.rows + STATISTICS_BAND_ROWS - 1) / STATISTICS_BAND_ROWS;
+
+    WorkPool::instance().parallelFor(bands, [&](int _begin, int _end)
+    {
+        ImageStatistics local;
+        cv::Mat hsv;
+
+        for(int band = _begin; band < _end; band++)
+        {
+            int first = band * STATISTICS_BAND_ROWS;
+            cv::Mat bgr = _img.rowRange(first, std::min(first + STATISTICS_BAND_ROWS, _img.rows));
+
+            cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+
+            for(int y = 0; y < bgr.rows; y++)
+            {
+                const uchar *src = bgr.ptr(y);
+                const uchar *conv = hsv.ptr(y);
+
+                for(int x = 0; x < 3 * bgr.cols; x += 3)
+                {
+                    local.m_histograms[ChannelBlue][src[x]]++;
+                    local.m_histograms[ChannelGreen][src[x + 1]]++;
+                    local.m_histograms[ChannelRed][src[x + 2]]++;
+                    local.m_histograms[ChannelHue][conv[x]]++;
+                    local.m_histograms[ChannelSaturation][conv[x + 1]]++;
+                    local.m_histograms[ChannelValue][conv[x + 2]]++;
+                }
+            }
+
+            local.m_pixels += (int64)bgr.rows * bgr.cols;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        merge(local);
+    });
+}
+
+void ImageStatistics::merge(const ImageStatistics &_other)
+{
+    m_pixels += _other.m_pixels;
+
+    for(int c = 0; c < StatisticsChannelCount; c++)
+    {
+        for(int i = 0; i < STATISTICS_BINS; i++)
+        {
+            m_histograms[c][i] += _other.m_histograms[c][i];
+        }
+    }
+}
+
+int64 ImageStatistics::pixelCount() const
+{
+    return m_pixels;
+}
+
+const int64 *ImageStatistics::histogram(StatisticsChannel _channel) const
+{
+    return m_histograms[_channel];
+}
+
+/**
+*************************************************************************
+@verbatim
++ mean() - Return the mean level of a channel (same as cv::mean())
++ ----------------
++ Parameters : _channel    requested channel
++ Returns    : double the mean level, 0 for an empty image
+@endverbatim
+***************************************************************************/
+double ImageStatistics::mean(StatisticsChannel _channel) const
+{
+    double sum = 0;
+
+    if(m_pixels == 0)
+        return 0;
+
+    for(int i = 0; i < STATISTICS_BINS; i++)
+    {
+        sum += (double)i * m_histograms[_channel][i];
+    }
+
+    return sum / m_pixels;
+}
+
+/**
+*************************************************************************
+@verbatim
++ percentile() - Return the lowest level such that at least the given
++                fraction of the pixels is at or below it
++ ----------------
++ Parameters : _channel    requested channel
++              _fraction   fraction of the pixels, between 0 and 1
++ Returns    : int the level, 0 for an empty image
+@endverbatim
+***************************************************************************/
+int ImageStatistics::percentile(StatisticsChannel _channel, double _fraction) const
+{
+    double target = std::min(std::max(_fraction, 0.0), 1.0) * m_pixels;
+    int64 count = 0;
+
+    for(int i = 0; i < STATISTICS_BINS; i++)
+    {
+        count += m_histograms[_channel][i];
+        if( (count > 0) && (count >= target) )
+            return i;
+    }
+
+    return 0;
+}
+
+ImageStatistics ImageStatistics::compute(const cv::Mat &_img)
+{
+    ImageStatistics statistics;
+
+    statistics.accumulate(_img);
+
+    return statistics;
+}
@@ -0,0 +1,47 @@
+#ifndef IMAGESTATISTICS_H
+#define IMAGESTATISTICS_H
+
+#include <opencv2/core.hpp>
+
+typedef enum
+{
+    ChannelBlue = 0,
+    ChannelGreen = 1,
+    ChannelRed = 2,
+    // OpenCV 8-bit HSV: hue between 0 and 179
+    ChannelHue = 3,
+    ChannelSaturation = 4,
+    ChannelValue = 5,
+    StatisticsChannelCount = 6
+} StatisticsChannel;
+
+#define STATISTICS_BINS 256
+
+/*
+ * Histograms of the B, G, R channels of an image and of its HSV
+ * conversion, computed together in a single pass. Means and percentiles
+ * are derived from the histograms and never rescan the image. Images
+ * processed by parts (strips) are accumulated part by part.
+ */
+class ImageStatistics
+{
+public:
+    ImageStatistics();
+
+    void clear();
+    void accumulate(const cv::Mat &_img);
+    void merge(const ImageStatistics &_other);
+
+    int64 pixelCount() const;
+    const int64 *histogram(StatisticsChannel _channel) const;
+    double mean(StatisticsChannel _channel) const;
+    int percentile(StatisticsChannel _channel, double _fraction) const;
+
+    static ImageStatistics compute(const cv::Mat &_img);
+
+private:
+    int64 m_pixels;
+    int64 m_histograms[StatisticsChannelCount][STATISTICS_BINS];
+};
+
+#endif // IMAGESTATISTICS_H
@@ -0,0 +1,302 @@
+#include "imagestore.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <QDebug>
+
+#include <algorithm>
+
+typedef struct
+{
+    qint64 bytes;
+    int refs[StoreCategoryCount];
+} StoreEntry;
+
+// Never held while calling out (evictors, other locking functions)
+static QMutex g_storeMutex;
+static QMap<const void *, StoreEntry> g_storeEntries;
+static QMap<int, StoreEvictor> g_storeEvictors;
+static int g_storeNextEvictorId = 0;
+// 0 for no budget. 32-bit builds are limited by their address space
+static qint64 g_storeBudget = (sizeof(void *) == 4) ? 1536LL * 1024 * 1024 : 0;
+
+static const char *g_storeCategoryNames[StoreCategoryCount] = { "originals", "intermediates", "cache", "display" };
+
+/**
+*************************************************************************
+@verbatim
++ entryCategory() - Return the category a buffer is counted in: the
++                   first one holding a reference on it
++ ----------------
++ Parameters : _entry   accounted buffer
++ Returns    : int the category; StoreCategoryCount if unreferenced
+@endverbatim
+***************************************************************************/
+static int entryCategory(const StoreEntry &_entry)
+{
+    int category = 0;
+
+    while( (category < StoreCategoryCount) && (_entry.refs[category] == 0) )
+    {
+        category++;
+    }
+
+    return category;
+}
+
+// Bytes of a category, of all of them for StoreCategoryCount. Called
+// with g_storeMutex held
+static qint64 storeBytes(int _category)
+{
+    qint64 total = 0;
+
+    foreach(const StoreEntry &entry, g_storeEntries)
+    {
+        if( (_category == StoreCategoryCount) || (entryCategory(entry) == _category) )
+            total += entry.bytes;
+    }
+
+    return total;
+}
+
+void ImageStore::setBudget(qint64 _bytes)
+{
+    QMutexLocker locker(&g_storeMutex);
+    g_storeBudget = std::max((qint64)0, _bytes);
+}
+
+qint64 ImageStore::budget()
+{
+    QMutexLocker locker(&g_storeMutex);
+    return g_storeBudget;
+}
+
+qint64 ImageStore::bytes()
+{
+    QMutexLocker locker(&g_storeMutex);
+    return storeBytes(StoreCategoryCount);
+}
+
+qint64 ImageStore::bytes(StoreCategory _category)
+{
+    QMutexLocker locker(&g_storeMutex);
+    return storeBytes(_category);
+}
+
+/**
+*************************************************************************
+@verbatim
++ formatUsage() - Format memory usage for display:
++                 "originals 36.0 MB, intermediates 72.0 MB, ..."
++ ----------------
++ Parameters : NONE
++ Returns    : QString the formatted usage
+@endverbatim
+***************************************************************************/
+QString ImageStore::formatUsage()
+{
+    QStringList categories;
+
+    for(int category = 0; category < StoreCategoryCount; category++)
+    {
+        categories << QString("%1 %2 MB").arg(g_storeCategoryNames[category])
+                                         .arg(bytes((StoreCategory)category) / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+
+    return categories.join(", ");
+}
+
+/**
+*************************************************************************
+@verbatim
++ bReserve() - Check that new buffers fit in the budget. Evictors are
++              called in registration order until they do
++ ----------------
++ Parameters : _bytes   size of the buffers about to be allocated
++ Returns    : TRUE if they fit; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ImageStore::bReserve(qint64 _bytes)
+{
+    QList<StoreEvictor> evictors;
+
+    if( (budget() <= 0) || (bytes() + _bytes <= budget()) )
+        return true;
+
+    {
+        QMutexLocker locker(&g_storeMutex);
+        evictors = g_storeEvictors.values();
+    }
+
+    // Evictors release refs: called without holding the lock
+    foreach(const StoreEvictor &evictor, evictors)
+    {
+        evictor(bytes() + _bytes - budget());
+
+        if(bytes() + _bytes <= budget())
+            return true;
+    }
+
+    qDebug() << __func__ << " Memory budget exceeded:" << formatUsage();
+
+    return false;
+}
+
+int ImageStore::addEvictor(StoreEvictor _evictor)
+{
+    QMutexLocker locker(&g_storeMutex);
+
+    g_storeEvictors.insert(g_storeNextEvictorId, _evictor);
+
+    return g_storeNextEvictorId++;
+}
+
+void ImageStore::removeEvictor(int _id)
+{
+    QMutexLocker locker(&g_storeMutex);
+    g_storeEvictors.remove(_id);
+}
+
+/**
+*************************************************************************
+@verbatim
++ attach() - Account a new reference on a buffer. Buffers not allocated
++            by OpenCV (external data) are not accounted
++ ----------------
++ Parameters : _img        image referencing the buffer
++              _category    category of the reference
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ImageStore::attach(const cv::Mat &_img, StoreCategory _category)
+{
+    if(_img.u == nullptr)
+        return;
+
+    QMutexLocker locker(&g_storeMutex);
+    QMap<const void *, StoreEntry>::iterator entry = g_storeEntries.find(_img.u);
+
+    if(entry == g_storeEntries.end())
+    {
+        StoreEntry newEntry;
+
+        newEntry.bytes = (qint64)_img.u->size;
+        for(int category = 0; category < StoreCategoryCount; category++)
+        {
+            newEntry.refs[category] = 0;
+        }
+        entry = g_storeEntries.insert(_img.u, newEntry);
+    }
+
+    entry->refs[_category]++;
+}
+
+void ImageStore::detach(const cv::Mat &_img, StoreCategory _category)
+{
+    if(_img.u == nullptr)
+        return;
+
+    QMutexLocker locker(&g_storeMutex);
+    QMap<const void *, StoreEntry>::iterator entry = g_storeEntries.find(_img.u);
+
+    if(entry == g_storeEntries.end())
+        return;
+
+    entry->refs[_category]--;
+
+    if(entryCategory(*entry) == StoreCategoryCount)
+        g_storeEntries.erase(entry);
+}
+
+ImageRef::ImageRef() :
+    m_category(StoreIntermediate)
+{
+
+}
+
+/**
+*************************************************************************
+@verbatim
++ ImageRef() - Reference an image buffer (shared, not copied)
++ ----------------
++ Parameters : _img        image to reference
++              _category    category the buffer is accounted in
+@endverbatim
+***************************************************************************/
+ImageRef::ImageRef(const cv::Mat &_img, StoreCategory _category) :
+    m_img(_img),
+    m_category(_category)
+{
+    ImageStore::attach(m_img, m_category);
+}
+
+ImageRef::ImageRef(const ImageRef &_other) :
+    m_img(_other.m_img),
+    m_category(_other.m_category)
+{
+    ImageStore::attach(m_img, m_category);
+}
+
+ImageRef &ImageRef::operator=(const ImageRef &_other)
+{
+    if(this != &_other)
+    {
+        ImageStore::detach(m_img, m_category);
+        m_img = _other.m_img;
+        m_category = _other.m_category;
+        ImageStore::attach(m_img, m_category);
+    }
+
+    return *this;
+}
+
+ImageRef::~ImageRef()
+{
+    ImageStore::detach(m_img, m_category);
+}
+
+bool ImageRef::empty() const
+{
+    return m_img.empty();
+}
+
+StoreCategory ImageRef::category() const
+{
+    return m_category;
+}
+
+const cv::Mat &ImageRef::mat() const
+{
+    return m_img;
+}
+
+/**
+*************************************************************************
+@verbatim
++ mutableMat() - Return a writable image. The buffer is copied first if
++                other images share it
++ ----------------
++ Parameters : NONE
++ Returns    : cv::Mat& the writable image
+@endverbatim
+***************************************************************************/
+cv::Mat &ImageRef::mutableMat()
+{
+    if( (m_img.u != nullptr) && (CV_XADD(&m_img.u->refcount, 0) > 1) )
+    {
+        cv::Mat copy = m_img.clone();
+
+        ImageStore::detach(m_img, m_category);
+        m_img = copy;
+        ImageStore::attach(m_img, m_category);
+    }
+
+    return m_img;
+}
+
+void ImageRef::reset()
+{
+    ImageStore::detach(m_img, m_category);
+    m_img.release();
+}
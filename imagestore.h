@@ -0,0 +1,77 @@
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <QString>
+
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+typedef enum
+{
+    StoreOriginal = 0,
+    StoreIntermediate = 1,
+    StoreCache = 2,
+    StoreDisplay = 3,
+    StoreCategoryCount = 4
+} StoreCategory;
+
+// Frees (about) _bytes held by a cache when the budget is exceeded
+typedef std::function<void(qint64 _bytes)> StoreEvictor;
+
+/*
+ * Process wide accounting of the image buffers held through ImageRef.
+ * A buffer shared by several refs is counted once, in the first
+ * category using it (original, intermediate, cache then display).
+ * Work that would exceed the budget first triggers the registered
+ * evictors, then is refused.
+ */
+class ImageStore
+{
+public:
+    static void setBudget(qint64 _bytes);
+    static qint64 budget();
+
+    static qint64 bytes();
+    static qint64 bytes(StoreCategory _category);
+    static QString formatUsage();
+
+    // TRUE if _bytes more fit in the budget, evicting caches if needed
+    static bool bReserve(qint64 _bytes);
+
+    static int addEvictor(StoreEvictor _evictor);
+    static void removeEvictor(int _id);
+
+private:
+    friend class ImageRef;
+
+    static void attach(const cv::Mat &_img, StoreCategory _category);
+    static void detach(const cv::Mat &_img, StoreCategory _category);
+};
+
+/*
+ * Reference counted view on an image buffer, accounted by ImageStore.
+ * Copies share the buffer; mutableMat() copies it first if it is shared
+ * (copy-on-write).
+ */
+class ImageRef
+{
+public:
+    ImageRef();
+    ImageRef(const cv::Mat &_img, StoreCategory _category);
+    ImageRef(const ImageRef &_other);
+    ImageRef &operator=(const ImageRef &_other);
+    ~ImageRef();
+
+    bool empty() const;
+    StoreCategory category() const;
+    const cv::Mat &mat() const;
+    cv::Mat &mutableMat();
+    void reset();
+
+private:
+    cv::Mat m_img;
+    StoreCategory m_category;
+};
+
+#endif // IMAGESTORE_H
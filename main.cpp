@@ -1,11 +1,106 @@
 #include "mainwindow.h"
+#include "batchprocessor.h"
+#include "imageprocessor.h"
+#include "processingdaemon.h"
+#include "stripprocessor.h"
+#include "videoprocessor.h"
+#include "workpool.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
+    // The processing library is quiet unless asked: log its steps as usual
+    ImageProcessor::setVerbose(true);
+
+    // Headless batch, video, streaming, daemon & client modes, no display nor platform plugin required
+    for(int i = 1; i < argc; i++)
+    {
+        if(QString(argv[i]) == "--batch")
+        {
+            QCoreApplication a(argc, argv);
+            return runBatchCommandLine(a.arguments());
+        }
+        if(QString(argv[i]) == "--video")
+        {
+            QCoreApplication a(argc, argv);
+            return runVideoCommandLine(a.arguments());
+        }
+        if(QString(argv[i]) == "--stream")
+        {
+            QCoreApplication a(argc, argv);
+            return runStripCommandLine(a.arguments());
+        }
+        if(QString(argv[i]) == "--daemon")
+        {
+            QCoreApplication a(argc, argv);
+            return runDaemonCommandLine(a.arguments());
+        }
+        if(QString(argv[i]) == "--client")
+        {
+            QCoreApplication a(argc, argv);
+            return runClientCommandLine(a.arguments());
+        }
+    }
+
     QApplication a(argc, argv);
+    QString traceFile;
+    std::vector<int> poolCpus;
+    int poolThreads = 0;
+
+    // Hot path instrumentation: --profile shows stage durations in the
+    // status bar, --trace <file> also writes a Chrome trace at exit
+    for(int i = 1; i < argc; i++)
+    {
+        if(QString(argv[i]) == "--profile")
+        {
+            Profiler::setEnabled(true);
+        }
+        else if( (QString(argv[i]) == "--trace") && (i + 1 < argc) )
+        {
+            Profiler::setEnabled(true);
+            traceFile = QString(argv[++i]);
+        }
+        else if( (QString(argv[i]) == "--memory-budget") && (i + 1 < argc) )
+        {
+            // Images held by the application, in MB (0 for no budget)
+            ImageStore::setBudget(QString(argv[++i]).toLongLong() * 1024 * 1024);
+        }
+        else if( (QString(argv[i]) == "--pool-threads") && (i + 1 < argc) )
+        {
+            // Threads shared by every processing (0 for one per CPU)
+            poolThreads = QString(argv[++i]).toInt();
+        }
+        else if( (QString(argv[i]) == "--pool-affinity") && (i + 1 < argc) )
+        {
+            // CPUs the pool threads are pinned to, e.g. 0-3,8
+            if(!WorkPool::bAffinitySupported())
+            {
+                qDebug() << "--pool-affinity is not supported on this platform!";
+                i++;
+            }
+            else if(!WorkPool::bParseCpuList(argv[++i], poolCpus))
+            {
+                qDebug() << "Bad CPU list:" << argv[i];
+            }
+        }
+    }
+
+    if( ((poolThreads > 0) || !poolCpus.empty()) && !WorkPool::instance().configure(poolThreads, poolCpus) )
+    {
+        qDebug() << "Could not pin the pool threads, they run unpinned";
+    }
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    int ret = a.exec();
+
+    if(!traceFile.isEmpty())
+    {
+        Profiler::bWriteTrace(traceFile);
+    }
+
+    return ret;
 }
@@ -10,6 +10,18 @@
 #include "QFileDialog"
 #include "QtGui"
 #include "QMessageBox"
+#include "QShortcut"
+#include "QPainter"
+
+// Bytes of the pixels of an image (byteCount() is deprecated since Qt 5.10)
+static qint64 imageBytes(const QImage &_image)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return (qint64)_image.sizeInBytes();
+#else
+    return (qint64)_image.byteCount();
+#endif
+}
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -18,32 +30,81 @@ MainWindow::MainWindow(QWidget *parent) :
     // Setup UI
     ui->setupUi(this);
     setAcceptDrops(true);
-    on_comboBoxDenoiseType_currentIndexChanged(0);
+    // Disabled first: previews are only requested once an image is loaded
     ui->pushButtonRun->setEnabled(false);
+    on_comboBoxDenoiseType_currentIndexChanged(0);
+    ui->pushButtonChain->setEnabled(false);
+    ui->pushButtonCompare->setEnabled(false);
     ui->pushButtonSave->setEnabled(false);
+    ui->pushButtonAutoLevels->setEnabled(false);
+    m_bWaitingFirstPaint = false;
+    m_firstPaintMs = 0;
     ui->horizontalSlider_Brightness->setEnabled(false);
     ui->horizontalSlider_Constrast->setEnabled(false);
     ui->horizontalSlider_Hue->setEnabled(false);
     ui->horizontalSlider_Saturation->setEnabled(false);
     disableParamsUI();
 
+    // Connect image rendered to UI (queued, signals are emitted by the worker thread)
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(updatedDenoizeImg(ImageFrame)), this, SLOT(updateDenoizeImage(ImageFrame)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(updatedDenoizePreviewImg(ImageFrame)), this, SLOT(updateDenoizePreviewImage(ImageFrame)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(updatedEditedImg(ImageFrame)), this, SLOT(updateEditedImage(ImageFrame)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(imageLoaded(int,int)), this, SLOT(imageLoaded(int,int)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(jobFailed(int)), this, SLOT(jobFailed(int)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(nlMeansTierCost(int,double)), this, SLOT(nlMeansTierCost(int,double)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(cacheStatistics(int,int,double)), this, SLOT(cacheStatistics(int,int,double)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(stageTimings(int,StageTimings)), this, SLOT(stageTimings(int,StageTimings)));
+
+    // Stage durations of the last job, only recorded when profiling
+    m_labelStageTimings = new QLabel(this);
+    m_labelStageTimings->setVisible(Profiler::bIsEnabled());
+    ui->statusBar->addPermanentWidget(m_labelStageTimings);
+
+    // Memory held by the images, details in the tooltip
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(memoryUsage(qint64,qint64)), this, SLOT(memoryUsage(qint64,qint64)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(memoryBudgetExceeded(int,double)), this, SLOT(memoryBudgetExceeded(int,double)));
+    m_labelMemory = new QLabel(this);
+    ui->statusBar->addPermanentWidget(m_labelMemory);
+
+    // Progress of the running job, Escape cancels it
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(progress(int)), this, SLOT(progress(int)));
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(jobCancelled(int)), this, SLOT(jobCancelled(int)));
+    (void)QObject::connect(new QShortcut(QKeySequence(Qt::Key_Escape), this), SIGNAL(activated()), &m_imageDenoizer, SLOT(cancel()));
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setMaximumWidth(150);
+    m_progressBar->setVisible(false);
+    ui->statusBar->addPermanentWidget(m_progressBar);
+
+    // Histogram of the edited preview, computed by the worker
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(statisticsUpdated(ImageStatistics)), this, SLOT(statisticsUpdated(ImageStatistics)));
+    m_labelHistogram = new QLabel(this);
+    ui->statusBar->addPermanentWidget(m_labelHistogram);
+
+    // Side by side results of the denoizer comparison
+    QStringList typeNames;
+    for(int i = 0; i < ui->comboBoxDenoiseType->count(); i++)
+        typeNames.append(ui->comboBoxDenoiseType->itemText(i));
+    m_compareDialog = new CompareDialog(typeNames, this);
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(comparisonReady(Comparison)), this, SLOT(comparisonReady(Comparison)));
+    (void)QObject::connect(m_compareDialog, SIGNAL(typeSelected(int)), this, SLOT(compareTypeSelected(int)));
+
+    // Files are encoded off the UI thread, settings kept between saves
+    m_encoderOptionsDialog = new EncoderOptionsDialog(this);
+    (void)QObject::connect(&m_imageDenoizer, SIGNAL(imageSaved(EncodeResult)), this, SLOT(imageSaved(EncodeResult)));
+
     // Setup specific thread for image processing
+    m_imageDenoizer.setPreviewSize(ui->labelImgPrevious->width(), ui->labelImgPrevious->height());
     m_imageDenoizer.start();
-    m_imageDenoizer.moveToThread(&m_imageDenoizer);
-
-    // Connect image rendered to UI
-    (void)QObject::connect(&m_imageDenoizer, SIGNAL(updatedDenoizeImg(QImage)), this, SLOT(updateDenoizeImage(QImage)));
-    (void)QObject::connect(&m_imageDenoizer, SIGNAL(updatedEditedImg(QImage)), this, SLOT(updateEditedImage(QImage)));
 }
 
 
 MainWindow::~MainWindow()
 {
-    delete ui;
-
-    //Exit Image Processing thread
+    //Exit Image Processing thread (waits for the current job to finish)
     m_imageDenoizer.stop();
-    while (m_imageDenoizer.isRunning());
+
+    delete ui;
 }
 
 /**
@@ -52,24 +113,36 @@ MainWindow::~MainWindow()
 + updateDenoizeImage() - Slot called when a new denoized image is received.
 +                 Store the image in local and display it to the UI
 + ----------------
-+ Parameters : image    Processed image to store and display
++ Parameters : frame    Processed frame to store and display
 + Returns    : NONE
 @endverbatim
 ***************************************************************************/
-void MainWindow::updateDenoizeImage(const QImage image)
+void MainWindow::updateDenoizeImage(const ImageFrame &frame)
 {
-    // Get label dimensions
-    int w = ui->labelImgDenoized->width();
-    int h = ui->labelImgDenoized->height();
-
-    // Store image in local
-    m_denoizedImg = image.copy();
+    // Store frame in local (shares the worker buffer, no copy)
+    m_denoizedImg = frame;
 
-    // Enable Save button
+    // Enable Save & Chain buttons
     ui->pushButtonSave->setEnabled(true);
+    ui->pushButtonChain->setEnabled(true);
 
-    // Set a scaled pixmap to a w x h window keeping its aspect ratio
-    ui->labelImgDenoized->setPixmap(QPixmap::fromImage(image.scaled(w, h, Qt::KeepAspectRatio)));
+    displayFrame(ui->labelImgDenoized, frame);
+}
+
+/**
+*************************************************************************
+@verbatim
++ updateDenoizePreviewImage() - Slot called when a new denoized preview is
++                 received. Display it to the UI only, the full resolution
++                 image is computed when Run is clicked
++ ----------------
++ Parameters : frame    Processed preview to display
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::updateDenoizePreviewImage(const ImageFrame &frame)
+{
+    displayFrame(ui->labelImgDenoized, frame);
 }
 
 /**
@@ -78,21 +151,369 @@ void MainWindow::updateDenoizeImage(const QImage image)
 + updateEditedImage() - Slot called when a new edited image is received.
 +                 Store the image in local and display it to the UI
 + ----------------
-+ Parameters : image    Processed image to store and display
++ Parameters : frame    Processed frame to store and display
 + Returns    : NONE
 @endverbatim
 ***************************************************************************/
-void MainWindow::updateEditedImage(const QImage image)
+void MainWindow::updateEditedImage(const ImageFrame &frame)
 {
-    // Get label dimensions
-    int w = ui->labelImgPrevious->width();
-    int h = ui->labelImgPrevious->height();
+    // Store frame in local (shares the worker buffer, no copy)
+    m_curImg = frame;
 
-    // Store image in local
-    m_curImg = image.copy();
+    displayFrame(ui->labelImgPrevious, frame);
 
-    // Set a scaled pixmap to a w x h window keeping its aspect ratio
-    ui->labelImgPrevious->setPixmap(QPixmap::fromImage(image.scaled(w, h, Qt::KeepAspectRatio)));
+    // Time from drop to first paint (reduced decode or proxy)
+    if(m_bWaitingFirstPaint)
+    {
+        m_bWaitingFirstPaint = false;
+        m_firstPaintMs = m_loadTimer.nsecsElapsed() / 1e6;
+        qDebug() << "First paint" << m_firstPaintMs << "ms after drop";
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ displayFrame() - Display a frame scaled to a label, keeping its aspect
++                  ratio. Display stages are recorded when profiling
++ ----------------
++ Parameters : label    label displaying the frame
++              frame    frame to display
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::displayFrame(QLabel *label, const ImageFrame &frame)
+{
+    int mark = Profiler::mark();
+    QImage image = frame.toQImage();
+
+    {
+        ScopedTimer timer("scaled", imageBytes(image));
+        image = image.scaled(label->width(), label->height(), Qt::KeepAspectRatio);
+    }
+    {
+        ScopedTimer timer("setPixmap", imageBytes(image));
+        label->setPixmap(QPixmap::fromImage(image));
+    }
+
+    // Reported with the stages of the job, see stageTimings()
+    if(Profiler::bIsEnabled())
+    {
+        m_displayTimings += Profiler::stageTimingsSince(mark);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ imageLoaded() - Slot called when the worker has loaded the dropped image.
++                 Enable editing sliders and initialize them with the
++                 image values
++ ----------------
++ Parameters : hue          mean hue level of the loaded image
++              saturation   mean saturation level of the loaded image
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::imageLoaded(int hue, int saturation)
+{
+    double loadMs = m_loadTimer.nsecsElapsed() / 1e6;
+
+    ui->statusBar->showMessage(QString("First paint in %1 ms, full resolution in %2 ms")
+                               .arg(m_firstPaintMs, 0, 'f', 0).arg(loadMs, 0, 'f', 0));
+
+    // Enable Editing sliders
+    ui->horizontalSlider_Brightness->setEnabled(true);
+    ui->horizontalSlider_Constrast->setEnabled(true);
+    ui->horizontalSlider_Hue->setEnabled(true);
+    ui->horizontalSlider_Saturation->setEnabled(true);
+    ui->pushButtonAutoLevels->setEnabled(true);
+
+    // Update UI to current image hue and saturation values
+    ui->label_valueHue->setText(QString::number(hue));
+    ui->label_valueSaturation->setText(QString::number(saturation));
+    ui->horizontalSlider_Hue->setValue(hue);
+    ui->horizontalSlider_Saturation->setValue(saturation);
+
+    ui->horizontalSlider_Brightness->setValue(100);
+    ui->horizontalSlider_Constrast->setValue(100);
+
+    // Preview current denoizing type on the new image
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ jobFailed() - Slot called when a job could not be processed by the
++               worker. Warn the user
++ ----------------
++ Parameters : type     type of the failed job
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::jobFailed(int type)
+{
+    m_progressBar->setVisible(false);
+
+    switch((JobType)type)
+    {
+    case JobLoadImage:
+        QMessageBox::warning(this,"Error",
+                             "Error while loading image!\n"
+                             "File path shall be in ASCII standard (no é, è, ê, µ, ¨, ...) \n"
+                             "File format shall be .jpg, .png, .tiff");
+        break;
+    case JobImageEditing:
+        QMessageBox::warning(this,"Error",
+                             "Error while editing image!\n"
+                             "Check parameters\n");
+        break;
+    case JobDenoize:
+        QMessageBox::warning(this,"Error",
+                             "Error while Denoizing!\n"
+                             "Check parameters \n");
+        break;
+    // Requested on each parameter change or resize: no message box
+    case JobDenoizePreview:
+        ui->statusBar->showMessage("Error while Denoizing the preview! Check parameters", 3000);
+        break;
+    case JobPreviewSize:
+        ui->statusBar->showMessage("Error while resizing the preview!", 3000);
+        break;
+    case JobChain:
+        QMessageBox::warning(this,"Error",
+                             "Error while chaining!\n"
+                             "Denoize the image first \n");
+        break;
+    case JobCompare:
+        QMessageBox::warning(this,"Error",
+                             "Error while comparing denoizers!\n"
+                             "Check parameters \n");
+        break;
+    default:
+        qDebug() << "Unkown job type!";
+        break;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ nlMeansTierCost() - Slot called when the runtime of a NlMeans tier has
++                     been measured. Display it next to the tier name
++ ----------------
++ Parameters : tier             measured tier
++              msPerMegaPixel   measured runtime per megapixel
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::nlMeansTierCost(int tier, double msPerMegaPixel)
+{
+    static const char *tierNames[NlMeansTierCount] = { "Draft", "Balanced", "Best" };
+
+    if( (tier < 0) || (tier >= NlMeansTierCount) )
+        return;
+
+    ui->comboBoxNlMeansTier->setItemText(tier, QString("%1 (%2 ms/MP)").arg(tierNames[tier]).arg(msPerMegaPixel, 0, 'f', 0));
+}
+
+/**
+*************************************************************************
+@verbatim
++ cacheStatistics() - Slot called after each full resolution denoizing.
++                     Display result cache statistics in the status bar
++ ----------------
++ Parameters : hits         number of cache hits
++              misses       number of cache misses
++              megaBytes    memory held by the cache
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::cacheStatistics(int hits, int misses, double megaBytes)
+{
+    ui->statusBar->showMessage(QString("Result cache: %1 hits, %2 misses, %3 MB")
+                               .arg(hits).arg(misses).arg(megaBytes, 0, 'f', 1));
+}
+
+/**
+*************************************************************************
+@verbatim
++ memoryUsage() - Slot called after each job. Display the memory held by
++                 the images in the status bar
++ ----------------
++ Parameters : bytes        bytes held by all the images
++              budgetBytes  memory budget, 0 if none
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::memoryUsage(qint64 bytes, qint64 budgetBytes)
+{
+    QString text = QString("Memory: %1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 0);
+
+    if(budgetBytes > 0)
+        text += QString(" / %1 MB").arg(budgetBytes / (1024.0 * 1024.0), 0, 'f', 0);
+
+    m_labelMemory->setText(text);
+    m_labelMemory->setToolTip(ImageStore::formatUsage());
+}
+
+/**
+*************************************************************************
+@verbatim
++ memoryBudgetExceeded() - Slot called when a job has been refused by the
++                          memory budget. Warn the user
++ ----------------
++ Parameters : type             type of the refused job
++              requiredMegaBytes   memory the job needed
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::memoryBudgetExceeded(int type, double requiredMegaBytes)
+{
+    Q_UNUSED(type);
+
+    m_progressBar->setVisible(false);
+
+    QMessageBox::warning(this,"Error",
+                         QString("Not enough memory!\n"
+                                 "%1 MB needed, %2 \n"
+                                 "Use --memory-budget to raise the limit, or --stream for very large images")
+                         .arg(requiredMegaBytes, 0, 'f', 0).arg(ImageStore::formatUsage()));
+}
+
+/**
+*************************************************************************
+@verbatim
++ progress() - Slot called while a job is processed. Display its progress
++              in the status bar until it is completed
++ ----------------
++ Parameters : percent  progress of the job, between 0 and 100
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::progress(int percent)
+{
+    m_progressBar->setValue(percent);
+    m_progressBar->setVisible(percent < 100);
+}
+
+/**
+*************************************************************************
+@verbatim
++ jobCancelled() - Slot called when a job has been cancelled, either by a
++                  newer request or by the user (Escape)
++ ----------------
++ Parameters : type     type of the cancelled job
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::jobCancelled(int type)
+{
+    m_progressBar->setVisible(false);
+
+    // Preview jobs are superseded silently
+    if( (JobType)type == JobDenoize )
+    {
+        ui->statusBar->showMessage("Denoizing cancelled", 3000);
+    }
+    else if( (JobType)type == JobLoadImage )
+    {
+        ui->statusBar->showMessage("Loading cancelled", 3000);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ statisticsUpdated() - Slot called with the statistics of the edited
++                       preview. Draw the B, G, R histograms in the status
++                       bar, mean levels in the tooltip
++ ----------------
++ Parameters : statistics   statistics of the edited preview
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::statisticsUpdated(const ImageStatistics &statistics)
+{
+    static const QColor colors[3] = { Qt::blue, Qt::green, Qt::red };
+    const int width = STATISTICS_BINS / 2;
+    const int height = 20;
+    QImage histogram(width, height, QImage::Format_RGB32);
+    QPainter painter;
+
+    histogram.fill(Qt::black);
+    painter.begin(&histogram);
+    // Overlapping channels add up to white
+    painter.setCompositionMode(QPainter::CompositionMode_Plus);
+
+    for(int c = ChannelBlue; c <= ChannelRed; c++)
+    {
+        const int64 *bins = statistics.histogram((StatisticsChannel)c);
+        double peak = 0;
+
+        // Square root scale, so that a peak does not flatten the rest
+        for(int i = 0; i < width; i++)
+            peak = std::max(peak, std::sqrt((double)(bins[2 * i] + bins[2 * i + 1])));
+
+        if(peak <= 0)
+            continue;
+
+        painter.setPen(colors[c]);
+        for(int i = 0; i < width; i++)
+        {
+            int bar = (int)(std::sqrt((double)(bins[2 * i] + bins[2 * i + 1])) / peak * height);
+            if(bar > 0)
+                painter.drawLine(i, height - 1, i, height - bar);
+        }
+    }
+    painter.end();
+
+    m_labelHistogram->setPixmap(QPixmap::fromImage(histogram));
+    m_labelHistogram->setToolTip(QString("Mean B %1, G %2, R %3 - H %4, S %5, V %6")
+                                 .arg(statistics.mean(ChannelBlue), 0, 'f', 0)
+                                 .arg(statistics.mean(ChannelGreen), 0, 'f', 0)
+                                 .arg(statistics.mean(ChannelRed), 0, 'f', 0)
+                                 .arg(statistics.mean(ChannelHue), 0, 'f', 0)
+                                 .arg(statistics.mean(ChannelSaturation), 0, 'f', 0)
+                                 .arg(statistics.mean(ChannelValue), 0, 'f', 0));
+}
+
+/**
+*************************************************************************
+@verbatim
++ stageTimings() - Slot called after each job when profiling. Display the
++                  stage durations of the job and of its display in the
++                  status bar
++ ----------------
++ Parameters : type     type of the job
++              timings  stage durations of the job
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::stageTimings(int type, const StageTimings &timings)
+{
+    Q_UNUSED(type);
+
+    m_labelStageTimings->setText(Profiler::formatStageTimings(timings + m_displayTimings));
+    m_displayTimings.clear();
+}
+
+/**
+*************************************************************************
+@verbatim
++ resizeEvent() - Overload resizeEvent function to keep the preview proxy
++                 size matched to the preview labels
++ ----------------
++ Parameters : e        Qt class that contains information about current event
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::resizeEvent(QResizeEvent *e)
+{
+    QMainWindow::resizeEvent(e);
+
+    m_imageDenoizer.setPreviewSize(ui->labelImgPrevious->width(), ui->labelImgPrevious->height());
 }
 
 /**
@@ -135,44 +556,23 @@ void MainWindow::dropEvent(QDropEvent *e)
         {
             m_curFileName = fileName;
 
-            // Get label dimensions
-            int w = ui->labelImgPrevious->width();
-            int h = ui->labelImgPrevious->height();
-
-            // Set a scaled pixmap to a w x h window keeping its aspect ratio
-            ui->labelImgPrevious->setPixmap(QPixmap(m_curFileName).scaled(w, h, Qt::KeepAspectRatio));
+            // Decoding is done by the worker, first paint comes with the
+            // first edited image
+            ui->labelImgPrevious->clear();
+            ui->labelImgDenoized->clear();
+            m_loadTimer.start();
+            m_bWaitingFirstPaint = true;
 
             // Enable Denoize sliders
             on_comboBoxDenoiseType_currentIndexChanged(ui->comboBoxDenoiseType->currentIndex());
 
-            // Set local image
-            if(!m_imageDenoizer.bLoadImage(m_curFileName))
-            {
-                QMessageBox::warning(this,"Error",
-                                     "Error while loading image!\n"
-                                     "File path shall be in ASCII standard (no é, è, ê, µ, ¨, ...) \n"
-                                     "File format shall be .jpg, .png, .tiff");
-            }
-            else
-            {
-                // Enable Editing sliders
-                ui->horizontalSlider_Brightness->setEnabled(true);
-                ui->horizontalSlider_Constrast->setEnabled(true);
-                ui->horizontalSlider_Hue->setEnabled(false);
-                ui->horizontalSlider_Saturation->setEnabled(false);
-
-                // Update UI to current image hue and saturation values
-                ui->label_valueHue->setText(QString::number(m_imageDenoizer.GetImageHue()));
-                ui->label_valueSaturation->setText(QString::number(m_imageDenoizer.GetImageSaturation()));
-                ui->horizontalSlider_Hue->setValue(m_imageDenoizer.GetImageHue());
-                ui->horizontalSlider_Saturation->setValue(m_imageDenoizer.GetImageSaturation());
-
-                ui->horizontalSlider_Brightness->setValue(100);
-                ui->horizontalSlider_Constrast->setValue(100);
-            }
-
-            // Enable denoize button
+            // Set local image (editing sliders are enabled once loaded, see imageLoaded())
+            m_imageDenoizer.requestLoadImage(m_curFileName);
+
+            // Enable denoize button (chaining requires a denoized image)
             ui->pushButtonRun->setEnabled(true);
+            ui->pushButtonChain->setEnabled(false);
+            ui->pushButtonCompare->setEnabled(true);
 
             // Display details about image
             displayImgDetails();
@@ -195,30 +595,52 @@ void MainWindow::dropEvent(QDropEvent *e)
 ***************************************************************************/
 void MainWindow::displayImgDetails()
 {
+    QSize size;
+    QString format;
+
+    // Header only probe, the image is not decoded
+    ImageDenoizeAPI::bProbeImage(m_curFileName, size, format);
+
     // Update UI
     ui->label_Size->setText(QString::number(QFile(m_curFileName).size() / 1000) + " Ko");
-    ui->label_Width->setText(QString::number(QPixmap(m_curFileName).width()) + " px");
-    ui->label_Height->setText(QString::number(QPixmap(m_curFileName).height()) + " px");
-    ui->label_Format->setText(QFileInfo(m_curFileName).suffix());
+    ui->label_Width->setText(QString::number(size.width()) + " px");
+    ui->label_Height->setText(QString::number(size.height()) + " px");
+    ui->label_Format->setText(format.isEmpty() ? QFileInfo(m_curFileName).suffix() : format);
     ui->label_Name->setText(QFileInfo(m_curFileName).baseName());
 }
 
 /**
 *************************************************************************
 @verbatim
-+ on_pushButtonRun_clicked() - Slot triggered Denoize button has been clicked.
-+                              Get current parameters values related to current
-+                              denoizing type and proceed to denoize process.
++ bGetDenoizeParams() - Get current parameters values related to current
++                       denoizing type.
 + ----------------
-+ Parameters : NONE
-+ Returns    : NONE
++ Parameters : type     reference to the current denoizing type
++              params   reference to parameters related to the current type
++ Returns    : TRUE if the denoizing type is known; FALSE otherwise
 @endverbatim
 ***************************************************************************/
-void MainWindow::on_pushButtonRun_clicked()
+bool MainWindow::bGetDenoizeParams(ProcessType &type, ProcessParameters &params)
 {
-    ProcessType type = (ProcessType)ui->comboBoxDenoiseType->currentIndex();
-    ProcessParameters params;
+    type = (ProcessType)ui->comboBoxDenoiseType->currentIndex();
+
+    return bGetDenoizeParamsOf(type, params);
+}
 
+/**
+*************************************************************************
+@verbatim
++ bGetDenoizeParamsOf() - Get current parameters values related to a
++                         denoizing type (sliders keep their values when
++                         another type is selected)
++ ----------------
++ Parameters : type     denoizing type
++              params   reference to parameters related to the type
++ Returns    : TRUE if the denoizing type is known; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool MainWindow::bGetDenoizeParamsOf(ProcessType type, ProcessParameters &params)
+{
     // Check Denoizing type selected and get values
     if( type == TypeGaussianBlur)
     {
@@ -232,25 +654,170 @@ void MainWindow::on_pushButtonRun_clicked()
         params.aperture = ui->label_valueAperture->text().toInt();
         qDebug() << params.aperture;
     }
+    else if(type == TypeFastGaussian)
+    {
+        params.sigma = ui->label_valueSigma->text().toInt();
+        qDebug() << params.sigma;
+    }
     else if(type == TypeNlMeans)
     {
-        //no parameter
+        ImageProcessor::GetNlMeansTierParameters((NlMeansTier)ui->comboBoxNlMeansTier->currentIndex(), params);
+        params.h = ui->label_valueH->text().toInt();
+        params.hColor = params.h;
+        qDebug() << params.h << " " << params.templateWindowSize << " " << params.searchWindowSize;
+    }
+    else if(type == TypeGuidedFilter)
+    {
+        params.guidedRadius = ui->label_valueGuidedRadius->text().toInt();
+        params.guidedEpsilon = ui->label_valueGuidedEpsilon->text().toInt();
+        qDebug() << params.guidedRadius << " " << params.guidedEpsilon;
+    }
+    else if(type == TypeBilateralGrid)
+    {
+        params.gridCellSize = ui->label_valueGridCell->text().toInt();
+        params.gridRangeSigma = ui->label_valueGridRange->text().toInt();
+        qDebug() << params.gridCellSize << " " << params.gridRangeSigma;
     }
     else
     {
         qDebug() << "Unkown Denoizing type!";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ requestDenoizePreview() - Request a denoizing of the preview proxy with
++                           the current parameters, if an image is loaded
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::requestDenoizePreview()
+{
+    ProcessType type;
+    ProcessParameters params;
+
+    if(!ui->pushButtonRun->isEnabled())
         return;
+
+    if(bGetDenoizeParams(type, params))
+    {
+        m_imageDenoizer.requestDenoize(type, params, true);
     }
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_pushButtonRun_clicked() - Slot triggered Denoize button has been clicked.
++                              Get current parameters values related to current
++                              denoizing type and proceed to full resolution
++                              denoize process.
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_pushButtonRun_clicked()
+{
+    ProcessType type;
+    ProcessParameters params;
+
+    if(!bGetDenoizeParams(type, params))
+        return;
+
+    // Proceed to Denoizing (errors are reported through jobFailed())
+    m_imageDenoizer.requestDenoize(type, params);
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_pushButtonChain_clicked() - Slot triggered Chain button has been clicked.
++                                The denoized image becomes the input of
++                                the next denoizing, displayed as edited
++                                image.
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_pushButtonChain_clicked()
+{
+    // Committed once: a new denoizing is required before chaining again
+    ui->pushButtonChain->setEnabled(false);
 
-    // Proceed to Denoizing
-    if(!m_imageDenoizer.bApplyDenoize(type, params))
+    m_imageDenoizer.requestChain();
+
+    // Preview current denoizing type on the chained image
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_pushButtonCompare_clicked() - Slot triggered Compare button has been
++                                  clicked. Every denoizing type is run
++                                  with the current values of its sliders
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_pushButtonCompare_clicked()
+{
+    QVector<DenoizeCandidate> candidates;
+
+    for(int i = 0; i < ui->comboBoxDenoiseType->count(); i++)
     {
-        QMessageBox::warning(this,"Error",
-                             "Error while Denoizing!\n"
-                             "Check parameters \n");
+        DenoizeCandidate candidate;
+
+        candidate.type = (ProcessType)i;
+        if(bGetDenoizeParamsOf(candidate.type, candidate.params))
+            candidates.append(candidate);
     }
+
+    // Results are reported through comparisonReady() or jobFailed()
+    m_imageDenoizer.requestCompare(candidates);
 }
 
+/**
+*************************************************************************
+@verbatim
++ comparisonReady() - Slot called when a comparison has been processed.
++                     Display its results side by side
++ ----------------
++ Parameters : comparison   results of the comparison
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::comparisonReady(const Comparison &comparison)
+{
+    m_compareDialog->setComparison(comparison);
+    m_compareDialog->show();
+    m_compareDialog->raise();
+}
+
+/**
+*************************************************************************
+@verbatim
++ compareTypeSelected() - Slot called when the recommended method of a
++                         comparison is selected. Make it the current
++                         denoizing type
++ ----------------
++ Parameters : type     selected denoizing type
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::compareTypeSelected(int type)
+{
+    ui->comboBoxDenoiseType->setCurrentIndex(type);
+}
 
 /**
 *************************************************************************
@@ -265,16 +832,91 @@ void MainWindow::on_pushButtonRun_clicked()
 ***************************************************************************/
 void MainWindow::on_pushButtonSave_clicked()
 {
-    QString filename = QFileDialog::getSaveFileName(this, "Save file", QDir::currentPath(), "Images (*.png *.tiff *.jpg)");
+    QString filters = "JPEG (*.jpg *.jpeg);;PNG (*.png);;TIFF (*.tif *.tiff)";
+    QString suffix = QFileInfo(m_curFileName).suffix().toLower();
+    QString selectedFilter;
+    QString filename;
 
-    if(m_imageDenoizer.bSaveImage(filename + "." + QFileInfo(m_curFileName).suffix(), m_denoizedImg))
+    // Format of the source file proposed first
+    if(suffix == "png")
+        selectedFilter = "PNG (*.png)";
+    else if( (suffix == "tif") || (suffix == "tiff") )
+        selectedFilter = "TIFF (*.tif *.tiff)";
+    else
+        selectedFilter = "JPEG (*.jpg *.jpeg)";
+
+    filename = QFileDialog::getSaveFileName(this, "Save file", QDir::currentPath(), filters, &selectedFilter);
+    if(filename.isEmpty())
+        return;
+
+    // The suffix typed selects the format, otherwise the one of the chosen filter
+    if(!ImageEncoder::bIsSupportedSuffix(QFileInfo(filename).suffix()))
     {
-        qDebug() << "Denoized file saved!";
+        filename += "." + selectedFilter.section("*.", 1, 1).section(' ', 0, 0).remove(')');
     }
-    else
+
+    m_encoderOptionsDialog->setFormat(QFileInfo(filename).suffix());
+    if(m_encoderOptionsDialog->exec() != QDialog::Accepted)
+        return;
+
+    m_imageDenoizer.requestSave(m_denoizedImg, filename, m_encoderOptionsDialog->options());
+    ui->statusBar->showMessage(QString("Saving %1...").arg(QFileInfo(filename).fileName()));
+}
+
+/**
+*************************************************************************
+@verbatim
++ imageSaved() - Slot called when a save has been processed. Display the
++                encoding time and the size of the file
++ ----------------
++ Parameters : result   durations & sizes of the save
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::imageSaved(const EncodeResult &result)
+{
+    if(!result.bOK)
     {
+        ui->statusBar->clearMessage();
         QMessageBox::warning(this,"Error","Error while saving denoized file!");
+        return;
+    }
+
+    qDebug() << "Denoized file saved!";
+    ui->statusBar->showMessage(QString("Saved %1: %2 KB (%3:1) encoded in %4 ms, written in %5 ms")
+                               .arg(QFileInfo(result.file).fileName())
+                               .arg(result.bytes / 1024)
+                               .arg((double)result.rawBytes / std::max(result.bytes, (qint64)1), 0, 'f', 1)
+                               .arg(result.encodeMs, 0, 'f', 0)
+                               .arg(result.writeMs, 0, 'f', 0), 10000);
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_pushButtonAutoLevels_clicked() - Slot triggered Auto levels button has
++                                     been clicked. Set brightness & contrast
++                                     from the histograms of the image
++                                     computed at load (no rescan)
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_pushButtonAutoLevels_clicked()
+{
+    int brightness;
+    int contrast;
+
+    if(!ImageProcessor::bGetAutoLevels(m_imageDenoizer.GetImageStatistics(), brightness, contrast))
+    {
+        ui->statusBar->showMessage("Auto levels: no levels to stretch", 3000);
+        return;
     }
+
+    // Each slider requests an editing, the latest one wins
+    ui->horizontalSlider_Brightness->setValue(brightness);
+    ui->horizontalSlider_Constrast->setValue(contrast);
 }
 
 /**
@@ -302,6 +944,7 @@ void MainWindow::on_comboBoxDenoiseType_currentIndexChanged(int index)
         // Sigma
         ui->label_sigma_2->setEnabled(true);
         ui->label_valueSigma->setEnabled(true);
+        ui->horizontalSlider_Sigma->setMaximum(100);
         ui->horizontalSlider_Sigma->setEnabled(true);
 
         // Kernel W/H
@@ -319,14 +962,52 @@ void MainWindow::on_comboBoxDenoiseType_currentIndexChanged(int index)
         ui->label_valueAperture->setEnabled(true);
         ui->horizontalSlider_Aperture->setEnabled(true);
     }
+    else if(type == TypeFastGaussian)
+    {
+        // Sigma only, kernel size is derived from it and not capped
+        ui->label_sigma_2->setEnabled(true);
+        ui->label_valueSigma->setEnabled(true);
+        ui->horizontalSlider_Sigma->setMaximum(1000);
+        ui->horizontalSlider_Sigma->setEnabled(true);
+    }
     else if(type == TypeNlMeans)
     {
-        //no parameters
+        // Tier
+        ui->label_nlMeansTier->setEnabled(true);
+        ui->comboBoxNlMeansTier->setEnabled(true);
+
+        // Filter strength
+        ui->label_h->setEnabled(true);
+        ui->label_valueH->setEnabled(true);
+        ui->horizontalSlider_H->setEnabled(true);
+    }
+    else if(type == TypeGuidedFilter)
+    {
+        // Window radius & edge threshold
+        ui->label_guidedRadius->setEnabled(true);
+        ui->label_valueGuidedRadius->setEnabled(true);
+        ui->horizontalSlider_GuidedRadius->setEnabled(true);
+        ui->label_guidedEpsilon->setEnabled(true);
+        ui->label_valueGuidedEpsilon->setEnabled(true);
+        ui->horizontalSlider_GuidedEpsilon->setEnabled(true);
+    }
+    else if(type == TypeBilateralGrid)
+    {
+        // Cell size & range sigma
+        ui->label_gridCell->setEnabled(true);
+        ui->label_valueGridCell->setEnabled(true);
+        ui->horizontalSlider_GridCell->setEnabled(true);
+        ui->label_gridRange->setEnabled(true);
+        ui->label_valueGridRange->setEnabled(true);
+        ui->horizontalSlider_GridRange->setEnabled(true);
     }
     else
     {
         //do nothing
     }
+
+    // Preview the newly selected denoizing type
+    requestDenoizePreview();
 }
 
 /**
@@ -345,16 +1026,34 @@ void MainWindow::disableParamsUI()
     ui->label_sigma_2->setEnabled(false);
     ui->label_kernelHeight->setEnabled(false);
     ui->label_kernelWidth->setEnabled(false);
+    ui->label_nlMeansTier->setEnabled(false);
+    ui->label_h->setEnabled(false);
+    ui->label_guidedRadius->setEnabled(false);
+    ui->label_guidedEpsilon->setEnabled(false);
+    ui->label_gridCell->setEnabled(false);
+    ui->label_gridRange->setEnabled(false);
     // Value
     ui->label_valueAperture->setEnabled(false);
     ui->label_valueSigma->setEnabled(false);
     ui->label_valueKW->setEnabled(false);
     ui->label_valueKH->setEnabled(false);
+    ui->label_valueH->setEnabled(false);
+    ui->label_valueGuidedRadius->setEnabled(false);
+    ui->label_valueGuidedEpsilon->setEnabled(false);
+    ui->label_valueGridCell->setEnabled(false);
+    ui->label_valueGridRange->setEnabled(false);
+    // Combo box
+    ui->comboBoxNlMeansTier->setEnabled(false);
     // Slider
     ui->horizontalSlider_Aperture->setEnabled(false);
     ui->horizontalSlider_KernelHeight->setEnabled(false);
     ui->horizontalSlider_KernelWidth->setEnabled(false);
     ui->horizontalSlider_Sigma->setEnabled(false);
+    ui->horizontalSlider_H->setEnabled(false);
+    ui->horizontalSlider_GuidedRadius->setEnabled(false);
+    ui->horizontalSlider_GuidedEpsilon->setEnabled(false);
+    ui->horizontalSlider_GridCell->setEnabled(false);
+    ui->horizontalSlider_GridRange->setEnabled(false);
 }
 
 /**
@@ -373,6 +1072,8 @@ void MainWindow::disableParamsUI()
 void MainWindow::on_horizontalSlider_Sigma_valueChanged(int value)
 {
     ui->label_valueSigma->setText(QString::number(value));
+
+    requestDenoizePreview();
 }
 
 /**
@@ -391,6 +1092,8 @@ void MainWindow::on_horizontalSlider_Sigma_valueChanged(int value)
 void MainWindow::on_horizontalSlider_KernelWidth_valueChanged(int value)
 {
     ui->label_valueKW->setText(QString::number(value));
+
+    requestDenoizePreview();
 }
 
 /**
@@ -409,6 +1112,8 @@ void MainWindow::on_horizontalSlider_KernelWidth_valueChanged(int value)
 void MainWindow::on_horizontalSlider_KernelHeight_valueChanged(int value)
 {
     ui->label_valueKH->setText(QString::number(value));
+
+    requestDenoizePreview();
 }
 
 /**
@@ -427,73 +1132,174 @@ void MainWindow::on_horizontalSlider_KernelHeight_valueChanged(int value)
 void MainWindow::on_horizontalSlider_Aperture_valueChanged(int value)
 {
     ui->label_valueAperture->setText(QString::number(value));
+
+    requestDenoizePreview();
 }
 
 
-void MainWindow::on_horizontalSlider_Brightness_valueChanged(int value)
+/**
+*************************************************************************
+@verbatim
++ requestImageEditing() - Request an image editing with the current
++                         brightness, contrast, hue and saturation values.
++                         Pending requests are coalesced by the worker and
++                         only the preview proxy is processed
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::requestImageEditing()
 {
-    ui->label_valueBright->setText(QString::number(value));
-
-    // Get current params
+    int brightness = ui->label_valueBright->text().toInt();
     int contrast = ui->label_valueConstrast->text().toInt();
     int hue = ui->label_valueHue->text().toInt();
     int saturation = ui->label_valueSaturation->text().toInt();
 
-    if(!m_imageDenoizer.bApplyImageEditing(value, contrast, hue, saturation))
-    {
-        QMessageBox::warning(this,"Error",
-                             "Error while updating brightness!\n"
-                             "Check parameters\n");
-    }
+    m_imageDenoizer.requestImageEditing(brightness, contrast, hue, saturation);
+
+    // Denoized preview depends on the edited image
+    requestDenoizePreview();
+}
+
+void MainWindow::on_horizontalSlider_Brightness_valueChanged(int value)
+{
+    ui->label_valueBright->setText(QString::number(value));
+
+    requestImageEditing();
 }
 
 void MainWindow::on_horizontalSlider_Constrast_valueChanged(int value)
 {
     ui->label_valueConstrast->setText(QString::number(value));
 
-    // Get current params
-    int brightness = ui->label_valueBright->text().toInt();
-    int hue = ui->label_valueHue->text().toInt();
-    int saturation = ui->label_valueSaturation->text().toInt();
-
-    if(!m_imageDenoizer.bApplyImageEditing(brightness, value, hue, saturation))
-    {
-        QMessageBox::warning(this,"Error",
-                             "Error while updating contrast!\n"
-                             "Check parameters\n");
-    }
+    requestImageEditing();
 }
 
 void MainWindow::on_horizontalSlider_Hue_valueChanged(int value)
 {
     ui->label_valueHue->setText(QString::number(value));
 
-    // Get current params
-    int brightness = ui->label_valueBright->text().toInt();
-    int saturation = ui->label_valueSaturation->text().toInt();
-    int contrast = ui->label_valueConstrast->text().toInt();
-
-    if(!m_imageDenoizer.bApplyImageEditing(brightness, contrast, value, saturation))
-    {
-        QMessageBox::warning(this,"Error",
-                             "Error while updating hue!\n"
-                             "Check parameters\n");
-    }
+    requestImageEditing();
 }
 
 void MainWindow::on_horizontalSlider_Saturation_valueChanged(int value)
 {
     ui->label_valueSaturation->setText(QString::number(value));
 
-    // Get current params
-    int brightness = ui->label_valueBright->text().toInt();
-    int hue = ui->label_valueHue->text().toInt();
-    int contrast = ui->label_valueConstrast->text().toInt();
+    requestImageEditing();
+}
 
-    if(!m_imageDenoizer.bApplyImageEditing(brightness, contrast, hue, value))
-    {
-        QMessageBox::warning(this,"Error",
-                             "Error while updating saturation!\n"
-                             "Check parameters\n");
-    }
+/**
+*************************************************************************
+@verbatim
++ on_comboBoxNlMeansTier_currentIndexChanged() - Slot triggered when the
++                                               NlMeans tier has changed.
++                                               Preview the new tier.
++ ----------------
++ Parameters : index    updated index from combobox
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_comboBoxNlMeansTier_currentIndexChanged(int index)
+{
+    (void)index;
+
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_horizontalSlider_H_valueChanged() - Slot triggered when value
++                                               from slider has changed.
++                                               Update related label with
++                                               new value.
++ ----------------
++ Parameters : value    updated value
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_horizontalSlider_H_valueChanged(int value)
+{
+    ui->label_valueH->setText(QString::number(value));
+
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_horizontalSlider_GuidedRadius_valueChanged() - Slot triggered when value
++                                                   from slider has changed.
++                                                   Update related label with
++                                                   new value.
++ ----------------
++ Parameters : value    updated value
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_horizontalSlider_GuidedRadius_valueChanged(int value)
+{
+    ui->label_valueGuidedRadius->setText(QString::number(value));
+
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_horizontalSlider_GuidedEpsilon_valueChanged() - Slot triggered when value
++                                                    from slider has changed.
++                                                    Update related label with
++                                                    new value.
++ ----------------
++ Parameters : value    updated value
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_horizontalSlider_GuidedEpsilon_valueChanged(int value)
+{
+    ui->label_valueGuidedEpsilon->setText(QString::number(value));
+
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_horizontalSlider_GridCell_valueChanged() - Slot triggered when value
++                                               from slider has changed.
++                                               Update related label with
++                                               the cell size (8 to 64
++                                               pixels, powers of two).
++ ----------------
++ Parameters : value    updated value
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_horizontalSlider_GridCell_valueChanged(int value)
+{
+    ui->label_valueGridCell->setText(QString::number(8 << value));
+
+    requestDenoizePreview();
+}
+
+/**
+*************************************************************************
+@verbatim
++ on_horizontalSlider_GridRange_valueChanged() - Slot triggered when value
++                                                from slider has changed.
++                                                Update related label with
++                                                new value.
++ ----------------
++ Parameters : value    updated value
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void MainWindow::on_horizontalSlider_GridRange_valueChanged(int value)
+{
+    ui->label_valueGridRange->setText(QString::number(value));
+
+    requestDenoizePreview();
 }
@@ -1,9 +1,14 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QElapsedTimer>
+#include <QLabel>
 #include <QMainWindow>
+#include <QProgressBar>
 
 #include <imagedenoizerapi.h>
+#include "comparedialog.h"
+#include "encoderoptionsdialog.h"
 
 namespace Ui {
 class MainWindow;
@@ -18,17 +23,40 @@ public:
     ~MainWindow();
 
 public slots:
-    void updateDenoizeImage(const QImage image);
-    void updateEditedImage(const QImage image);
+    void updateDenoizeImage(const ImageFrame &frame);
+    void updateDenoizePreviewImage(const ImageFrame &frame);
+    void updateEditedImage(const ImageFrame &frame);
+    void imageLoaded(int hue, int saturation);
+    void jobFailed(int type);
+    void nlMeansTierCost(int tier, double msPerMegaPixel);
+    void cacheStatistics(int hits, int misses, double megaBytes);
+    void stageTimings(int type, const StageTimings &timings);
+    void memoryUsage(qint64 bytes, qint64 budgetBytes);
+    void memoryBudgetExceeded(int type, double requiredMegaBytes);
+    void progress(int percent);
+    void jobCancelled(int type);
+    void statisticsUpdated(const ImageStatistics &statistics);
+    void comparisonReady(const Comparison &comparison);
+    void imageSaved(const EncodeResult &result);
 
 private slots:
     void on_pushButtonRun_clicked();
+    void on_pushButtonChain_clicked();
+    void on_pushButtonCompare_clicked();
+    void compareTypeSelected(int type);
     void on_pushButtonSave_clicked();
+    void on_pushButtonAutoLevels_clicked();
     void on_comboBoxDenoiseType_currentIndexChanged(int index);
     void on_horizontalSlider_Sigma_valueChanged(int value);
     void on_horizontalSlider_KernelWidth_valueChanged(int value);
     void on_horizontalSlider_KernelHeight_valueChanged(int value);
     void on_horizontalSlider_Aperture_valueChanged(int value);
+    void on_comboBoxNlMeansTier_currentIndexChanged(int index);
+    void on_horizontalSlider_H_valueChanged(int value);
+    void on_horizontalSlider_GuidedRadius_valueChanged(int value);
+    void on_horizontalSlider_GuidedEpsilon_valueChanged(int value);
+    void on_horizontalSlider_GridCell_valueChanged(int value);
+    void on_horizontalSlider_GridRange_valueChanged(int value);
 
     void on_horizontalSlider_Brightness_valueChanged(int value);
 
@@ -44,14 +72,32 @@ private:
     // Overload event functions
     void dragEnterEvent(QDragEnterEvent *e);
     void dropEvent(QDropEvent *e);
+    void resizeEvent(QResizeEvent *e);
 
     void displayImgDetails();
+    void displayFrame(QLabel *label, const ImageFrame &frame);
     void disableParamsUI();
+    void requestImageEditing();
+    void requestDenoizePreview();
+    bool bGetDenoizeParams(ProcessType &type, ProcessParameters &params);
+    bool bGetDenoizeParamsOf(ProcessType type, ProcessParameters &params);
 
     QString             m_curFileName;
     ImageDenoizeAPI     m_imageDenoizer;
-    QImage              m_curImg;
-    QImage              m_denoizedImg;
+    ImageFrame          m_curImg;
+    ImageFrame          m_denoizedImg;
+    QLabel              *m_labelStageTimings;
+    QLabel              *m_labelMemory;
+    QProgressBar        *m_progressBar;
+    QLabel              *m_labelHistogram;
+    CompareDialog       *m_compareDialog;
+    EncoderOptionsDialog *m_encoderOptionsDialog;
+
+    // Drop to first paint & full resolution timings
+    QElapsedTimer       m_loadTimer;
+    bool                m_bWaitingFirstPaint;
+    double              m_firstPaintMs;
+    StageTimings        m_displayTimings;
 };
 
 #endif // MAINWINDOW_H
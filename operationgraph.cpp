@@ -0,0 +1,415 @@
+#include "operationgraph.h"
+#include "imageprocessor.h"
+
+#include <QDebug>
+
+OperationGraph::OperationGraph() :
+    m_version(0),
+    m_meanHue(0),
+    m_meanSaturation(0),
+    m_bSealed(false)
+{
+
+}
+
+/**
+*************************************************************************
+@verbatim
++ setSource() - Set the source image of the graph. Operations are kept,
++               every cached output is invalidated
++ ----------------
++ Parameters : _img             source BGR image (shared, read-only)
++              _version         version of the source, part of signatures
++              _meanHue         mean hue level of the source
++              _meanSaturation  mean saturation level of the source
++              _category        memory category of the source
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::setSource(const cv::Mat &_img, quint64 _version, int _meanHue, int _meanSaturation,
+                               StoreCategory _category)
+{
+    m_source = ImageRef(_img, _category);
+    m_version = _version;
+    m_meanHue = _meanHue;
+    m_meanSaturation = _meanSaturation;
+
+    invalidateFrom(0);
+}
+
+const cv::Mat &OperationGraph::source() const
+{
+    return m_source.mat();
+}
+
+/**
+*************************************************************************
+@verbatim
++ clear() - Remove every operation of the graph
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::clear()
+{
+    m_nodes.clear();
+    m_bSealed = false;
+}
+
+int OperationGraph::count() const
+{
+    return m_nodes.size();
+}
+
+const Operation &OperationGraph::operation(int _index) const
+{
+    return m_nodes[_index].operation;
+}
+
+/**
+*************************************************************************
+@verbatim
++ append() - Add an operation at the end of the stack
++ ----------------
++ Parameters : _operation   operation to add
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::append(const Operation &_operation)
+{
+    Node node;
+
+    node.operation = _operation;
+    node.bValid = false;
+
+    m_nodes.append(node);
+}
+
+/**
+*************************************************************************
+@verbatim
++ setOperation() - Replace an operation. Its output and every downstream
++                  output are invalidated only if the operation changed
++ ----------------
++ Parameters : _index       index of the operation
++              _operation   new operation
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::setOperation(int _index, const Operation &_operation)
+{
+    if( (_index < 0) || (_index >= m_nodes.size()) )
+        return;
+
+    if(operationKey(m_nodes[_index].operation) == operationKey(_operation))
+        return;
+
+    m_nodes[_index].operation = _operation;
+    invalidateFrom(_index);
+}
+
+/**
+*************************************************************************
+@verbatim
++ setStage() - Set the operation of the active stage: replace the last
++              denoize node, or append a new one if there is none or if
++              the stack has been sealed
++ ----------------
++ Parameters : _operation   operation of the active stage
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::setStage(const Operation &_operation)
+{
+    if(bHasStage())
+    {
+        setOperation(m_nodes.size() - 1, _operation);
+    }
+    else
+    {
+        append(_operation);
+        m_bSealed = false;
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ seal() - Commit the active stage: its output becomes the input of the
++          next stage
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::seal()
+{
+    m_bSealed = true;
+}
+
+bool OperationGraph::bHasStage() const
+{
+    return !m_bSealed && !m_nodes.isEmpty() && (m_nodes.last().operation.type == OperationDenoize);
+}
+
+/**
+*************************************************************************
+@verbatim
++ stageInput() - Return the index of the node feeding the active stage
++ ----------------
++ Parameters : NONE
++ Returns    : int node index; -1 for the source image
+@endverbatim
+***************************************************************************/
+int OperationGraph::stageInput() const
+{
+    return bHasStage() ? m_nodes.size() - 2 : m_nodes.size() - 1;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bEvaluate() - Return the output of a node, computing it lazily from the
++               last valid upstream node. Each computed node is a step
++               of the control; a cancelled evaluation keeps the nodes
++               already computed
++ ----------------
++ Parameters : _index   index of the node; -1 for the source image
++              _out     receives the output (shared, read-only)
++              _control cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool OperationGraph::bEvaluate(int _index, cv::Mat &_out, TaskControl *_control)
+{
+    int first = _index;
+    cv::Mat input;
+
+    if( m_source.empty() || (_index >= m_nodes.size()) )
+        return false;
+
+    // Find the first node to compute
+    while( (first >= 0) && !m_nodes[first].bValid )
+    {
+        first--;
+    }
+
+    if(first >= 0)
+    {
+        qDebug() << "Reusing" << first + 1 << "cached nodes";
+    }
+
+    input = (first >= 0) ? m_nodes[first].output.mat() : m_source.mat();
+
+    for(int i = first + 1; i <= _index; i++)
+    {
+        cv::Mat output;
+
+        if(_control != nullptr)
+        {
+            if(_control->bIsCancelled())
+                return false;
+
+            _control->setStep(i - first - 1, _index - first);
+        }
+
+        if(!bApply(m_nodes[i].operation, input, output, _control))
+            return false;
+
+        m_nodes[i].output = ImageRef(output, StoreIntermediate);
+        m_nodes[i].bValid = true;
+        input = output;
+    }
+
+    _out = input;
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ setResult() - Set the output of a node computed elsewhere (e.g. found
++               in a cache). Downstream outputs are invalidated
++ ----------------
++ Parameters : _index   index of the node
++              _img     output of the node (shared, read-only)
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::setResult(int _index, const cv::Mat &_img)
+{
+    if( (_index < 0) || (_index >= m_nodes.size()) )
+        return;
+
+    invalidateFrom(_index + 1);
+    m_nodes[_index].output = ImageRef(_img, StoreIntermediate);
+    m_nodes[_index].bValid = true;
+}
+
+bool OperationGraph::bIsCached(int _index) const
+{
+    return (_index >= 0) && (_index < m_nodes.size()) && m_nodes[_index].bValid;
+}
+
+/**
+*************************************************************************
+@verbatim
++ pendingNodes() - Return the number of nodes bEvaluate() would compute
++ ----------------
++ Parameters : _index   index of the node; -1 for the source image
++ Returns    : int number of nodes to compute
+@endverbatim
+***************************************************************************/
+int OperationGraph::pendingNodes(int _index) const
+{
+    int first = std::min(_index, m_nodes.size() - 1);
+
+    while( (first >= 0) && !m_nodes[first].bValid )
+    {
+        first--;
+    }
+
+    return std::max(0, _index - first);
+}
+
+/**
+*************************************************************************
+@verbatim
++ releaseIntermediates() - Release cached outputs that can be recomputed.
++                          The input and output of the active stage are
++                          kept, so that tuning it stays fast
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::releaseIntermediates()
+{
+    int input = stageInput();
+
+    for(int i = 0; i < m_nodes.size() - 1; i++)
+    {
+        if(i != input)
+        {
+            m_nodes[i].output.reset();
+            m_nodes[i].bValid = false;
+        }
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ signature() - Return a key identifying the output of a node: source
++               version and every operation up to the node
++ ----------------
++ Parameters : _index   index of the node
++ Returns    : QString the signature
+@endverbatim
+***************************************************************************/
+QString OperationGraph::signature(int _index) const
+{
+    QString key = QString::number(m_version);
+
+    for(int i = 0; (i <= _index) && (i < m_nodes.size()); i++)
+    {
+        key += "|" + operationKey(m_nodes[i].operation);
+    }
+
+    return key;
+}
+
+/**
+*************************************************************************
+@verbatim
++ operationKey() - Return a key identifying an operation. Only the
++                  parameters used by the operation are part of it
++ ----------------
++ Parameters : _operation   operation
++ Returns    : QString the key
+@endverbatim
+***************************************************************************/
+QString OperationGraph::operationKey(const Operation &_operation)
+{
+    const ProcessParameters &params = _operation.params;
+
+    if(_operation.type == OperationEdit)
+    {
+        return QString("E%1,%2,%3,%4").arg(_operation.brightness).arg(_operation.contrast)
+                                      .arg(_operation.hue).arg(_operation.saturation);
+    }
+
+    switch(_operation.processType)
+    {
+    case TypeGaussianBlur:
+        return QString("G%1,%2,%3").arg(params.sigma).arg(params.kernelSizeWidth).arg(params.kernelSizeHeight);
+    case TypeMedianBlur:
+        return QString("M%1").arg(params.aperture);
+    case TypeNlMeans:
+        return QString("N%1,%2,%3,%4").arg(params.h).arg(params.hColor)
+                                      .arg(params.templateWindowSize).arg(params.searchWindowSize);
+    case TypeFastGaussian:
+        return QString("F%1").arg(params.sigma);
+    case TypeGuidedFilter:
+        return QString("U%1,%2").arg(params.guidedRadius).arg(params.guidedEpsilon);
+    case TypeBilateralGrid:
+        return QString("B%1,%2").arg(params.gridCellSize).arg(params.gridRangeSigma);
+    default:
+        return QString("D%1").arg((int)_operation.processType);
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bApply() - Apply one operation
++ ----------------
++ Parameters : _operation   operation to apply
++              _in          input image
++              _out         output image
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool OperationGraph::bApply(const Operation &_operation, const cv::Mat &_in, cv::Mat &_out, TaskControl *_control) const
+{
+    if(_operation.type == OperationEdit)
+    {
+        ColorEditKernel kernel;
+
+        // Unedited image, share the input
+        if( (_operation.brightness == 100) && (_operation.contrast == 100) &&
+            (_operation.hue == m_meanHue) && (_operation.saturation == m_meanSaturation) )
+        {
+            _out = _in;
+            return true;
+        }
+
+        ImageProcessor::buildEditKernel(kernel, _operation.brightness, _operation.contrast,
+                                        _operation.hue, _operation.saturation, m_meanHue, m_meanSaturation);
+        return ImageProcessor::bEditImage(_in, _out, kernel, false, _control);
+    }
+
+    return ImageProcessor::bDenoizeImage(_in, _out, _operation.processType, _operation.params, _control);
+}
+
+/**
+*************************************************************************
+@verbatim
++ invalidateFrom() - Invalidate the outputs of a node and every
++                    downstream node
++ ----------------
++ Parameters : _index   first node to invalidate
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void OperationGraph::invalidateFrom(int _index)
+{
+    for(int i = std::max(_index, 0); i < m_nodes.size(); i++)
+    {
+        m_nodes[i].output.reset();
+        m_nodes[i].bValid = false;
+    }
+}
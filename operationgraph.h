@@ -0,0 +1,90 @@
+#ifndef OPERATIONGRAPH_H
+#define OPERATIONGRAPH_H
+
+#include <QString>
+#include <QVector>
+
+#include <opencv2/core.hpp>
+
+#include "imagestore.h"
+#include "processtypes.h"
+#include "taskcontrol.h"
+
+typedef enum
+{
+    OperationEdit = 0,
+    OperationDenoize = 1
+} OperationType;
+
+typedef struct
+{
+    OperationType type;
+    // For OperationEdit
+    int brightness;
+    int contrast;
+    int hue;
+    int saturation;
+    // For OperationDenoize
+    ProcessType processType;
+    ProcessParameters params;
+} Operation;
+
+/*
+ * Non-destructive ordered stack of operations applied to a source image
+ * (edit -> denoize -> denoize ...). Each node caches its output, which
+ * stays valid until its own operation or an upstream one changes.
+ * Evaluation is lazy and restarts from the last valid node.
+ */
+class OperationGraph
+{
+public:
+    OperationGraph();
+
+    // Source
+    void setSource(const cv::Mat &_img, quint64 _version, int _meanHue, int _meanSaturation,
+                   StoreCategory _category = StoreOriginal);
+    const cv::Mat &source() const;
+    void clear();
+
+    // Nodes
+    int count() const;
+    const Operation &operation(int _index) const;
+    void append(const Operation &_operation);
+    void setOperation(int _index, const Operation &_operation);
+
+    // Active stage: last denoize node, replaced until the stack is sealed
+    void setStage(const Operation &_operation);
+    void seal();
+    bool bHasStage() const;
+    int stageInput() const;
+
+    // Evaluation
+    bool bEvaluate(int _index, cv::Mat &_out, TaskControl *_control = nullptr);
+    void setResult(int _index, const cv::Mat &_img);
+    bool bIsCached(int _index) const;
+    int pendingNodes(int _index) const;
+    void releaseIntermediates();
+    QString signature(int _index) const;
+
+    static QString operationKey(const Operation &_operation);
+
+private:
+    typedef struct
+    {
+        Operation operation;
+        ImageRef output;
+        bool bValid;
+    } Node;
+
+    bool bApply(const Operation &_operation, const cv::Mat &_in, cv::Mat &_out, TaskControl *_control) const;
+    void invalidateFrom(int _index);
+
+    ImageRef m_source;
+    quint64 m_version;
+    int m_meanHue;
+    int m_meanSaturation;
+    bool m_bSealed;
+    QVector<Node> m_nodes;
+};
+
+#endif // OPERATIONGRAPH_H
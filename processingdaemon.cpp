@@ -0,0 +1,843 @@
+#include "processingdaemon.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+#include "batchprocessor.h"
+#include "profiler.h"
+#include "workpool.h"
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Socket used when none is given
+#define DAEMON_SOCKET_NAME "imageenhancer.sock"
+// Latencies kept for the percentiles
+#define DAEMON_LATENCY_SAMPLES 1024
+// Longest request line accepted (bytes)
+#define DAEMON_MAX_LINE 4096
+// Largest image side (pixels) & row stride (bytes) of a request
+#define DAEMON_MAX_SIDE 65536
+#define DAEMON_MAX_STRIDE (1 << 24)
+// Segments mapped at once (input & output of each request in flight)
+#define SEGMENT_GUARD_SLOTS 256
+// Timeouts of the client (ms)
+#define CLIENT_CONNECT_TIMEOUT_MS 3000
+#define CLIENT_REPLY_TIMEOUT_MS 600000
+
+// Processing options a request may not change: they reconfigure the
+// whole process, not the request
+static const char *g_daemonReservedOptions[] = { "pool-threads", "pool-affinity", "tile-budget", "trace" };
+
+// Client options, not forwarded to the daemon
+static const char *g_clientOptions[] = { "client", "socket", "repeat", "stats" };
+
+#ifdef Q_OS_UNIX
+/*
+ * A segment truncated by its owner while mapped raises SIGBUS on the
+ * thread touching the pages past its new end, any pool thread. The
+ * mapped ranges are registered here (lock free, read by the handler):
+ * a fault in one of them maps anonymous pages over the rest of the
+ * segment and flags it, the access is retried and the processing ends
+ * normally. The request then fails instead of the daemon.
+ */
+typedef struct
+{
+    std::atomic<uintptr_t> begin;
+    std::atomic<uintptr_t> end;
+    std::atomic<bool> bTruncated;
+} SegmentGuard;
+
+static SegmentGuard g_segmentGuards[SEGMENT_GUARD_SLOTS];
+static uintptr_t g_pageSize = 4096;
+
+static void segmentFaultHandler(int _signal, siginfo_t *_info, void *_context)
+{
+    uintptr_t address = (uintptr_t)_info->si_addr;
+
+    Q_UNUSED(_context);
+
+    for(SegmentGuard &guard : g_segmentGuards)
+    {
+        uintptr_t begin = guard.begin;
+        uintptr_t end = guard.end;
+
+        if( (begin != 0) && (address >= begin) && (address < end) )
+        {
+            uintptr_t page = address & ~(g_pageSize - 1);
+
+            // mmap() is a plain system call, safe in the handler on Linux
+            if(mmap((void *)page, end - page, PROT_READ | PROT_WRITE,
+                    MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) != MAP_FAILED)
+            {
+                guard.bTruncated = true;
+                return;
+            }
+            break;
+        }
+    }
+
+    // Not a segment fault: the default action, once the handler returns
+    signal(_signal, SIG_DFL);
+    raise(_signal);
+}
+
+static bool bInstallSegmentFaultHandler()
+{
+    struct sigaction action;
+
+    g_pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = segmentFaultHandler;
+
+    return sigaction(SIGBUS, &action, nullptr) == 0;
+}
+#endif
+
+SharedSegment::SharedSegment() :
+    m_data(nullptr),
+    m_size(0),
+    m_bOwner(false),
+    m_guard(-1)
+{
+}
+
+SharedSegment::~SharedSegment()
+{
+    close();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCreate() - Create and map a new segment, removed when closed
++ ----------------
++ Parameters : _name    segment name ("/name")
++              _size    size in bytes
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool SharedSegment::bCreate(const QString &_name, size_t _size)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    int fd = shm_open(_name.toLocal8Bit().constData(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+
+    if(fd < 0)
+    {
+        qDebug() << __func__ << " Could not create shared memory" << _name;
+        return false;
+    }
+
+    m_name = _name;
+    m_bOwner = true;
+
+    if(ftruncate(fd, (off_t)_size) != 0)
+    {
+        ::close(fd);
+        close();
+        qDebug() << __func__ << " Could not size shared memory" << _name;
+        return false;
+    }
+
+    return bMap(fd, _size);
+#else
+    Q_UNUSED(_name);
+    Q_UNUSED(_size);
+    qDebug() << __func__ << " Shared memory not supported!";
+    return false;
+#endif
+}
+
+/**
+*************************************************************************
+@verbatim
++ bOpen() - Map an existing segment, left in place when closed.
++           The size is checked here only: a segment truncated by its
++           owner afterwards reads as zeros, see bTruncated()
++ ----------------
++ Parameters : _name    segment name ("/name")
++              _minSize minimum size expected in bytes
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool SharedSegment::bOpen(const QString &_name, size_t _minSize)
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    struct stat status;
+    int fd;
+
+    if(!_name.startsWith('/'))
+        return false;
+
+    fd = shm_open(_name.toLocal8Bit().constData(), O_RDWR, 0);
+    if(fd < 0)
+        return false;
+
+    if( (fstat(fd, &status) != 0) || ((size_t)status.st_size < _minSize) || (status.st_size == 0) )
+    {
+        ::close(fd);
+        return false;
+    }
+
+    m_name = _name;
+    m_bOwner = false;
+
+    return bMap(fd, (size_t)status.st_size);
+#else
+    Q_UNUSED(_name);
+    Q_UNUSED(_minSize);
+    return false;
+#endif
+}
+
+bool SharedSegment::bMap(int _fd, size_t _size)
+{
+#ifdef Q_OS_UNIX
+    static const bool bGuarded = bInstallSegmentFaultHandler();
+    void *data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+
+    // The mapping stays valid once the descriptor is closed
+    ::close(_fd);
+
+    if(data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    m_data = (unsigned char *)data;
+    m_size = _size;
+
+    // Registered before any access to the pixels
+    for(int i = 0; bGuarded && (m_guard < 0) && (i < SEGMENT_GUARD_SLOTS); i++)
+    {
+        uintptr_t free = 0;
+
+        if(g_segmentGuards[i].begin.compare_exchange_strong(free, (uintptr_t)data))
+        {
+            g_segmentGuards[i].bTruncated = false;
+            g_segmentGuards[i].end = (uintptr_t)data + _size;
+            m_guard = i;
+        }
+    }
+
+    if(m_guard < 0)
+    {
+        qDebug() << __func__ << " No fault guard left for" << m_name;
+        close();
+        return false;
+    }
+
+    return true;
+#else
+    Q_UNUSED(_fd);
+    Q_UNUSED(_size);
+    return false;
+#endif
+}
+
+void SharedSegment::close()
+{
+#ifdef Q_OS_UNIX
+    if(m_guard >= 0)
+    {
+        g_segmentGuards[m_guard].end = 0;
+        g_segmentGuards[m_guard].begin = 0;
+    }
+
+    if(m_data != nullptr)
+        munmap(m_data, m_size);
+
+    if(m_bOwner)
+        shm_unlink(m_name.toLocal8Bit().constData());
+#endif
+
+    m_name.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_bOwner = false;
+    m_guard = -1;
+}
+
+// TRUE if the segment was truncated by its owner while mapped
+bool SharedSegment::bTruncated() const
+{
+#ifdef Q_OS_UNIX
+    return (m_guard >= 0) && g_segmentGuards[m_guard].bTruncated;
+#else
+    return false;
+#endif
+}
+
+unsigned char *SharedSegment::data() const
+{
+    return m_data;
+}
+
+size_t SharedSegment::size() const
+{
+    return m_size;
+}
+
+ProcessingDaemon::ProcessingDaemon(QObject *_parent) :
+    QObject(_parent),
+    m_server(new QLocalServer(this)),
+    m_nextConnection(0),
+    m_inFlight(0),
+    m_requests(0),
+    m_failed(0),
+    m_totalLatencyMs(0),
+    m_maxLatencyMs(0),
+    m_megaPixels(0),
+    m_processMs(0),
+    m_nextLatency(0)
+{
+    m_uptime.start();
+    m_recentLatencies.reserve(DAEMON_LATENCY_SAMPLES);
+
+    (void)QObject::connect(m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    // Replies are emitted by the pool threads
+    (void)QObject::connect(this, SIGNAL(replyReady(quint64,QByteArray,qint64,double,double)),
+                           this, SLOT(sendReply(quint64,QByteArray,qint64,double,double)), Qt::QueuedConnection);
+}
+
+ProcessingDaemon::~ProcessingDaemon()
+{
+    std::unique_lock<std::mutex> lock(m_inFlightMutex);
+
+    // Requests being processed still refer to the daemon
+    m_idle.wait(lock, [this]() { return m_inFlight == 0; });
+}
+
+/**
+*************************************************************************
+@verbatim
++ bListen() - Listen on a Unix domain socket, only reachable by the user
++             running the daemon. A stale socket is replaced
++ ----------------
++ Parameters : _socket  socket path
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ProcessingDaemon::bListen(const QString &_socket)
+{
+    QLocalServer::removeServer(_socket);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    if(!m_server->listen(_socket))
+    {
+        qDebug() << __func__ << " Could not listen on" << _socket << ":" << m_server->errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void ProcessingDaemon::acceptConnection()
+{
+    while(m_server->hasPendingConnections())
+    {
+        QLocalSocket *socket = m_server->nextPendingConnection();
+        Connection connection = { socket, false };
+        quint64 id = m_nextConnection++;
+
+        socket->setProperty("connection", id);
+        m_connections.insert(id, connection);
+
+        (void)QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        (void)QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(dropConnection()));
+    }
+}
+
+void ProcessingDaemon::readRequests()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+
+    if(socket != nullptr)
+        serveNext(socket->property("connection").toULongLong());
+}
+
+void ProcessingDaemon::dropConnection()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+
+    if(socket == nullptr)
+        return;
+
+    // A reply still being processed is dropped when it completes
+    m_connections.remove(socket->property("connection").toULongLong());
+    socket->deleteLater();
+}
+
+/**
+*************************************************************************
+@verbatim
++ serveNext() - Answer the pending request lines of a connection, in
++               order. A PROCESS request is run on the work pool; the
++               next lines wait for its reply
++ ----------------
++ Parameters : _connection  connection identifier
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ProcessingDaemon::serveNext(quint64 _connection)
+{
+    QHash<quint64, Connection>::iterator connection = m_connections.find(_connection);
+
+    if(connection == m_connections.end())
+        return;
+
+    QLocalSocket *socket = connection->socket;
+
+    while(!connection->bBusy && socket->canReadLine())
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        QStringList arguments = QString::fromUtf8(socket->readLine().trimmed()).split(' ', Qt::SkipEmptyParts);
+#else
+        QStringList arguments = QString::fromUtf8(socket->readLine().trimmed()).split(' ', QString::SkipEmptyParts);
+#endif
+        QString command;
+
+        if(arguments.isEmpty())
+            continue;
+
+        command = arguments.takeFirst().toUpper();
+
+        if(command == "PING")
+        {
+            socket->write("PONG\n");
+        }
+        else if(command == "STATS")
+        {
+            socket->write(statsReply() + "\n");
+        }
+        else if(command == "PROCESS")
+        {
+            qint64 receivedNs = m_uptime.nsecsElapsed();
+
+            connection->bBusy = true;
+            m_inFlight++;
+
+            WorkPool::instance().submit([this, _connection, arguments, receivedNs]()
+            {
+                double megaPixels = 0;
+                double processMs = 0;
+                QByteArray reply;
+
+                // An exception would end the pool thread, and the reply
+                // would never be sent
+                try
+                {
+                    reply = processRequest(arguments, megaPixels, processMs);
+                }
+                catch(const std::exception &e)
+                {
+                    reply = QByteArray("ERR ") + e.what();
+                }
+
+                emit replyReady(_connection, reply, receivedNs, processMs, megaPixels);
+
+                // Notified under the lock: the daemon is not destroyed before
+                // this task is done with it
+                std::lock_guard<std::mutex> lock(m_inFlightMutex);
+                if(--m_inFlight == 0)
+                    m_idle.notify_all();
+            });
+        }
+        else
+        {
+            socket->write("ERR unknown command " + command.toUtf8() + "\n");
+        }
+    }
+
+    if(!connection->bBusy && !socket->canReadLine() && (socket->bytesAvailable() > DAEMON_MAX_LINE))
+    {
+        socket->write("ERR request too long\n");
+        socket->disconnectFromServer();
+    }
+}
+
+void ProcessingDaemon::sendReply(quint64 _connection, const QByteArray &_reply, qint64 _receivedNs,
+                                 double _processMs, double _megaPixels)
+{
+    QHash<quint64, Connection>::iterator connection = m_connections.find(_connection);
+
+    record(_reply.startsWith("OK"), (m_uptime.nsecsElapsed() - _receivedNs) / 1e6, _processMs, _megaPixels);
+
+    if(connection == m_connections.end())
+        return;
+
+    connection->socket->write(_reply + "\n");
+    connection->bBusy = false;
+
+    serveNext(_connection);
+}
+
+/**
+*************************************************************************
+@verbatim
++ processRequest() - Process the image of a PROCESS request: the input
++                    segment is processed without copy, the result is
++                    written into the output segment (or the input one)
++ ----------------
++ Parameters : _arguments   request arguments (after PROCESS)
++              _megaPixels  receives the size of the image
++              _processMs   receives the processing duration
++ Returns    : QByteArray the reply, "OK <ms>" or "ERR <reason>"
+@endverbatim
+***************************************************************************/
+QByteArray ProcessingDaemon::processRequest(const QStringList &_arguments, double &_megaPixels, double &_processMs)
+{
+    QCommandLineParser parser;
+    BatchOperation operation;
+    SharedSegment input;
+    SharedSegment output;
+    QElapsedTimer timer;
+    cv::Mat result;
+    qint64 width;
+    qint64 height;
+    qint64 stride;
+    qint64 outStride;
+    bool bProcessed;
+
+    parser.addOptions({
+        { "in", "Shared memory segment of the input BGR image", "name" },
+        { "width", "Image width", "pixels" },
+        { "height", "Image height", "pixels" },
+        { "stride", "Bytes per input row (default 3 x width)", "bytes", "0" },
+        { "out", "Shared memory segment of the result (default the input)", "name" },
+        { "out-stride", "Bytes per output row (default 3 x width)", "bytes", "0" },
+    });
+    addProcessingOptions(parser);
+
+    if(!parser.parse(QStringList("PROCESS") + _arguments))
+        return "ERR " + parser.errorText().toUtf8();
+
+    for(const char *option : g_daemonReservedOptions)
+    {
+        if(parser.isSet(option))
+            return QByteArray("ERR option not allowed in a request: ") + option;
+    }
+
+    // In 64 bits, so that no product of the client values overflows
+    width = parser.value("width").toLongLong();
+    height = parser.value("height").toLongLong();
+    stride = (parser.value("stride").toLongLong() > 0) ? parser.value("stride").toLongLong() : 3 * width;
+    outStride = (parser.value("out-stride").toLongLong() > 0) ? parser.value("out-stride").toLongLong() : 3 * width;
+
+    if( (width <= 0) || (width > DAEMON_MAX_SIDE) || (height <= 0) || (height > DAEMON_MAX_SIDE) ||
+        (stride < 3 * width) || (stride > DAEMON_MAX_STRIDE) ||
+        (outStride < 3 * width) || (outStride > DAEMON_MAX_STRIDE) )
+        return "ERR bad image geometry";
+
+    if(!bParseProcessingOptions(parser, operation) ||
+       (operation.bDenoize && !ImageProcessor::bCheckDenoizeParams(operation.type, operation.params)))
+        return "ERR bad processing options";
+
+    if(!input.bOpen(parser.value("in"), (size_t)stride * height))
+        return "ERR could not map input " + parser.value("in").toUtf8();
+
+    if(parser.isSet("out") && !output.bOpen(parser.value("out"), (size_t)outStride * height))
+        return "ERR could not map output " + parser.value("out").toUtf8();
+
+    // Headers on the shared pixels, nothing is copied in. A segment
+    // truncated by the client meanwhile fails the request only
+    cv::Mat in((int)height, (int)width, CV_8UC3, input.data(), (size_t)stride);
+    cv::Mat out((int)height, (int)width, CV_8UC3, parser.isSet("out") ? output.data() : input.data(),
+                (size_t)(parser.isSet("out") ? outStride : stride));
+
+    timer.start();
+    {
+        ScopedTimer scopedTimer("daemon", 2 * in.total() * in.elemSize());
+
+        if( !operation.bEdit && operation.bDenoize && parser.isSet("out") &&
+            (parser.value("out") != parser.value("in")) )
+        {
+            // Denoized straight into the output segment (caller buffer)
+            bProcessed = ImageProcessor::bDenoizeImage(in, out, operation.type, operation.params) &&
+                         (out.data == output.data());
+        }
+        else
+        {
+            bProcessed = BatchProcessor::bApplyOperation(operation, in, result);
+
+            // Processed into a new buffer, so writing in place is safe
+            if(bProcessed)
+                result.copyTo(out);
+        }
+    }
+
+    if(input.bTruncated() || output.bTruncated())
+        return "ERR segment truncated during the request";
+
+    if(!bProcessed)
+        return "ERR processing failed";
+
+    _processMs = timer.nsecsElapsed() / 1e6;
+    _megaPixels = in.total() / 1e6;
+
+    return "OK " + QByteArray::number(_processMs, 'f', 2);
+}
+
+void ProcessingDaemon::record(bool _bOK, double _latencyMs, double _processMs, double _megaPixels)
+{
+    m_requests++;
+    if(!_bOK)
+    {
+        m_failed++;
+        return;
+    }
+
+    m_totalLatencyMs += _latencyMs;
+    m_maxLatencyMs = std::max(m_maxLatencyMs, _latencyMs);
+    m_megaPixels += _megaPixels;
+    m_processMs += _processMs;
+
+    if(m_recentLatencies.size() < DAEMON_LATENCY_SAMPLES)
+        m_recentLatencies.append(_latencyMs);
+    else
+        m_recentLatencies[m_nextLatency] = _latencyMs;
+    m_nextLatency = (m_nextLatency + 1) % DAEMON_LATENCY_SAMPLES;
+}
+
+/**
+*************************************************************************
+@verbatim
++ stats() - Return the counters of the successful requests. Percentiles
++           are computed over the last DAEMON_LATENCY_SAMPLES requests
++ ----------------
++ Parameters : NONE
++ Returns    : DaemonStats the counters
+@endverbatim
+***************************************************************************/
+DaemonStats ProcessingDaemon::stats() const
+{
+    QVector<double> latencies = m_recentLatencies;
+    qint64 succeeded = m_requests - m_failed;
+    DaemonStats stats;
+
+    std::sort(latencies.begin(), latencies.end());
+
+    stats.requests = m_requests;
+    stats.failed = m_failed;
+    stats.inFlight = m_inFlight;
+    stats.meanLatencyMs = (succeeded > 0) ? m_totalLatencyMs / succeeded : 0;
+    stats.p50LatencyMs = latencies.isEmpty() ? 0 : latencies[latencies.size() / 2];
+    stats.p99LatencyMs = latencies.isEmpty() ? 0 : latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    stats.maxLatencyMs = m_maxLatencyMs;
+    stats.megaPixels = m_megaPixels;
+    stats.processMpPerS = (m_processMs > 0) ? m_megaPixels * 1000 / m_processMs : 0;
+    stats.uptimeS = m_uptime.nsecsElapsed() / 1e9;
+
+    return stats;
+}
+
+QByteArray ProcessingDaemon::statsReply() const
+{
+    DaemonStats daemon = stats();
+    WorkPoolStats pool = WorkPool::instance().stats();
+
+    return QString("STATS requests=%1 failed=%2 in_flight=%3 mean_ms=%4 p50_ms=%5 p99_ms=%6 max_ms=%7 "
+                   "mp=%8 process_mp_per_s=%9 uptime_mp_per_s=%10 uptime_s=%11 pool_threads=%12 "
+                   "pool_queued=%13 pool_steals=%14")
+           .arg(daemon.requests).arg(daemon.failed).arg(daemon.inFlight)
+           .arg(daemon.meanLatencyMs, 0, 'f', 2).arg(daemon.p50LatencyMs, 0, 'f', 2)
+           .arg(daemon.p99LatencyMs, 0, 'f', 2).arg(daemon.maxLatencyMs, 0, 'f', 2)
+           .arg(daemon.megaPixels, 0, 'f', 1).arg(daemon.processMpPerS, 0, 'f', 1)
+           .arg((daemon.uptimeS > 0) ? daemon.megaPixels / daemon.uptimeS : 0, 0, 'f', 2)
+           .arg(daemon.uptimeS, 0, 'f', 0).arg(pool.threads).arg(pool.queued).arg(pool.steals)
+           .toUtf8();
+}
+
+/**
+*************************************************************************
+@verbatim
++ runDaemonCommandLine() - Parse daemon mode arguments and serve until
++                          killed.
++                          Usage: ImageEnhancer --daemon --socket /tmp/ie.sock
++ ----------------
++ Parameters : _arguments   application arguments
++ Returns    : int process exit code
+@endverbatim
+***************************************************************************/
+int runDaemonCommandLine(const QStringList &_arguments)
+{
+    QCommandLineParser parser;
+
+    parser.setApplicationDescription("Persistent local processing service (Unix domain socket & shared memory)");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "daemon", "Run as a local processing daemon" },
+        { "socket", "Path of the Unix domain socket", "path", QDir::temp().filePath(DAEMON_SOCKET_NAME) },
+    });
+    addPoolOptions(parser);
+
+    parser.process(_arguments);
+
+#ifdef Q_OS_UNIX
+    ProcessingDaemon daemon;
+
+    if(!bParsePoolOptions(parser) || !daemon.bListen(parser.value("socket")))
+        return 1;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QTextStream(stdout) << "Listening on " << parser.value("socket") << Qt::endl;
+#else
+    QTextStream(stdout) << "Listening on " << parser.value("socket") << endl;
+#endif
+
+    return QCoreApplication::exec();
+#else
+    qDebug() << "Daemon mode requires POSIX shared memory!";
+    return 1;
+#endif
+}
+
+/**
+*************************************************************************
+@verbatim
++ runClientCommandLine() - Send an image to the daemon and save the
++                          result, or print the daemon counters.
++                          Usage: ImageEnhancer --client in.png out.png --op gaussian [--repeat N]
++                                 ImageEnhancer --client --stats
++ ----------------
++ Parameters : _arguments   application arguments
++ Returns    : int process exit code
+@endverbatim
+***************************************************************************/
+int runClientCommandLine(const QStringList &_arguments)
+{
+    QCommandLineParser parser;
+    QLocalSocket socket;
+    QTextStream out(stdout);
+    SharedSegment input;
+    SharedSegment output;
+    QElapsedTimer timer;
+    QByteArray request;
+    QString name = QString("/imageenhancer-client-%1").arg(QCoreApplication::applicationPid());
+    double totalMs = 0;
+    int repeat;
+    cv::Mat img;
+
+    parser.setApplicationDescription("Test client of the processing daemon");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Image to process");
+    parser.addPositionalArgument("output", "Image receiving the result");
+    parser.addOptions({
+        { "client", "Run as a client of the processing daemon" },
+        { "socket", "Path of the Unix domain socket", "path", QDir::temp().filePath(DAEMON_SOCKET_NAME) },
+        { "repeat", "Number of requests sent", "N", "1" },
+        { "stats", "Print the daemon counters" },
+    });
+    addProcessingOptions(parser);
+
+    parser.process(_arguments);
+
+    socket.connectToServer(parser.value("socket"));
+    if(!socket.waitForConnected(CLIENT_CONNECT_TIMEOUT_MS))
+    {
+        qDebug() << "Could not connect to" << parser.value("socket") << ":" << socket.errorString();
+        return 1;
+    }
+
+    if(parser.isSet("stats"))
+    {
+        socket.write("STATS\n");
+        while(!socket.canReadLine() && socket.waitForReadyRead(CLIENT_CONNECT_TIMEOUT_MS))
+        {
+        }
+        out << socket.readLine();
+        return 0;
+    }
+
+    if(parser.positionalArguments().size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    img = cv::imread(parser.positionalArguments().at(0).toStdString());
+    if(img.empty())
+    {
+        qDebug() << "Could not read" << parser.positionalArguments().at(0);
+        return 1;
+    }
+
+    if(!input.bCreate(name, img.total() * img.elemSize()) ||
+       !output.bCreate(name + "-out", img.total() * img.elemSize()))
+        return 1;
+
+    img.copyTo(cv::Mat(img.rows, img.cols, CV_8UC3, input.data()));
+
+    // Processing options are forwarded as given
+    request = QString("PROCESS --in %1 --width %2 --height %3 --out %4")
+              .arg(name).arg(img.cols).arg(img.rows).arg(name + "-out").toUtf8();
+    foreach(const QString &option, parser.optionNames())
+    {
+        if(std::find(std::begin(g_clientOptions), std::end(g_clientOptions), option) == std::end(g_clientOptions))
+            request += " --" + option.toUtf8() + " " + parser.value(option).toUtf8();
+    }
+    request += "\n";
+
+    repeat = std::max(1, parser.value("repeat").toInt());
+
+    for(int i = 0; i < repeat; i++)
+    {
+        QByteArray reply;
+
+        timer.start();
+        socket.write(request);
+        while(!socket.canReadLine() && socket.waitForReadyRead(CLIENT_REPLY_TIMEOUT_MS))
+        {
+        }
+        reply = socket.readLine().trimmed();
+        totalMs += timer.nsecsElapsed() / 1e6;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        out << reply << "\t" << QString::number(timer.nsecsElapsed() / 1e6, 'f', 2) << " ms round trip" << Qt::endl;
+#else
+        out << reply << "\t" << QString::number(timer.nsecsElapsed() / 1e6, 'f', 2) << " ms round trip" << endl;
+#endif
+
+        if(!reply.startsWith("OK"))
+            return 1;
+    }
+
+    out << repeat << " requests, mean round trip " << QString::number(totalMs / repeat, 'f', 2) << " ms, "
+        << QString::number(img.total() / 1e6 * repeat * 1000 / totalMs, 'f', 1) << " MP/s";
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    out << Qt::endl;
+#else
+    out << endl;
+#endif
+
+    if(!cv::imwrite(parser.positionalArguments().at(1).toStdString(),
+                    cv::Mat(img.rows, img.cols, CV_8UC3, output.data())))
+    {
+        qDebug() << "Could not write" << parser.positionalArguments().at(1);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#ifndef PROCESSINGDAEMON_H
+#define PROCESSINGDAEMON_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+class QLocalServer;
+class QLocalSocket;
+
+typedef struct
+{
+    qint64 requests;
+    qint64 failed;
+    int inFlight;
+    // Latency from the reception of a request to its reply
+    double meanLatencyMs;
+    double p50LatencyMs;
+    double p99LatencyMs;
+    double maxLatencyMs;
+    // Pixels processed, per second of processing and of uptime
+    double megaPixels;
+    double processMpPerS;
+    double uptimeS;
+} DaemonStats;
+
+/*
+ * POSIX shared memory segment mapped in this process. Pixels exchanged
+ * with the daemon are never copied into messages: the client writes them
+ * into a segment and sends its name. A segment truncated by its owner
+ * while mapped does not crash the process (SIGBUS): the missing pages
+ * read as zeros and bTruncated() is set.
+ */
+class SharedSegment
+{
+public:
+    SharedSegment();
+    ~SharedSegment();
+
+    bool bCreate(const QString &_name, size_t _size);
+    bool bOpen(const QString &_name, size_t _minSize);
+    void close();
+
+    unsigned char *data() const;
+    size_t size() const;
+    bool bTruncated() const;
+
+private:
+    SharedSegment(const SharedSegment &);
+    SharedSegment &operator=(const SharedSegment &);
+
+    bool bMap(int _fd, size_t _size);
+
+    QString         m_name;
+    unsigned char  *m_data;
+    size_t          m_size;
+    bool            m_bOwner;
+    // Slot of the SIGBUS guard of the mapping, -1 if none
+    int             m_guard;
+};
+
+/*
+ * Persistent local processing service: listens on a Unix domain socket,
+ * processes images passed through shared memory with the processing
+ * options of batch mode, and keeps the work pool and the measured costs
+ * warm between requests. One request line, one reply line:
+ *
+ *   PROCESS --in /shm --width W --height H [--stride S] [--out /shm]
+ *           [--out-stride S] <processing options>  ->  OK <ms> | ERR <why>
+ *   STATS                                          ->  STATS key=value...
+ *   PING                                           ->  PONG
+ *
+ * Images are 8-bit BGR. The result goes to --out, else in place. The
+ * requests of a connection are answered in order, connections are
+ * processed concurrently on the work pool.
+ */
+class ProcessingDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ProcessingDaemon(QObject *_parent = nullptr);
+    ~ProcessingDaemon();
+
+    bool bListen(const QString &_socket);
+    DaemonStats stats() const;
+
+    // Processing of one PROCESS request, on any thread
+    static QByteArray processRequest(const QStringList &_arguments, double &_megaPixels, double &_processMs);
+
+signals:
+    void replyReady(quint64 _connection, const QByteArray &_reply, qint64 _receivedNs,
+                    double _processMs, double _megaPixels);
+
+private slots:
+    void acceptConnection();
+    void readRequests();
+    void dropConnection();
+    void sendReply(quint64 _connection, const QByteArray &_reply, qint64 _receivedNs,
+                   double _processMs, double _megaPixels);
+
+private:
+    typedef struct
+    {
+        QLocalSocket *socket;
+        bool bBusy;
+    } Connection;
+
+    void serveNext(quint64 _connection);
+    QByteArray statsReply() const;
+    void record(bool _bOK, double _latencyMs, double _processMs, double _megaPixels);
+
+    QLocalServer               *m_server;
+    QHash<quint64, Connection>  m_connections;
+    quint64                     m_nextConnection;
+    // Requests being processed by the pool, m_idle is notified when the
+    // last one is done (under m_inFlightMutex)
+    std::atomic<int>            m_inFlight;
+    std::mutex                  m_inFlightMutex;
+    std::condition_variable     m_idle;
+
+    // Counters, updated on the daemon thread
+    QElapsedTimer               m_uptime;
+    qint64                      m_requests;
+    qint64                      m_failed;
+    double                      m_totalLatencyMs;
+    double                      m_maxLatencyMs;
+    double                      m_megaPixels;
+    double                      m_processMs;
+    QVector<double>             m_recentLatencies;
+    int                         m_nextLatency;
+};
+
+int runDaemonCommandLine(const QStringList &_arguments);
+int runClientCommandLine(const QStringList &_arguments);
+
+#endif // PROCESSINGDAEMON_H
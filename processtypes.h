@@ -0,0 +1,43 @@
+#ifndef PROCESSTYPES_H
+#define PROCESSTYPES_H
+
+typedef enum
+{
+    TypeGaussianBlur = 0,
+    TypeMedianBlur = 1,
+    TypeNlMeans = 2,
+    TypeFastGaussian = 3,
+    TypeGuidedFilter = 4,
+    TypeBilateralGrid = 5
+} ProcessType;
+
+typedef struct
+{
+    // For GaussianBlur & FastGaussian (sigma x10)
+    int sigma;
+    int kernelSizeWidth;
+    int kernelSizeHeight;
+    // For MedianBlur
+    int aperture;
+    // For NlMeans
+    int h;
+    int hColor;
+    int templateWindowSize;
+    int searchWindowSize;
+    // For GuidedFilter (window radius in pixels, edge threshold in levels)
+    int guidedRadius;
+    int guidedEpsilon;
+    // For BilateralGrid (cell size in pixels, power of two, range sigma in levels)
+    int gridCellSize;
+    int gridRangeSigma;
+} ProcessParameters;
+
+typedef enum
+{
+    NlMeansDraft = 0,
+    NlMeansBalanced = 1,
+    NlMeansBest = 2,
+    NlMeansTierCount = 3
+} NlMeansTier;
+
+#endif // PROCESSTYPES_H
@@ -0,0 +1,221 @@
+#include "profiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+
+typedef struct
+{
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs;
+    qint64 bytes;
+    int threadId;
+} ProfileEvent;
+
+// Events kept for the trace; older ones are dropped beyond this count
+static const int g_maxProfileEvents = 1000000;
+
+static QMutex g_profileMutex;
+static QVector<ProfileEvent> g_profileEvents;
+// Number of events dropped from the front of g_profileEvents
+static int g_profileEventOffset = 0;
+static std::atomic<int> g_profileThreadCount(0);
+
+/**
+*************************************************************************
+@verbatim
++ setEnabled() - Enable or disable recording
++ ----------------
++ Parameters : _bEnabled   TRUE to record stages
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void Profiler::setEnabled(bool _bEnabled)
+{
+    StageClock::setRecorder(_bEnabled ? &Profiler::record : nullptr);
+}
+
+qint64 Profiler::now()
+{
+    return StageClock::now();
+}
+
+/**
+*************************************************************************
+@verbatim
++ record() - Record one stage (thread safe)
++ ----------------
++ Parameters : _name         stage name (static string)
++              _startNs      start time, see now()
++              _durationNs   duration of the stage
++              _bytes        bytes touched by the stage
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void Profiler::record(const char *_name, qint64 _startNs, qint64 _durationNs, qint64 _bytes)
+{
+    static thread_local int threadId = ++g_profileThreadCount;
+    ProfileEvent event;
+
+    event.name = _name;
+    event.startNs = _startNs;
+    event.durationNs = _durationNs;
+    event.bytes = _bytes;
+    event.threadId = threadId;
+
+    QMutexLocker locker(&g_profileMutex);
+
+    if(g_profileEvents.size() >= g_maxProfileEvents)
+    {
+        g_profileEvents.remove(0, g_maxProfileEvents / 2);
+        g_profileEventOffset += g_maxProfileEvents / 2;
+    }
+
+    g_profileEvents.append(event);
+}
+
+int Profiler::mark()
+{
+    QMutexLocker locker(&g_profileMutex);
+
+    return g_profileEventOffset + g_profileEvents.size();
+}
+
+/**
+*************************************************************************
+@verbatim
++ stageTimingsSince() - Return the durations & bytes of the stages
++                       recorded since a mark, summed per stage name in
++                       order of first occurrence
++ ----------------
++ Parameters : _mark    value returned by mark()
++ Returns    : StageTimings the stages
+@endverbatim
+***************************************************************************/
+StageTimings Profiler::stageTimingsSince(int _mark)
+{
+    StageTimings timings;
+
+    QMutexLocker locker(&g_profileMutex);
+
+    for(int i = std::max(0, _mark - g_profileEventOffset); i < g_profileEvents.size(); i++)
+    {
+        const ProfileEvent &event = g_profileEvents[i];
+        int j = 0;
+
+        while( (j < timings.size()) && (timings[j].name != QLatin1String(event.name)) )
+        {
+            j++;
+        }
+
+        if(j == timings.size())
+        {
+            StageTiming timing;
+            timing.name = QLatin1String(event.name);
+            timing.ms = 0;
+            timing.bytes = 0;
+            timings.append(timing);
+        }
+
+        timings[j].ms += event.durationNs / 1e6;
+        timings[j].bytes += event.bytes;
+    }
+
+    return timings;
+}
+
+/**
+*************************************************************************
+@verbatim
++ formatStageTimings() - Format stages for display:
++                        "imread 120.3 ms (36 MB) | edit 8.1 ms ..."
++ ----------------
++ Parameters : _timings   stages to format
++ Returns    : QString the formatted stages
+@endverbatim
+***************************************************************************/
+QString Profiler::formatStageTimings(const StageTimings &_timings)
+{
+    QStringList stages;
+
+    foreach(const StageTiming &timing, _timings)
+    {
+        QString stage = QString("%1 %2 ms").arg(timing.name).arg(timing.ms, 0, 'f', 1);
+
+        if(timing.bytes > 0)
+            stage += QString(" (%1 MB)").arg(timing.bytes / (1024.0 * 1024.0), 0, 'f', 1);
+
+        stages << stage;
+    }
+
+    return stages.join(" | ");
+}
+
+/**
+*************************************************************************
+@verbatim
++ bWriteTrace() - Write the recorded events as a Chrome trace_event JSON
++                 file
++ ----------------
++ Parameters : _file   output file
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool Profiler::bWriteTrace(const QString &_file)
+{
+    QJsonArray events;
+    QJsonObject root;
+    QFile file(_file);
+
+    {
+        QMutexLocker locker(&g_profileMutex);
+
+        foreach(const ProfileEvent &event, g_profileEvents)
+        {
+            QJsonObject json;
+            QJsonObject args;
+
+            args["bytes"] = (double)event.bytes;
+
+            json["name"] = QLatin1String(event.name);
+            json["cat"] = "ImageEnhancer";
+            json["ph"] = "X";
+            json["ts"] = event.startNs / 1e3;
+            json["dur"] = event.durationNs / 1e3;
+            json["pid"] = 1;
+            json["tid"] = event.threadId;
+            json["args"] = args;
+
+            events.append(json);
+        }
+    }
+
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug() << __func__ << " Could not open trace file!";
+        return false;
+    }
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+
+    return true;
+}
+
+void Profiler::clear()
+{
+    QMutexLocker locker(&g_profileMutex);
+
+    g_profileEventOffset += g_profileEvents.size();
+    g_profileEvents.clear();
+}
@@ -0,0 +1,49 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+#include "stagetimer.h"
+
+typedef struct
+{
+    QString name;
+    double ms;
+    qint64 bytes;
+} StageTiming;
+
+typedef QVector<StageTiming> StageTimings;
+
+/*
+ * Process wide recorder of hot path stages (name, duration, bytes
+ * touched), timed by ScopedTimer (see stagetimer.h). Disabled by
+ * default: a disabled ScopedTimer only costs a relaxed atomic load.
+ * Recorded events can be summarized per stage and exported as a Chrome
+ * trace_event file (chrome://tracing, Perfetto).
+ */
+class Profiler
+{
+public:
+    static void setEnabled(bool _bEnabled);
+    static bool bIsEnabled()
+    {
+        return StageClock::recorder() == &Profiler::record;
+    }
+
+    static qint64 now();
+    static void record(const char *_name, qint64 _startNs, qint64 _durationNs, qint64 _bytes);
+
+    // Events are numbered: stages of a job are the events recorded since a mark
+    static int mark();
+    static StageTimings stageTimingsSince(int _mark);
+    static QString formatStageTimings(const StageTimings &_timings);
+
+    static bool bWriteTrace(const QString &_file);
+    static void clear();
+};
+
+Q_DECLARE_METATYPE(StageTimings)
+
+#endif // PROFILER_H
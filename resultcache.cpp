@@ -0,0 +1,128 @@
+#include "resultcache.h"
+
+#include <algorithm>
+
+// QCache costs are int: account in KiB to allow budgets above 2 GB
+#define CACHE_COST_UNIT 1024
+
+ResultCache::ResultCache(qint64 _budgetBytes) :
+    m_hits(0),
+    m_misses(0)
+{
+    setBudget(_budgetBytes);
+}
+
+/**
+*************************************************************************
+@verbatim
++ setBudget() - Set the maximum number of bytes held by the cache. Least
++               recently used images are evicted to fit the new budget
++ ----------------
++ Parameters : _budgetBytes     budget in bytes
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ResultCache::setBudget(qint64 _budgetBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost((int)(_budgetBytes / CACHE_COST_UNIT));
+}
+
+qint64 ResultCache::budget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return (qint64)m_cache.maxCost() * CACHE_COST_UNIT;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bLookup() - Look for a cached image and mark it as most recently used
++ ----------------
++ Parameters : _key     key of the requested result
++              _img     receives the cached image (shared, read-only)
++ Returns    : TRUE if the image is cached; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool ResultCache::bLookup(const QString &_key, cv::Mat &_img)
+{
+    QMutexLocker locker(&m_mutex);
+    ImageRef *cached = m_cache.object(_key);
+
+    if(cached == nullptr)
+    {
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    _img = cached->mat();
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ insert() - Add an image to the cache, evicting least recently used
++            images if needed. Images larger than the budget are ignored
++ ----------------
++ Parameters : _key     key of the result
++              _img     image to cache (shared, not copied)
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ResultCache::insert(const QString &_key, const cv::Mat &_img)
+{
+    QMutexLocker locker(&m_mutex);
+
+    (void)m_cache.insert(_key, new ImageRef(_img, StoreCache), costOf(_img));
+}
+
+/**
+*************************************************************************
+@verbatim
++ trim() - Evict least recently used images until about _bytes are freed
++ ----------------
++ Parameters : _bytes   memory to free
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void ResultCache::trim(qint64 _bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    int maxCost = m_cache.maxCost();
+
+    // Lowering the maximum cost evicts the least recently used entries
+    m_cache.setMaxCost(std::max(0, m_cache.totalCost() - (int)((_bytes + CACHE_COST_UNIT - 1) / CACHE_COST_UNIT)));
+    m_cache.setMaxCost(maxCost);
+}
+
+void ResultCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
+
+int ResultCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+int ResultCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+qint64 ResultCache::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return (qint64)m_cache.totalCost() * CACHE_COST_UNIT;
+}
+
+int ResultCache::costOf(const cv::Mat &_img)
+{
+    return (int)((_img.total() * _img.elemSize() + CACHE_COST_UNIT - 1) / CACHE_COST_UNIT);
+}
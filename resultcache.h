@@ -0,0 +1,43 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+#include <opencv2/core.hpp>
+
+#include "imagestore.h"
+
+/*
+ * LRU cache of processed images with a byte budget. Cached images are
+ * shared (reference counted) and shall be treated as read-only.
+ */
+class ResultCache
+{
+public:
+    explicit ResultCache(qint64 _budgetBytes = 512LL * 1024 * 1024);
+
+    void setBudget(qint64 _budgetBytes);
+    qint64 budget() const;
+
+    bool bLookup(const QString &_key, cv::Mat &_img);
+    void insert(const QString &_key, const cv::Mat &_img);
+    void trim(qint64 _bytes);
+    void clear();
+
+    // Statistics
+    int hits() const;
+    int misses() const;
+    qint64 bytes() const;
+
+private:
+    static int costOf(const cv::Mat &_img);
+
+    mutable QMutex m_mutex;
+    QCache<QString, ImageRef> m_cache;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // RESULTCACHE_H
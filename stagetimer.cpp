@@ -0,0 +1,18 @@
+#include "stagetimer.h"
+
+#include <chrono>
+
+std::atomic<StageRecorder> StageClock::s_recorder(nullptr);
+
+void StageClock::setRecorder(StageRecorder _recorder)
+{
+    now();
+    s_recorder.store(_recorder, std::memory_order_relaxed);
+}
+
+long long StageClock::now()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,63 @@
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <atomic>
+
+// Receives the stages timed by ScopedTimer (name, start & duration in ns,
+// bytes touched), e.g. the Profiler
+typedef void (*StageRecorder)(const char *_name, long long _startNs, long long _durationNs, long long _bytes);
+
+/*
+ * Clock & recorder of the hot path stages of the processing library, no
+ * dependency on Qt. Without recorder, a ScopedTimer only costs a relaxed
+ * atomic load.
+ */
+class StageClock
+{
+public:
+    static void setRecorder(StageRecorder _recorder);
+    static StageRecorder recorder()
+    {
+        return s_recorder.load(std::memory_order_relaxed);
+    }
+
+    // Nanoseconds since the first use of the clock (monotonic)
+    static long long now();
+
+private:
+    static std::atomic<StageRecorder> s_recorder;
+};
+
+/*
+ * Record the duration of the enclosing scope
+ */
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *_name, long long _bytes = 0) :
+        m_name(_name),
+        m_bytes(_bytes),
+        m_recorder(StageClock::recorder()),
+        m_start((m_recorder != nullptr) ? StageClock::now() : -1)
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        if(m_recorder != nullptr)
+            m_recorder(m_name, m_start, StageClock::now() - m_start, m_bytes);
+    }
+
+    void setBytes(long long _bytes)
+    {
+        m_bytes = _bytes;
+    }
+
+private:
+    const char *m_name;
+    long long m_bytes;
+    StageRecorder m_recorder;
+    long long m_start;
+};
+
+#endif // STAGETIMER_H
@@ -0,0 +1,679 @@
+#include "stripprocessor.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QTextStream>
+#include <QDebug>
+
+#include <cctype>
+#include <climits>
+#include <cmath>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef HAVE_LIBTIFF
+#include <tiffio.h>
+#endif
+
+// Bytes per pixel at each step of a strip (input, edited, denoized and
+// internal buffers of the denoizing)
+static const double g_stripWorkingSetFactor = 7.0;
+
+// Smallest strip core processed at once. Strip cores are multiples of it,
+// so that grid based denoizers (cells up to 64 pixels) see the image grid
+static const int g_minStripRows = 64;
+
+StripProcessor::StripProcessor() :
+    m_memoryBudget(256 * 1024 * 1024),
+    m_cacheDir(QDir::tempPath()),
+    m_width(0),
+    m_height(0),
+    m_dataOffset(0)
+{
+    m_operation.bDenoize = false;
+    m_operation.type = TypeGaussianBlur;
+    m_operation.bEdit = false;
+}
+
+void StripProcessor::setOperation(const BatchOperation &_operation)
+{
+    m_operation = _operation;
+}
+
+void StripProcessor::setMemoryBudget(size_t _bytes)
+{
+    m_memoryBudget = _bytes;
+}
+
+void StripProcessor::setCacheDir(const QString &_dir)
+{
+    m_cacheDir = _dir;
+}
+
+/**
+*************************************************************************
+@verbatim
++ haloOf() - Return the number of rows a denoizing reads around a pixel,
++            so that strips extended by this halo give the same result
++            as the whole image
++ ----------------
++ Parameters : _operation   checked operation
++ Returns    : int the halo in rows
+@endverbatim
+***************************************************************************/
+int StripProcessor::haloOf(const BatchOperation &_operation)
+{
+    if(!_operation.bDenoize)
+        return 0;
+
+    return ImageProcessor::GetProcessHalo(_operation.type, _operation.params);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Stream an image through the operation, strip by strip
++ ----------------
++ Parameters : _input   image file (PPM read in place, other formats are
++                       converted to a raw cache first)
++              _output  PPM file receiving the result
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bRun(QString _input, QString _output)
+{
+    QFile outputFile(_output);
+    QElapsedTimer timer;
+    ColorEditKernel kernel;
+    int halo;
+    int rows;
+    std::vector<uchar> rgbRow;
+
+    if(m_operation.bDenoize && !ImageProcessor::bCheckDenoizeParams(m_operation.type, m_operation.params))
+    {
+        qDebug() << __func__ << " Bad parameters!";
+        return false;
+    }
+
+    if(!QStringList({ "ppm", "pnm" }).contains(QFileInfo(_output).suffix().toLower()))
+    {
+        qDebug() << __func__ << " Streamed output shall be a .ppm file!";
+        return false;
+    }
+
+    timer.start();
+
+    if(!bOpenInput(_input))
+        return false;
+
+    halo = haloOf(m_operation);
+    rows = stripRows(halo);
+
+    QTextStream(stdout) << m_width << "x" << m_height << " image, strips of " << rows
+                        << " rows + " << halo << " rows halo\n";
+
+    // Hue & saturation targets are relative to the levels of the whole image
+    if(m_operation.bEdit)
+    {
+        int meanHue = 0;
+        int meanSaturation = 0;
+
+        if(!bComputeMeanLevels(meanHue, meanSaturation))
+            return false;
+
+        ImageProcessor::buildEditKernel(kernel, m_operation.brightness, m_operation.contrast,
+                                        (m_operation.hue < 0) ? meanHue : m_operation.hue,
+                                        (m_operation.saturation < 0) ? meanSaturation : m_operation.saturation,
+                                        meanHue, meanSaturation);
+    }
+
+    if(!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+       !bWritePpmHeader(outputFile, m_width, m_height))
+    {
+        qDebug() << __func__ << " Could not open output file!";
+        return false;
+    }
+
+    rgbRow.resize((size_t)m_width * 3);
+
+    for(int first = 0; first < m_height; first += rows)
+    {
+        int coreRows = std::min(rows, m_height - first);
+        int top = std::max(0, first - halo);
+        int bottom = std::min(m_height, first + coreRows + halo);
+        cv::Mat strip;
+        cv::Mat out;
+        cv::Mat core;
+
+        if(!bReadStrip(top, bottom - top, strip))
+            return false;
+
+        // Editing is per pixel, applying it to the halo keeps the
+        // denoizing input identical to the whole image one
+        if(m_operation.bEdit)
+        {
+            if(!ImageProcessor::bEditImage(strip, out, kernel, false))
+                return false;
+            strip = out;
+        }
+
+        if(m_operation.bDenoize)
+        {
+            if(!ImageProcessor::bDenoizeImage(strip, out, m_operation.type, m_operation.params))
+                return false;
+            strip = out;
+        }
+
+        // Append the core rows to the output
+        core = strip.rowRange(first - top, first - top + coreRows);
+        for(int y = 0; y < core.rows; y++)
+        {
+            cv::Mat rgb(1, m_width, CV_8UC3, rgbRow.data());
+
+            cv::cvtColor(core.row(y), rgb, cv::COLOR_BGR2RGB);
+            if(outputFile.write((const char *)rgbRow.data(), (qint64)rgbRow.size()) != (qint64)rgbRow.size())
+            {
+                qDebug() << __func__ << " Could not write output file!";
+                return false;
+            }
+        }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        QTextStream(stdout) << "\r" << (first + coreRows) * 100 / m_height << " %" << Qt::flush;
+#else
+        QTextStream(stdout) << "\r" << (first + coreRows) * 100 / m_height << " %" << flush;
+#endif
+    }
+
+    QTextStream(stdout) << "\n" << QString::number(m_width * (double)m_height / 1e6, 'f', 1) << " MP in "
+                        << QString::number(timer.nsecsElapsed() / 1e9, 'f', 2) << " s\n";
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bOpenInput() - Open the input pixels: binary PPM files are read in
++                place, other formats go through the raw cache
++ ----------------
++ Parameters : _input   image file
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bOpenInput(const QString &_input)
+{
+    m_inputFile.setFileName(_input);
+
+    if(m_inputFile.open(QIODevice::ReadOnly) &&
+       bReadPpmHeader(m_inputFile, m_width, m_height, m_dataOffset))
+    {
+        return true;
+    }
+
+    m_inputFile.close();
+
+    if(!bBuildRawCache(_input))
+        return false;
+
+    m_inputFile.setFileName(m_cacheFile.fileName());
+
+    return m_inputFile.open(QIODevice::ReadOnly) &&
+           bReadPpmHeader(m_inputFile, m_width, m_height, m_dataOffset);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bBuildRawCache() - Decode the input into a raw PPM cache file. TIFF
++                   strips or tiles are read with libtiff, other strips
++                   are decoded one at a time when the image plugin can
++                   decode a region (clip rect); otherwise (PNG...) the
++                   image is decoded once as a whole, which shall fit in
++                   the memory budget
++ ----------------
++ Parameters : _input   image file
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bBuildRawCache(const QString &_input)
+{
+    QImageReader probe(_input);
+    QSize size;
+    int rows;
+
+    m_cacheFile.setFileTemplate(QDir(m_cacheDir).filePath("ImageEnhancer_XXXXXX.ppm"));
+
+    if(!m_cacheFile.open())
+    {
+        qDebug() << __func__ << " Could not create cache file!";
+        return false;
+    }
+
+    size = probe.size();
+
+#ifdef HAVE_LIBTIFF
+    if(QStringList({ "tif", "tiff" }).contains(QFileInfo(_input).suffix().toLower()))
+    {
+        if(!bCacheTiff(_input))
+            return false;
+    }
+    else
+#endif
+    if(size.isValid() && probe.supportsOption(QImageIOHandler::ClipRect))
+    {
+        // Whole width strips of about a quarter of the budget
+        rows = std::max(1, (int)(m_memoryBudget / 4 / ((size_t)size.width() * 4)));
+
+        if(!bWritePpmHeader(m_cacheFile, size.width(), size.height()))
+            return false;
+
+        for(int first = 0; first < size.height(); first += rows)
+        {
+            QImageReader reader(_input);
+            QImage strip;
+
+            reader.setClipRect(QRect(0, first, size.width(), std::min(rows, size.height() - first)));
+            strip = reader.read().convertToFormat(QImage::Format_RGB888);
+
+            if(strip.isNull())
+            {
+                qDebug() << __func__ << " Could not decode strip:" << reader.errorString();
+                return false;
+            }
+
+            for(int y = 0; y < strip.height(); y++)
+            {
+                m_cacheFile.write((const char *)strip.constScanLine(y), (qint64)size.width() * 3);
+            }
+        }
+    }
+    else
+    {
+        cv::Mat img;
+        cv::Mat rgb;
+
+        qDebug() << "No region decoding for" << QFileInfo(_input).suffix() << "files, decoding the whole image once";
+
+        // Known size: refuse before decoding
+        if( size.isValid() && !bFitsDecodeBudget(_input, size.width(), size.height()) )
+            return false;
+
+        img = cv::imread(_input.toStdString());
+        if(img.empty())
+        {
+            qDebug() << __func__ << " Could not decode input!";
+            return false;
+        }
+
+        if(!bFitsDecodeBudget(_input, img.cols, img.rows))
+            return false;
+
+        if(!bWritePpmHeader(m_cacheFile, img.cols, img.rows))
+            return false;
+
+        for(int y = 0; y < img.rows; y++)
+        {
+            cv::cvtColor(img.row(y), rgb, cv::COLOR_BGR2RGB);
+            m_cacheFile.write((const char *)rgb.ptr(), (qint64)img.cols * 3);
+        }
+    }
+
+    m_cacheFile.close();
+
+    return true;
+}
+
+#ifdef HAVE_LIBTIFF
+/**
+*************************************************************************
+@verbatim
++ bCacheTiff() - Write the pixels of a TIFF file into the cache, one row
++               of strips or tiles at a time: only that row is decoded
++               in memory. Any sample layout libtiff converts to RGBA is
++               read (bit depths, palettes, YCbCr, compressions)
++ ----------------
++ Parameters : _input   TIFF file (first image)
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bCacheTiff(const QString &_input)
+{
+    TIFF *tiff = TIFFOpen(QFile::encodeName(_input).constData(), "r");
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t blockWidth = 0;
+    uint32_t blockHeight = 0;
+    uint16_t orientation = ORIENTATION_TOPLEFT;
+    bool bTiled;
+    qint64 bytes;
+    std::vector<uint32_t> block;
+    std::vector<uchar> band;
+    bool bOK = true;
+
+    if(tiff == nullptr)
+    {
+        qDebug() << __func__ << " Could not open TIFF file!";
+        return false;
+    }
+
+    bTiled = (TIFFIsTiled(tiff) != 0);
+    (void)TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+    (void)TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+    (void)TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation);
+
+    if(bTiled)
+    {
+        (void)TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &blockWidth);
+        (void)TIFFGetField(tiff, TIFFTAG_TILELENGTH, &blockHeight);
+    }
+    else
+    {
+        blockWidth = width;
+        (void)TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &blockHeight);
+        blockHeight = std::min(blockHeight, height);
+    }
+
+    // Strips & tiles are read in file order, from the top row
+    if( (width == 0) || (height == 0) || (width > INT_MAX / 3) || (height > INT_MAX) ||
+        (blockWidth == 0) || (blockHeight == 0) || (orientation != ORIENTATION_TOPLEFT) )
+    {
+        qDebug() << __func__ << " Unsupported TIFF layout!";
+        TIFFClose(tiff);
+        return false;
+    }
+
+    // A row of strips or tiles: RGBA block & RGB band
+    bytes = (qint64)blockWidth * blockHeight * 4 + (qint64)width * blockHeight * 3;
+    if(bytes > (qint64)m_memoryBudget)
+    {
+        qDebug().noquote() << QString("%1: %2 of %3 rows need %4 MB, above the strip budget of %5 MB. "
+                                      "Rewrite it with smaller strips or tiles, or raise --strip-budget")
+                              .arg(QFileInfo(_input).fileName()).arg(bTiled ? "tiles" : "strips").arg(blockHeight)
+                              .arg(bytes >> 20).arg((qint64)(m_memoryBudget >> 20));
+        TIFFClose(tiff);
+        return false;
+    }
+
+    block.resize((size_t)blockWidth * blockHeight);
+    band.resize((size_t)width * blockHeight * 3);
+
+    bOK = bWritePpmHeader(m_cacheFile, (int)width, (int)height);
+
+    for(uint32_t top = 0; bOK && (top < height); top += blockHeight)
+    {
+        int rows = (int)std::min(blockHeight, height - top);
+
+        for(uint32_t left = 0; bOK && (left < width); left += blockWidth)
+        {
+            int cols = (int)std::min(blockWidth, width - left);
+            // RGBA blocks are bottom-up: a strip holds its rows only, a
+            // tile is flush with its bottom
+            int bottomRow = bTiled ? (int)blockHeight - 1 : rows - 1;
+
+            bOK = bTiled ? (TIFFReadRGBATile(tiff, left, top, block.data()) != 0) :
+                           (TIFFReadRGBAStrip(tiff, top, block.data()) != 0);
+
+            for(int y = 0; bOK && (y < rows); y++)
+            {
+                const uint32_t *src = block.data() + (size_t)(bottomRow - y) * blockWidth;
+                uchar *dst = band.data() + ((size_t)y * width + left) * 3;
+
+                for(int x = 0; x < cols; x++)
+                {
+                    dst[3 * x] = (uchar)TIFFGetR(src[x]);
+                    dst[3 * x + 1] = (uchar)TIFFGetG(src[x]);
+                    dst[3 * x + 2] = (uchar)TIFFGetB(src[x]);
+                }
+            }
+        }
+
+        if(!bOK)
+        {
+            qDebug() << __func__ << " Could not decode TIFF rows from" << top;
+        }
+        else if(m_cacheFile.write((const char *)band.data(), (qint64)width * rows * 3) != (qint64)width * rows * 3)
+        {
+            qDebug() << __func__ << " Could not write cache file!";
+            bOK = false;
+        }
+    }
+
+    TIFFClose(tiff);
+
+    return bOK;
+}
+#endif
+
+/**
+*************************************************************************
+@verbatim
++ bFitsDecodeBudget() - Check that an image decoded as a whole (BGR, 8
++                       bits) fits in the memory budget
++ ----------------
++ Parameters : _input   image file, for the message
++              _width   image width
++              _height  image height
++ Returns    : TRUE if it fits; FALSE otherwise (message printed)
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bFitsDecodeBudget(const QString &_input, int _width, int _height) const
+{
+    qint64 bytes = (qint64)_width * _height * 3;
+
+    if(bytes <= (qint64)m_memoryBudget)
+        return true;
+
+    qDebug().noquote() << QString("%1: %2x%3 image decoded as a whole (no region decoding for %4 files) needs %5 MB, "
+                                  "above the strip budget of %6 MB. Convert it to a binary PPM, which is read in place, "
+                                  "or raise --strip-budget")
+                          .arg(QFileInfo(_input).fileName()).arg(_width).arg(_height)
+                          .arg(QFileInfo(_input).suffix()).arg(bytes >> 20).arg((qint64)(m_memoryBudget >> 20));
+
+    return false;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bReadStrip() - Map rows of the input and convert them to BGR
++ ----------------
++ Parameters : _firstRow    first row of the strip
++              _rows        number of rows
++              _strip       receives the BGR strip
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bReadStrip(int _firstRow, int _rows, cv::Mat &_strip)
+{
+    qint64 stride = (qint64)m_width * 3;
+    uchar *data;
+
+    ScopedTimer timer("readStrip", stride * _rows);
+
+    // Only this strip is mapped: works with 32-bit address spaces too
+    data = m_inputFile.map(m_dataOffset + _firstRow * stride, _rows * stride);
+    if(data == nullptr)
+    {
+        qDebug() << __func__ << " Could not map input rows!";
+        return false;
+    }
+
+    _strip.release();
+    cv::cvtColor(cv::Mat(_rows, m_width, CV_8UC3, data, (size_t)stride), _strip, cv::COLOR_RGB2BGR);
+
+    m_inputFile.unmap(data);
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bComputeMeanLevels() - Compute the mean hue & saturation levels of the
++                        whole input, one strip at a time
++ ----------------
++ Parameters : _hue         receives the mean hue level
++              _saturation  receives the mean saturation level
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bComputeMeanLevels(int &_hue, int &_saturation)
+{
+    int rows = stripRows(0);
+    ImageStatistics statistics;
+
+    for(int first = 0; first < m_height; first += rows)
+    {
+        cv::Mat strip;
+
+        if(!bReadStrip(first, std::min(rows, m_height - first), strip))
+            return false;
+
+        statistics.accumulate(strip);
+    }
+
+    _hue = (int)statistics.mean(ChannelHue);
+    _saturation = (int)statistics.mean(ChannelSaturation);
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ stripRows() - Return the core rows of a strip fitting the memory budget
++ ----------------
++ Parameters : _halo    halo rows added to each strip
++ Returns    : int the core rows
+@endverbatim
+***************************************************************************/
+int StripProcessor::stripRows(int _halo) const
+{
+    double rowBytes = m_width * 3.0 * g_stripWorkingSetFactor;
+    int rows = (int)(m_memoryBudget / rowBytes) - 2 * _halo;
+
+    return std::max(g_minStripRows, rows - rows % g_minStripRows);
+}
+
+/**
+*************************************************************************
+@verbatim
++ bReadPpmHeader() - Read the header of a binary 8-bit PPM file (P6)
++ ----------------
++ Parameters : _file        opened file
++              _width       receives the image width
++              _height      receives the image height
++              _dataOffset  receives the offset of the first pixel
++ Returns    : TRUE if the file is a binary 8-bit PPM; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool StripProcessor::bReadPpmHeader(QFile &_file, int &_width, int &_height, qint64 &_dataOffset)
+{
+    QList<int> values;
+    QByteArray token;
+    char c;
+
+    _file.seek(0);
+
+    if(_file.read(2) != "P6")
+        return false;
+
+    // Width, height and maximum value, separated by blanks & comments
+    while( (values.size() < 3) && _file.getChar(&c) )
+    {
+        if(c == '#')
+        {
+            _file.readLine();
+        }
+        else if(isspace((unsigned char)c))
+        {
+            if(!token.isEmpty())
+            {
+                values << token.toInt();
+                token.clear();
+            }
+        }
+        else
+        {
+            token += c;
+        }
+    }
+
+    // A single blank follows the maximum value
+    if(!token.isEmpty())
+    {
+        values << token.toInt();
+        _file.getChar(&c);
+    }
+
+    if( (values.size() < 3) || (values[0] <= 0) || (values[1] <= 0) || (values[2] != 255) )
+        return false;
+
+    _width = values[0];
+    _height = values[1];
+    _dataOffset = _file.pos();
+
+    return _file.size() >= _dataOffset + (qint64)_width * _height * 3;
+}
+
+bool StripProcessor::bWritePpmHeader(QFile &_file, int _width, int _height)
+{
+    QByteArray header = QString("P6\n%1 %2\n255\n").arg(_width).arg(_height).toLatin1();
+
+    return _file.write(header) == header.size();
+}
+
+/**
+*************************************************************************
+@verbatim
++ runStripCommandLine() - Parse streaming mode arguments and stream the image.
++                         Usage: ImageEnhancer --stream in.tif out.ppm --op nlmeans --strip-budget 256
++ ----------------
++ Parameters : _arguments   application arguments
++ Returns    : int process exit code
+@endverbatim
+***************************************************************************/
+int runStripCommandLine(const QStringList &_arguments)
+{
+    QCommandLineParser parser;
+    StripProcessor processor;
+    BatchOperation operation;
+
+    parser.setApplicationDescription("Out-of-core processing of an image larger than memory");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Image to process (PPM files are read in place)");
+    parser.addPositionalArgument("output", "PPM file receiving the result");
+    parser.addOptions({
+        { "stream", "Run in headless streaming mode" },
+        { "strip-budget", "Memory budget of a strip (MB)", "MB", "256" },
+        { "cache-dir", "Directory of the raw input cache", "dir", QDir::tempPath() },
+    });
+    addProcessingOptions(parser);
+
+    parser.process(_arguments);
+
+    if(parser.positionalArguments().size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    if(!bParseProcessingOptions(parser, operation))
+        return 1;
+
+    processor.setOperation(operation);
+    processor.setMemoryBudget((size_t)std::max(1, parser.value("strip-budget").toInt()) * 1024 * 1024);
+    processor.setCacheDir(parser.value("cache-dir"));
+
+    bool bOK = processor.bRun(parser.positionalArguments().at(0), parser.positionalArguments().at(1));
+
+    if(parser.isSet("trace") && !Profiler::bWriteTrace(parser.value("trace")))
+    {
+        bOK = false;
+    }
+
+    return bOK ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#ifndef STRIPPROCESSOR_H
+#define STRIPPROCESSOR_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryFile>
+
+#include <cstddef>
+
+#include <opencv2/core.hpp>
+
+#include "batchprocessor.h"
+
+/*
+ * Out-of-core processing of images larger than memory. The input is
+ * read from a binary PPM file (P6), directly or through a raw PPM cache
+ * built strip by strip (TIFF strips & tiles with libtiff), and processed in full width strips extended by
+ * the halo of the operation. Only the strip being processed is mapped
+ * in memory; results are appended to the PPM output as soon as a strip
+ * is done, so peak memory depends on the strip size, not on the image.
+ */
+class StripProcessor
+{
+public:
+    StripProcessor();
+
+    void setOperation(const BatchOperation &_operation);
+    void setMemoryBudget(size_t _bytes);
+    void setCacheDir(const QString &_dir);
+
+    bool bRun(QString _input, QString _output);
+
+    // Rows above & below a strip needed to process its core exactly
+    static int haloOf(const BatchOperation &_operation);
+
+private:
+    bool bOpenInput(const QString &_input);
+    bool bBuildRawCache(const QString &_input);
+#ifdef HAVE_LIBTIFF
+    bool bCacheTiff(const QString &_input);
+#endif
+    bool bFitsDecodeBudget(const QString &_input, int _width, int _height) const;
+    bool bReadStrip(int _firstRow, int _rows, cv::Mat &_strip);
+    bool bComputeMeanLevels(int &_hue, int &_saturation);
+    int stripRows(int _halo) const;
+
+    static bool bReadPpmHeader(QFile &_file, int &_width, int &_height, qint64 &_dataOffset);
+    static bool bWritePpmHeader(QFile &_file, int _width, int _height);
+
+    BatchOperation  m_operation;
+    size_t          m_memoryBudget;
+    QString         m_cacheDir;
+
+    // Input pixels (RGB rows) in a PPM file, the original or the cache
+    QFile           m_inputFile;
+    QTemporaryFile  m_cacheFile;
+    int             m_width;
+    int             m_height;
+    qint64          m_dataOffset;
+};
+
+int runStripCommandLine(const QStringList &_arguments);
+
+#endif // STRIPPROCESSOR_H
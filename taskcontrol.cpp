@@ -0,0 +1,126 @@
+#include "taskcontrol.h"
+
+#include <algorithm>
+
+TaskControl::TaskControl() :
+    m_bCancelled(false),
+    m_percent(-1),
+    m_stepIndex(0),
+    m_stepCount(1)
+{
+
+}
+
+/**
+*************************************************************************
+@verbatim
++ reset() - Prepare the control for a new task: not cancelled, no
++           progress reported, single step
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TaskControl::reset()
+{
+    m_bCancelled = false;
+    resetProgress();
+}
+
+/**
+*************************************************************************
+@verbatim
++ cancel() - Request the task to stop at its next chunk boundary. Can be
++            called from any thread
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TaskControl::cancel()
+{
+    m_bCancelled.store(true, std::memory_order_relaxed);
+}
+
+bool TaskControl::bIsCancelled() const
+{
+    return m_bCancelled.load(std::memory_order_relaxed);
+}
+
+void TaskControl::setProgressFunction(const ProgressFunction &_function)
+{
+    m_function = _function;
+}
+
+/**
+*************************************************************************
+@verbatim
++ resetProgress() - Restart the progress from 0 with a single step, for a
++                   new phase of the task. Cancellation is kept
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TaskControl::resetProgress()
+{
+    m_percent = -1;
+    m_stepIndex = 0;
+    m_stepCount = 1;
+}
+
+/**
+*************************************************************************
+@verbatim
++ setStep() - Select the step reported by the next setProgress() calls
++ ----------------
++ Parameters : _index   index of the step
++              _count   number of steps of the task
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TaskControl::setStep(int _index, int _count)
+{
+    m_stepCount = std::max(_count, 1);
+    m_stepIndex = std::min(std::max(_index, 0), m_stepCount - 1);
+}
+
+/**
+*************************************************************************
+@verbatim
++ setProgress() - Report the progress of the current step. The progress
++                 function is only called when the total percentage
++                 increases
++ ----------------
++ Parameters : _done    chunks done in the current step
++              _total   chunks of the current step
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TaskControl::setProgress(long long _done, long long _total)
+{
+    int count = m_stepCount;
+    long long stepPercent = (_total > 0) ? (100 * std::min(_done, _total)) / _total : 100;
+
+    report((int)((m_stepIndex * 100 + stepPercent) / count));
+}
+
+void TaskControl::complete()
+{
+    report(100);
+}
+
+void TaskControl::report(int _percent)
+{
+    int last = m_percent;
+
+    while(_percent > last)
+    {
+        if(m_percent.compare_exchange_weak(last, _percent))
+        {
+            if(m_function)
+                m_function(_percent);
+            break;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef TASKCONTROL_H
+#define TASKCONTROL_H
+
+#include <atomic>
+#include <functional>
+
+// Receives the progress of a task, between 0 and 100
+typedef std::function<void(int _percent)> ProgressFunction;
+
+/*
+ * Cooperative cancellation & progress of a long task. The task runs in
+ * chunks (tiles, row bands) and checks bIsCancelled() between them, so a
+ * cancel takes effect within one chunk. A task made of several steps
+ * (e.g. the nodes of an operation stack) reports each step in its share
+ * of the total. Thread safe: chunks may report from any thread.
+ */
+class TaskControl
+{
+public:
+    TaskControl();
+
+    // Cancellation
+    void reset();
+    void cancel();
+    bool bIsCancelled() const;
+
+    // Progress
+    void setProgressFunction(const ProgressFunction &_function);
+    void resetProgress();
+    void setStep(int _index, int _count);
+    void setProgress(long long _done, long long _total);
+    void complete();
+
+private:
+    void report(int _percent);
+
+    std::atomic<bool> m_bCancelled;
+    std::atomic<int> m_percent;
+    std::atomic<int> m_stepIndex;
+    std::atomic<int> m_stepCount;
+    ProgressFunction m_function;
+};
+
+#endif // TASKCONTROL_H
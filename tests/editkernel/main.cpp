@@ -0,0 +1,207 @@
+#include "imagekernels.h"
+#include "testcommon.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+// Hue & saturation: the kernel works in float, the OpenCV path quantizes
+// the HSV image to 8 bits (2 degrees of hue). The HSV round trip alone
+// differs from its input by up to 6 levels
+#define EDIT_MAX_ERROR 8
+#define EDIT_MEAN_ERROR 1.0
+
+// Throughput image, 12 MP
+#define EDIT_BENCH_WIDTH 4000
+#define EDIT_BENCH_HEIGHT 3000
+#define EDIT_BENCH_REPS 3
+
+typedef struct
+{
+    int brightness;
+    int contrast;
+    // Multiple of 2 degrees (8-bit OpenCV hue unit)
+    int hueShiftDeg;
+    float saturationScale;
+} EditSetting;
+
+static const char *const g_isas[] = { "scalar", "sse2", "avx2" };
+
+static const EditSetting g_settings[] = {
+    { 100, 100, 0, 1.0f }, { 130, 80, 0, 1.0f }, { 60, 150, 0, 1.0f }, { 1, 200, 0, 1.0f }, { 200, 1, 0, 1.0f },
+    { 100, 100, 20, 1.0f }, { 100, 100, 180, 1.0f }, { 100, 100, -178, 1.0f }, { 100, 100, 0, 0.5f },
+    { 100, 100, 0, 1.5f }, { 100, 100, 0, 0.0f }, { 120, 110, -30, 1.3f }, { 150, 180, 40, 2.0f },
+    { 40, 60, -100, 0.2f }, { 100, 100, 90, 3.0f }
+};
+
+/**
+*************************************************************************
+@verbatim
++ editOpenCV() - Multi-pass editing with OpenCV: convertTo, BGR to HSV,
++                hue & saturation shift, HSV to BGR, BGR to RGB
++ ----------------
++ Parameters : _image   BGR input image
++              _setting editing values
++ Returns    : cv::Mat the RGB result
+@endverbatim
+***************************************************************************/
+static cv::Mat editOpenCV(const cv::Mat &_image, const EditSetting &_setting)
+{
+    int hueShift = ((_setting.hueShiftDeg / 2) % 180 + 180) % 180;
+    cv::Mat levels;
+    cv::Mat hsv;
+    cv::Mat bgr;
+    cv::Mat rgb;
+
+    _image.convertTo(levels, -1, (double)_setting.contrast / 100, _setting.brightness - 100);
+    cv::cvtColor(levels, hsv, cv::COLOR_BGR2HSV);
+
+    for(int y = 0; y < hsv.rows; y++)
+    {
+        unsigned char *row = hsv.ptr<unsigned char>(y);
+
+        for(int x = 0; x < hsv.cols; x++)
+        {
+            row[3 * x] = (unsigned char)((row[3 * x] + hueShift) % 180);
+            row[3 * x + 1] = cv::saturate_cast<unsigned char>(row[3 * x + 1] * _setting.saturationScale);
+        }
+    }
+
+    cv::cvtColor(hsv, bgr, cv::COLOR_HSV2BGR);
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+    return rgb;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCheckEdit() - Compare applyColorEditKernel() with editOpenCV() for
++                every setting: identical results for brightness &
++                contrast only (LUT), within the tolerance otherwise
++ ----------------
++ Parameters : _image   BGR test image
++ Returns    : TRUE if all the results are within the tolerance
+@endverbatim
+***************************************************************************/
+static bool bCheckEdit(const cv::Mat &_image)
+{
+    bool bSuccess = true;
+
+    for(const EditSetting &setting : g_settings)
+    {
+        ColorEditKernel kernel;
+        cv::Mat expected;
+        cv::Mat result(_image.size(), _image.type());
+        ImageError error;
+        bool bLutOnly = (setting.hueShiftDeg == 0) && (setting.saturationScale == 1.0f);
+
+        buildColorEditKernel(kernel, setting.brightness, setting.contrast, (float)setting.hueShiftDeg,
+                             setting.saturationScale);
+        applyColorEditKernel(kernel, _image.data, (int)_image.step, result.data, (int)result.step,
+                             _image.cols, _image.rows, true);
+
+        if(bLutOnly)
+        {
+            // Only the levels: no HSV round trip
+            _image.convertTo(expected, -1, (double)setting.contrast / 100, setting.brightness - 100);
+            cv::cvtColor(expected, expected, cv::COLOR_BGR2RGB);
+        }
+        else
+        {
+            expected = editOpenCV(_image, setting);
+        }
+
+        error = compareImages(result, expected);
+
+        if( (bLutOnly && (error.maxError > 0)) ||
+            (error.maxError > EDIT_MAX_ERROR) || (error.meanError > EDIT_MEAN_ERROR) )
+        {
+            printf("  FAIL brightness %d contrast %d hue %+d saturation x%.1f: max %.0f mean %.3f\n",
+                   setting.brightness, setting.contrast, setting.hueShiftDeg, setting.saturationScale,
+                   error.maxError, error.meanError);
+            bSuccess = false;
+        }
+    }
+
+    return bSuccess;
+}
+
+/**
+*************************************************************************
+@verbatim
++ benchmarkEdit() - Single thread throughput of applyColorEditKernel()
++ ----------------
++ Parameters : _image   BGR image
++              _setting editing values
++ Returns    : double MB/s of input
+@endverbatim
+***************************************************************************/
+static double benchmarkEdit(const cv::Mat &_image, const EditSetting &_setting)
+{
+    ColorEditKernel kernel;
+    cv::Mat result(_image.size(), _image.type());
+    double start;
+
+    buildColorEditKernel(kernel, _setting.brightness, _setting.contrast, (float)_setting.hueShiftDeg,
+                         _setting.saturationScale);
+
+    start = testSeconds();
+    for(int i = 0; i < EDIT_BENCH_REPS; i++)
+    {
+        applyColorEditKernel(kernel, _image.data, (int)_image.step, result.data, (int)result.step,
+                             _image.cols, _image.rows, true);
+    }
+
+    return (double)_image.total() * _image.elemSize() * EDIT_BENCH_REPS / (testSeconds() - start) / 1e6;
+}
+
+/*
+ * Usage: EditKernelTest
+ * Prints the single thread MB/s of each instruction set, for the LUT only
+ * and with hue & saturation, next to the multi-pass OpenCV editing
+ */
+int main()
+{
+    static const EditSetting lutSetting = { 120, 110, 0, 1.0f };
+    static const EditSetting fullSetting = { 120, 110, 40, 1.3f };
+    cv::Mat images[] = { makeTestImage(640, 480, 1), makeTestImage(643, 37, 2), makeTestImage(5, 3, 3) };
+    cv::Mat benchImage = makeTestImage(EDIT_BENCH_WIDTH, EDIT_BENCH_HEIGHT, 4);
+    bool bSuccess = true;
+    double start;
+
+    // Random colours: every hue & saturation
+    cv::randu(images[1], 0, 256);
+
+    for(const char *isa : g_isas)
+    {
+        bool bIsaSuccess = true;
+
+        if(!bSelectColorEditKernelISA(isa))
+        {
+            printf("%s: not supported, skipped\n", isa);
+            continue;
+        }
+
+        for(const cv::Mat &image : images)
+        {
+            bIsaSuccess = bCheckEdit(image) && bIsaSuccess;
+        }
+
+        printf("%s: %s, LUT %.0f MB/s, hue & saturation %.0f MB/s\n", isa, bIsaSuccess ? "passed" : "FAILED",
+               benchmarkEdit(benchImage, lutSetting), benchmarkEdit(benchImage, fullSetting));
+        bSuccess = bSuccess && bIsaSuccess;
+    }
+
+    cv::setNumThreads(1);
+    start = testSeconds();
+    for(int i = 0; i < EDIT_BENCH_REPS; i++)
+    {
+        editOpenCV(benchImage, fullSetting);
+    }
+    printf("OpenCV multi-pass: %.0f MB/s\n",
+           (double)benchImage.total() * benchImage.elemSize() * EDIT_BENCH_REPS / (testSeconds() - start) / 1e6);
+
+    return bSuccess ? 0 : 1;
+}
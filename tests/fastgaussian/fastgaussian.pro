@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# FastGaussian denoizing against cv::GaussianBlur, up to the largest
+# sigma: errors within the documented tolerance
+#
+#-------------------------------------------------
+
+CONFIG -= qt
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = FastGaussianTest
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+    ../testcommon.h
+
+include(../../imagecore.pri)
+
+LIBS += -LC:/opencv-mingw/x86/mingw/lib/ \
+                                -lopencv_core410 \
+                                -lopencv_imgproc410 \
+                                -lopencv_photo410
+
+INCLUDEPATH +=  C:/opencv-mingw/include/
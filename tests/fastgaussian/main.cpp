@@ -0,0 +1,88 @@
+#include "imageprocessor.h"
+#include "testcommon.h"
+
+#include <cstdio>
+
+#include <opencv2/imgproc.hpp>
+
+// Tolerance of the box approximation (see bDenoizeFastGaussian()), sigma
+// from 2 pixels. Below, the blur shall be identical
+#define FAST_GAUSSIAN_MAX_ERROR 8
+#define FAST_GAUSSIAN_MEAN_ERROR 1.0
+
+typedef struct
+{
+    const char *name;
+    cv::Mat image;
+    // Sigmas (x10) checked on the image, 0 terminated
+    int sigmas[16];
+} FastGaussianCase;
+
+/**
+*************************************************************************
+@verbatim
++ bCheckFastGaussian() - Compare the FastGaussian denoizing of an image
++                        with cv::GaussianBlur()
++ ----------------
++ Parameters : _name    name of the image, printed
++              _image   BGR test image
++              _sigma   sigma x10, as ProcessParameters
++ Returns    : TRUE if within the tolerance
+@endverbatim
+***************************************************************************/
+static bool bCheckFastGaussian(const char *_name, const cv::Mat &_image, int _sigma)
+{
+    ProcessParameters params = ProcessParameters();
+    cv::Mat expected;
+    cv::Mat result;
+    ImageError error;
+    bool bExact;
+    bool bSuccess;
+
+    params.sigma = _sigma;
+    if(!ImageProcessor::bCheckDenoizeParams(TypeFastGaussian, params) ||
+       !ImageProcessor::bDenoizeImage(_image, result, TypeFastGaussian, params))
+    {
+        printf("%s sigma %.1f: FAIL, not processed\n", _name, _sigma / 10.0);
+        return false;
+    }
+
+    cv::GaussianBlur(_image, expected, cv::Size(0, 0), _sigma / 10.0);
+    error = compareImages(result, expected);
+
+    bExact = (_sigma < 20);
+    bSuccess = bExact ? (error.maxError == 0) :
+                        (error.maxError <= FAST_GAUSSIAN_MAX_ERROR) && (error.meanError <= FAST_GAUSSIAN_MEAN_ERROR);
+
+    printf("%s sigma %.1f: max %.0f mean %.3f%s\n", _name, _sigma / 10.0, error.maxError, error.meanError,
+           bSuccess ? "" : " FAIL");
+
+    return bSuccess;
+}
+
+/*
+ * Usage: FastGaussianTest
+ * The large image is processed by tiles, across their boundaries
+ */
+int main()
+{
+    FastGaussianCase cases[] = {
+        { "gradients", makeTestImage(640, 480, 1), { 3, 10, 19, 20, 25, 30, 50, 100, 200, 500, 1000, 0 } },
+        { "noise", cv::Mat(480, 640, CV_8UC3), { 10, 20, 30, 100, 1000, 0 } },
+        { "tiled", makeTestImage(2200, 1300, 2), { 30, 200, 0 } }
+    };
+    bool bSuccess = true;
+
+    // Worst case: no correlation between neighbours
+    cv::randu(cases[1].image, 0, 256);
+
+    for(const FastGaussianCase &test : cases)
+    {
+        for(int i = 0; test.sigmas[i] > 0; i++)
+        {
+            bSuccess = bCheckFastGaussian(test.name, test.image, test.sigmas[i]) && bSuccess;
+        }
+    }
+
+    return bSuccess ? 0 : 1;
+}
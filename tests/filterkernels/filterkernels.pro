@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Filter kernels (filterkernels.h) of each instruction set of the CPU
+# against cv::GaussianBlur & cv::medianBlur: results shall be identical
+#
+#-------------------------------------------------
+
+CONFIG -= qt
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = FilterKernelsTest
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+    ../testcommon.h
+
+include(../../imagecore.pri)
+
+LIBS += -LC:/opencv-mingw/x86/mingw/lib/ \
+                                -lopencv_core410 \
+                                -lopencv_imgproc410 \
+                                -lopencv_photo410
+
+INCLUDEPATH +=  C:/opencv-mingw/include/
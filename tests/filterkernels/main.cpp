@@ -0,0 +1,124 @@
+#include "filterkernels.h"
+#include "testcommon.h"
+
+#include <cstdio>
+
+#include <opencv2/imgproc.hpp>
+
+static const char *const g_isas[] = { "scalar", "sse4.1", "avx2", "avx512" };
+static const int g_sizes[] = { 3, 5, 7 };
+// <= 0: taps of the fixed tables
+static const double g_sigmas[] = { 0, 0.5, 0.8, 1.0, 1.5, 2.0, 3.0, 7.5 };
+
+/**
+*************************************************************************
+@verbatim
++ bCheckGaussian() - Compare bGaussianBlurKernel() with cv::GaussianBlur()
++                    for every size & sigma
++ ----------------
++ Parameters : _image   BGR test image
++ Returns    : TRUE if all the results are identical
+@endverbatim
+***************************************************************************/
+static bool bCheckGaussian(const cv::Mat &_image)
+{
+    bool bSuccess = true;
+
+    for(int kernelWidth : g_sizes)
+    {
+        for(int kernelHeight : g_sizes)
+        {
+            for(double sigma : g_sigmas)
+            {
+                cv::Mat expected;
+                cv::Mat result(_image.size(), _image.type());
+                ImageError error;
+
+                cv::GaussianBlur(_image, expected, cv::Size(kernelWidth, kernelHeight), sigma, sigma,
+                                 cv::BORDER_DEFAULT);
+                bGaussianBlurKernel(_image.data, (int)_image.step, result.data, (int)result.step,
+                                    _image.cols, _image.rows, 0, 0, kernelWidth, kernelHeight, sigma);
+                error = compareImages(result, expected);
+
+                if(error.maxError > 0)
+                {
+                    printf("  FAIL gaussian %dx%d sigma %.1f: max %.0f mean %.4f\n",
+                           kernelWidth, kernelHeight, sigma, error.maxError, error.meanError);
+                    bSuccess = false;
+                }
+            }
+        }
+    }
+
+    return bSuccess;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bCheckMedian() - Compare bMedianBlurKernel() with cv::medianBlur()
++ ----------------
++ Parameters : _image   BGR test image
++ Returns    : TRUE if all the results are identical
+@endverbatim
+***************************************************************************/
+static bool bCheckMedian(const cv::Mat &_image)
+{
+    bool bSuccess = true;
+
+    for(int aperture : g_sizes)
+    {
+        cv::Mat expected;
+        cv::Mat result(_image.size(), _image.type());
+        ImageError error;
+
+        cv::medianBlur(_image, expected, aperture);
+        bMedianBlurKernel(_image.data, (int)_image.step, result.data, (int)result.step,
+                          _image.cols, _image.rows, 0, 0, aperture);
+        error = compareImages(result, expected);
+
+        if(error.maxError > 0)
+        {
+            printf("  FAIL median %d: max %.0f mean %.4f\n", aperture, error.maxError, error.meanError);
+            bSuccess = false;
+        }
+    }
+
+    return bSuccess;
+}
+
+/*
+ * Usage: FilterKernelsTest
+ * Widths cover the vector lengths, their remainders and images smaller
+ * than the kernels
+ */
+int main()
+{
+    static const cv::Size sizes[] = { cv::Size(1, 1), cv::Size(2, 3), cv::Size(5, 2), cv::Size(33, 9),
+                                      cv::Size(173, 61), cv::Size(640, 480) };
+    bool bSuccess = true;
+
+    for(const char *isa : g_isas)
+    {
+        bool bIsaSuccess = true;
+
+        if(!bSelectFilterKernelISA(isa))
+        {
+            printf("%s: not supported, skipped\n", isa);
+            continue;
+        }
+
+        for(const cv::Size &size : sizes)
+        {
+            cv::Mat image = makeTestImage(size.width, size.height, (unsigned int)size.area());
+
+            bIsaSuccess = bCheckGaussian(image) && bIsaSuccess;
+            bIsaSuccess = bCheckMedian(image) && bIsaSuccess;
+        }
+
+        printf("%s: %s\n", isa, bIsaSuccess ? "identical to OpenCV" : "FAILED");
+        bSuccess = bSuccess && bIsaSuccess;
+    }
+
+    return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#ifndef TESTCOMMON_H
+#define TESTCOMMON_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <opencv2/core.hpp>
+
+/*
+ * Helpers of the test programs (tests/), which compare the processing
+ * library with the OpenCV functions it replaces
+ */
+
+typedef struct
+{
+    // Largest & mean absolute difference over all the channels, in levels
+    double maxError;
+    double meanError;
+} ImageError;
+
+// Noise over gradients: flat areas, edges and every level of each channel
+static inline cv::Mat makeTestImage(int _width, int _height, unsigned int _seed)
+{
+    cv::Mat image(_height, _width, CV_8UC3);
+    cv::RNG rng(_seed);
+
+    for(int y = 0; y < _height; y++)
+    {
+        unsigned char *row = image.ptr<unsigned char>(y);
+
+        for(int x = 0; x < _width; x++)
+        {
+            int gradient = (x * 255) / std::max(_width - 1, 1);
+
+            row[3 * x] = cv::saturate_cast<unsigned char>(gradient + rng.uniform(-40, 41));
+            row[3 * x + 1] = cv::saturate_cast<unsigned char>(((y * 255) / std::max(_height - 1, 1)) + rng.uniform(-40, 41));
+            row[3 * x + 2] = (unsigned char)rng.uniform(0, 256);
+        }
+    }
+
+    return image;
+}
+
+static inline ImageError compareImages(const cv::Mat &_first, const cv::Mat &_second)
+{
+    ImageError error = { 0, 0 };
+    cv::Mat diff;
+
+    cv::absdiff(_first, _second, diff);
+    cv::minMaxLoc(diff.reshape(1), nullptr, &error.maxError);
+    error.meanError = cv::mean(diff.reshape(1))[0];
+
+    return error;
+}
+
+// Seconds since an arbitrary origin
+static inline double testSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // TESTCOMMON_H
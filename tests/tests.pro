@@ -0,0 +1,13 @@
+#-------------------------------------------------
+#
+# Checks of the processing library against OpenCV: each program prints
+# its measures and returns non-zero if one of them fails
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    filterkernels \
+    fastgaussian \
+    editkernel
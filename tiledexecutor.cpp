@@ -0,0 +1,229 @@
+#include "tiledexecutor.h"
+
+#include <atomic>
+#include <algorithm>
+
+#include "imageprocessor.h"
+#include "workpool.h"
+
+// Default tile core size in pixels
+#define TILE_DEFAULT_SIZE 512
+// Default memory budget for tiles in flight (bytes)
+#define TILE_DEFAULT_BUDGET (512u * 1024u * 1024u)
+
+static std::atomic<size_t> g_defaultMemoryBudget(TILE_DEFAULT_BUDGET);
+
+TiledExecutor::TiledExecutor() :
+    m_tileSize(TILE_DEFAULT_SIZE),
+    m_halo(0),
+    m_memoryBudget(g_defaultMemoryBudget),
+    m_workingSetFactor(4.0)
+{
+
+}
+
+void TiledExecutor::setTileSize(int _tileSize)
+{
+    m_tileSize = std::max(_tileSize, 16);
+}
+
+void TiledExecutor::setHalo(int _halo)
+{
+    m_halo = std::max(_halo, 0);
+}
+
+void TiledExecutor::setMemoryBudget(size_t _bytes)
+{
+    m_memoryBudget = _bytes;
+}
+
+/**
+*************************************************************************
+@verbatim
++ setWorkingSetFactor() - Set the estimated working memory of the tile
++                         processing, as a multiple of the tile input size
++ ----------------
++ Parameters : _factor  working memory / tile input size
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void TiledExecutor::setWorkingSetFactor(double _factor)
+{
+    m_workingSetFactor = std::max(_factor, 1.0);
+}
+
+void TiledExecutor::setDefaultMemoryBudget(size_t _bytes)
+{
+    g_defaultMemoryBudget = _bytes;
+}
+
+size_t TiledExecutor::defaultMemoryBudget()
+{
+    return g_defaultMemoryBudget;
+}
+
+/**
+*************************************************************************
+@verbatim
++ tileCount() - Return the number of tiles covering an image
++ ----------------
++ Parameters : _img     image to split
++ Returns    : int number of tiles
+@endverbatim
+***************************************************************************/
+int TiledExecutor::tileCount(const cv::Mat &_img) const
+{
+    int cols = (_img.cols + m_tileSize - 1) / m_tileSize;
+    int rows = (_img.rows + m_tileSize - 1) / m_tileSize;
+
+    return cols * rows;
+}
+
+/**
+*************************************************************************
+@verbatim
++ maxTilesInFlight() - Return the number of tiles that can be processed
++                      at the same time within the memory budget (at
++                      least one)
++ ----------------
++ Parameters : _img     image to split
++ Returns    : int maximum number of tiles in flight
+@endverbatim
+***************************************************************************/
+int TiledExecutor::maxTilesInFlight(const cv::Mat &_img) const
+{
+    int side = m_tileSize + 2 * m_halo;
+    double tileBytes = (double)side * side * _img.elemSize() * m_workingSetFactor;
+    int inFlight = (int)(m_memoryBudget / tileBytes);
+
+    inFlight = std::min(inFlight, WorkPool::instance().threadCount());
+    inFlight = std::min(inFlight, tileCount(_img));
+
+    return std::max(inFlight, 1);
+}
+
+/**
+*************************************************************************
+@verbatim
++ tileRect() - Return the core rectangle of a tile
++ ----------------
++ Parameters : _img     image to split
++              _index   tile index (row major)
++ Returns    : cv::Rect core of the tile
+@endverbatim
+***************************************************************************/
+cv::Rect TiledExecutor::tileRect(const cv::Mat &_img, int _index) const
+{
+    int cols = (_img.cols + m_tileSize - 1) / m_tileSize;
+    int x = (_index % cols) * m_tileSize;
+    int y = (_index / cols) * m_tileSize;
+
+    return cv::Rect(x, y, std::min(m_tileSize, _img.cols - x), std::min(m_tileSize, _img.rows - y));
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Process an image tile by tile. Each tile is extended by the
++          halo (clipped to the image), processed, and its core is
++          copied into the output. The core rectangles partition the
++          image, so no seam blending is needed as long as the halo
++          covers the processing support. Tiles are pulled from a shared
++          counter by at most maxTilesInFlight() workers. When a control
++          is given, no tile is started once it is cancelled and the
++          progress is reported after each tile
++ ----------------
++ Parameters : _in          input image
++              _out         output image (same size and type as input)
++              _function    processing applied to each tile
++              _control     cancellation & progress, may be NULL
++ Returns    : TRUE if success; FALSE otherwise (or cancelled)
+@endverbatim
+***************************************************************************/
+bool TiledExecutor::bRun(const cv::Mat &_in, cv::Mat &_out, const TileFunction &_function,
+                         TaskControl *_control) const
+{
+    std::atomic<int> nextTile(0);
+    std::atomic<int> doneTiles(0);
+    std::atomic<bool> bFailed(false);
+    int tiles;
+    int workers;
+
+    if(_in.empty())
+        return false;
+
+    tiles = tileCount(_in);
+    workers = maxTilesInFlight(_in);
+
+    // Output shall never alias the input read by the other tiles (a
+    // caller buffer never overlaps the input)
+    if(!ImageProcessor::bIsCallerOutput(_in, _out, _in.type()))
+    {
+        _out.release();
+        _out.create(_in.size(), _in.type());
+    }
+
+    WorkPool::instance().parallelFor(workers, [&](int _begin, int _end)
+    {
+        for(int w = _begin; w < _end; w++)
+        {
+            int index;
+
+            while((index = nextTile++) < tiles)
+            {
+                if( (_control != nullptr) && _control->bIsCancelled() )
+                    break;
+
+                if(!bRunTile(_in, _out, index, _function))
+                {
+                    bFailed = true;
+                    continue;
+                }
+
+                if(_control != nullptr)
+                    _control->setProgress(++doneTiles, tiles);
+            }
+        }
+    }, workers);
+
+    if( (_control != nullptr) && _control->bIsCancelled() )
+        return false;
+
+    return !bFailed;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRunTile() - Process one tile: extend it by the halo (clipped to the
++              image), process it and copy its core into the output.
++              Lets callers schedule the tiles of several images in a
++              single pool
++ ----------------
++ Parameters : _in          input image
++              _out         output image, allocated by the caller (same
++                           size and type as input, never the input)
++              _index       tile index (row major)
++              _function    processing applied to the tile
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool TiledExecutor::bRunTile(const cv::Mat &_in, cv::Mat &_out, int _index, const TileFunction &_function) const
+{
+    cv::Rect core = tileRect(_in, _index);
+    cv::Rect extended(core.x - m_halo, core.y - m_halo,
+                      core.width + 2 * m_halo, core.height + 2 * m_halo);
+    cv::Mat tileOut;
+
+    extended &= cv::Rect(0, 0, _in.cols, _in.rows);
+
+    _function(_in(extended), tileOut);
+
+    if( (tileOut.size() != extended.size()) || (tileOut.type() != _in.type()) )
+        return false;
+
+    tileOut(cv::Rect(core.x - extended.x, core.y - extended.y, core.width, core.height))
+        .copyTo(_out(core));
+
+    return true;
+}
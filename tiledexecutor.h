@@ -0,0 +1,49 @@
+#ifndef TILEDEXECUTOR_H
+#define TILEDEXECUTOR_H
+
+#include <functional>
+#include <cstddef>
+
+#include <opencv2/core.hpp>
+
+#include "taskcontrol.h"
+
+// Processing applied to one tile (input includes the halo, output has the same size)
+typedef std::function<void(const cv::Mat &_in, cv::Mat &_out)> TileFunction;
+
+/*
+ * Split an image into tiles extended by a halo, process them in parallel
+ * and write back the tile cores. When the halo covers the support of the
+ * processing, the result is identical to the untiled one.
+ */
+class TiledExecutor
+{
+public:
+    TiledExecutor();
+
+    void setTileSize(int _tileSize);
+    void setHalo(int _halo);
+    void setMemoryBudget(size_t _bytes);
+    void setWorkingSetFactor(double _factor);
+
+    int tileCount(const cv::Mat &_img) const;
+    int maxTilesInFlight(const cv::Mat &_img) const;
+
+    bool bRun(const cv::Mat &_in, cv::Mat &_out, const TileFunction &_function,
+              TaskControl *_control = nullptr) const;
+    bool bRunTile(const cv::Mat &_in, cv::Mat &_out, int _index, const TileFunction &_function) const;
+
+    // Budget used by executors created without explicit budget
+    static void setDefaultMemoryBudget(size_t _bytes);
+    static size_t defaultMemoryBudget();
+
+private:
+    cv::Rect tileRect(const cv::Mat &_img, int _index) const;
+
+    int m_tileSize;
+    int m_halo;
+    size_t m_memoryBudget;
+    double m_workingSetFactor;
+};
+
+#endif // TILEDEXECUTOR_H
@@ -0,0 +1,543 @@
+#include "videoprocessor.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+
+#include <deque>
+#include <functional>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/photo.hpp>
+
+// Stage indexes of the statistics
+static const int g_stageDecode = 0;
+static const int g_stageProcess = 1;
+static const int g_stageEncode = 2;
+
+/*
+ * Pipeline stage running on its own thread
+ */
+class VideoStage : public QThread
+{
+public:
+    explicit VideoStage(std::function<void()> _body) :
+        m_body(_body)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        m_body();
+    }
+
+private:
+    std::function<void()> m_body;
+};
+
+VideoProcessor::VideoProcessor() :
+    m_temporalWindow(1),
+    m_queueCapacity(8),
+    m_codec("MJPG"),
+    m_fps(25),
+    m_bEditKernelReady(false),
+    m_decodedQueue(nullptr),
+    m_processedQueue(nullptr),
+    m_decodedFrames(0),
+    m_processedFrames(0),
+    m_encodedFrames(0),
+    m_bFailed(false)
+{
+    m_operation.bDenoize = false;
+    m_operation.type = TypeGaussianBlur;
+    m_operation.bEdit = false;
+
+    for(int i = 0; i < 3; i++)
+    {
+        m_stageNs[i] = 0;
+    }
+}
+
+void VideoProcessor::setOperation(const BatchOperation &_operation)
+{
+    m_operation = _operation;
+}
+
+void VideoProcessor::setTemporalWindow(int _frames)
+{
+    m_temporalWindow = std::max(1, _frames);
+}
+
+void VideoProcessor::setQueueCapacity(int _frames)
+{
+    m_queueCapacity = std::max(1, _frames);
+}
+
+void VideoProcessor::setCodec(const QString &_fourcc)
+{
+    m_codec = _fourcc;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRun() - Denoize a video or an image sequence. Decoding, processing and
++          encoding overlap; progress is printed every second
++ ----------------
++ Parameters : _input   video file or image sequence pattern
++              _output  video file or image sequence pattern
++ Returns    : TRUE if every frame was processed; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool VideoProcessor::bRun(QString _input, QString _output)
+{
+    BoundedQueue<VideoFrame> decodedQueue(m_queueCapacity);
+    BoundedQueue<VideoFrame> processedQueue(m_queueCapacity);
+    QElapsedTimer timer;
+
+    if( (m_temporalWindow > 1) && (!m_operation.bDenoize || (m_operation.type != TypeNlMeans)) )
+    {
+        qDebug() << __func__ << " Temporal window requires the nlmeans operation!";
+        return false;
+    }
+
+    if( (m_temporalWindow > 1) && !(m_temporalWindow % 2) )
+    {
+        // Window is centered on the denoized frame
+        m_temporalWindow++;
+    }
+
+    if(m_operation.bDenoize && !ImageProcessor::bCheckDenoizeParams(m_operation.type, m_operation.params))
+    {
+        qDebug() << __func__ << " Bad parameters!";
+        return false;
+    }
+
+    if(!m_capture.open(_input.toStdString()))
+    {
+        qDebug() << __func__ << " Could not open input video!";
+        return false;
+    }
+
+    if(m_capture.get(cv::CAP_PROP_FPS) > 0)
+    {
+        m_fps = m_capture.get(cv::CAP_PROP_FPS);
+    }
+
+    m_output = _output;
+    m_decodedQueue = &decodedQueue;
+    m_processedQueue = &processedQueue;
+
+    VideoStage decoder([this]() { decodeStage(); });
+    VideoStage processor([this]() { processStage(); });
+    VideoStage encoder([this]() { encodeStage(); });
+
+    timer.start();
+    decoder.start();
+    processor.start();
+    encoder.start();
+
+    while(!encoder.wait(1000))
+    {
+        printProgress(timer.nsecsElapsed() / 1e6, false);
+    }
+
+    // Encoder is done: release upstream stages if it stopped early
+    decodedQueue.close();
+    processedQueue.close();
+    processor.wait();
+    decoder.wait();
+
+    m_writer.release();
+    m_capture.release();
+
+    printProgress(timer.nsecsElapsed() / 1e6, true);
+
+    m_decodedQueue = nullptr;
+    m_processedQueue = nullptr;
+
+    return !m_bFailed && (m_encodedFrames > 0);
+}
+
+/**
+*************************************************************************
+@verbatim
++ decodeStage() - Read frames and queue them for processing. Blocks when
++                 the processing stage is behind
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void VideoProcessor::decodeStage()
+{
+    QElapsedTimer timer;
+
+    forever
+    {
+        VideoFrame frame;
+
+        timer.start();
+        {
+            ScopedTimer stage("videoDecode");
+
+            if(!m_capture.read(frame.img) || frame.img.empty())
+                break;
+        }
+        m_stageNs[g_stageDecode] += timer.nsecsElapsed();
+
+        frame.index = m_decodedFrames++;
+
+        if(!m_decodedQueue->push(frame))
+            break;
+    }
+
+    m_decodedQueue->close();
+}
+
+/**
+*************************************************************************
+@verbatim
++ processStage() - Edit and denoize the decoded frames
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void VideoProcessor::processStage()
+{
+    bool bOK;
+
+    if(m_temporalWindow > 1)
+        bOK = bProcessTemporal();
+    else
+        bOK = bProcessFrames();
+
+    if(!bOK)
+    {
+        m_bFailed = true;
+        m_decodedQueue->close();
+    }
+
+    m_processedQueue->close();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bEditFrame() - Apply the editing values to a frame. Hue & saturation
++                targets are relative to the levels of the first frame,
++                so that the whole sequence gets the same correction
++ ----------------
++ Parameters : _img     frame to edit
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool VideoProcessor::bEditFrame(cv::Mat &_img)
+{
+    cv::Mat out;
+
+    if(!m_operation.bEdit)
+        return true;
+
+    if(!m_bEditKernelReady)
+    {
+        int meanHue = 0;
+        int meanSaturation = 0;
+
+        ImageProcessor::computeMeanHueSaturation(_img, meanHue, meanSaturation);
+        ImageProcessor::buildEditKernel(m_editKernel, m_operation.brightness, m_operation.contrast,
+                                        (m_operation.hue < 0) ? meanHue : m_operation.hue,
+                                        (m_operation.saturation < 0) ? meanSaturation : m_operation.saturation,
+                                        meanHue, meanSaturation);
+        m_bEditKernelReady = true;
+    }
+
+    if(!ImageProcessor::bEditImage(_img, out, m_editKernel, false))
+        return false;
+
+    _img = out;
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bProcessFrames() - Process frames one by one with the selected
++                    ProcessType
++ ----------------
++ Parameters : NONE
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool VideoProcessor::bProcessFrames()
+{
+    QElapsedTimer timer;
+    VideoFrame frame;
+
+    while(m_decodedQueue->pop(frame))
+    {
+        VideoFrame result;
+
+        timer.start();
+
+        if(!bEditFrame(frame.img))
+            return false;
+
+        result.index = frame.index;
+        if(m_operation.bDenoize)
+        {
+            if(!ImageProcessor::bDenoizeImage(frame.img, result.img, m_operation.type, m_operation.params))
+                return false;
+        }
+        else
+        {
+            result.img = frame.img;
+        }
+
+        m_stageNs[g_stageProcess] += timer.nsecsElapsed();
+        m_processedFrames++;
+
+        if(!m_processedQueue->push(result))
+            break;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bProcessTemporal() - Denoize each frame with NlMeans using its
++                      neighbours: a sliding window of frames centered on
++                      the denoized one. The window shrinks at both ends
++                      of the sequence
++ ----------------
++ Parameters : NONE
++ Returns    : TRUE if success; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool VideoProcessor::bProcessTemporal()
+{
+    const ProcessParameters &params = m_operation.params;
+    int half = m_temporalWindow / 2;
+    std::deque<VideoFrame> window;
+    QElapsedTimer timer;
+    bool bEndOfStream = false;
+    int next = 0;
+
+    forever
+    {
+        VideoFrame result;
+        std::vector<cv::Mat> imgs;
+        int pos;
+        int radius;
+
+        // Fill the window up to the last neighbour of the next frame
+        while(!bEndOfStream && (window.empty() || (window.back().index < next + half)))
+        {
+            VideoFrame frame;
+
+            if(!m_decodedQueue->pop(frame))
+            {
+                bEndOfStream = true;
+                break;
+            }
+
+            timer.start();
+            if(!bEditFrame(frame.img))
+                return false;
+            m_stageNs[g_stageProcess] += timer.nsecsElapsed();
+
+            window.push_back(frame);
+        }
+
+        if(window.empty() || (window.back().index < next))
+            break;
+
+        // Drop frames that are no longer neighbours
+        while(window.front().index < next - half)
+        {
+            window.pop_front();
+        }
+
+        timer.start();
+
+        pos = next - window.front().index;
+        radius = std::min(half, std::min(pos, (int)window.size() - 1 - pos));
+        for(int i = pos - radius; i <= pos + radius; i++)
+        {
+            imgs.push_back(window[i].img);
+        }
+
+        {
+            ScopedTimer stage("NlMeansTemporal", (2 * radius + 2) * imgs[0].total() * imgs[0].elemSize());
+
+            cv::fastNlMeansDenoisingColoredMulti(imgs, result.img, radius, 2 * radius + 1,
+                                                 (float)params.h, (float)params.hColor,
+                                                 params.templateWindowSize, params.searchWindowSize);
+        }
+
+        m_stageNs[g_stageProcess] += timer.nsecsElapsed();
+
+        if(result.img.empty())
+            return false;
+
+        result.index = next++;
+        m_processedFrames++;
+
+        if(!m_processedQueue->push(result))
+            break;
+    }
+
+    return true;
+}
+
+/**
+*************************************************************************
+@verbatim
++ encodeStage() - Write the processed frames. The writer is opened with
++                 the size of the first frame
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void VideoProcessor::encodeStage()
+{
+    QElapsedTimer timer;
+    VideoFrame frame;
+
+    while(m_processedQueue->pop(frame))
+    {
+        timer.start();
+
+        if(!m_writer.isOpened())
+        {
+            bool bOpened;
+
+            if(m_output.contains('%'))
+            {
+                // Image sequence, format given by the extension
+                bOpened = m_writer.open(m_output.toStdString(), cv::CAP_IMAGES, 0, m_fps, frame.img.size());
+            }
+            else
+            {
+                QByteArray fourcc = m_codec.toLatin1().leftJustified(4, ' ');
+                bOpened = m_writer.open(m_output.toStdString(),
+                                        cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]),
+                                        m_fps, frame.img.size());
+            }
+
+            if(!bOpened)
+            {
+                qDebug() << __func__ << " Could not open output video!";
+                m_bFailed = true;
+                break;
+            }
+        }
+
+        {
+            ScopedTimer stage("videoEncode", frame.img.total() * frame.img.elemSize());
+            m_writer.write(frame.img);
+        }
+
+        m_stageNs[g_stageEncode] += timer.nsecsElapsed();
+        m_encodedFrames++;
+    }
+
+    // Stop upstream stages if the encoder failed
+    m_processedQueue->close();
+}
+
+/**
+*************************************************************************
+@verbatim
++ printProgress() - Print frame counts, throughput and queue depths. The
++                   final report adds the busy time of each stage
++ ----------------
++ Parameters : _elapsedMs   time since the start of the pipeline
++              _bFinal      TRUE for the final report
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void VideoProcessor::printProgress(double _elapsedMs, bool _bFinal)
+{
+    QTextStream out(stdout);
+    double fps = (_elapsedMs > 0) ? m_encodedFrames * 1000.0 / _elapsedMs : 0;
+
+    if(!_bFinal)
+    {
+        out << "frames decoded " << m_decodedFrames << ", processed " << m_processedFrames
+            << ", encoded " << m_encodedFrames << " | " << QString::number(fps, 'f', 2) << " fps"
+            << " | queues " << m_decodedQueue->depth() << "/" << m_decodedQueue->capacity()
+            << ", " << m_processedQueue->depth() << "/" << m_processedQueue->capacity() << "\n";
+        out.flush();
+        return;
+    }
+
+    out << "\n" << m_encodedFrames << " frames in " << QString::number(_elapsedMs / 1000, 'f', 2) << " s, "
+        << QString::number(fps, 'f', 2) << " fps" << (m_bFailed ? " (FAILED)" : "") << "\n";
+    out << "decode  busy " << QString::number(m_stageNs[g_stageDecode] / 1e9, 'f', 2) << " s, "
+        << "queue max " << m_decodedQueue->maxDepth() << "/" << m_decodedQueue->capacity() << "\n";
+    out << "process busy " << QString::number(m_stageNs[g_stageProcess] / 1e9, 'f', 2) << " s, "
+        << "queue max " << m_processedQueue->maxDepth() << "/" << m_processedQueue->capacity() << "\n";
+    out << "encode  busy " << QString::number(m_stageNs[g_stageEncode] / 1e9, 'f', 2) << " s\n";
+}
+
+/**
+*************************************************************************
+@verbatim
++ runVideoCommandLine() - Parse video mode arguments and run the pipeline.
++                         Usage: ImageEnhancer --video in.mp4 out.avi --op nlmeans --temporal-window 5
++ ----------------
++ Parameters : _arguments   application arguments
++ Returns    : int process exit code
+@endverbatim
+***************************************************************************/
+int runVideoCommandLine(const QStringList &_arguments)
+{
+    QCommandLineParser parser;
+    VideoProcessor processor;
+    BatchOperation operation;
+
+    parser.setApplicationDescription("Headless denoizing of a video or an image sequence");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Video file or image sequence pattern (frame_%04d.png)");
+    parser.addPositionalArgument("output", "Video file or image sequence pattern");
+    parser.addOptions({
+        { "video", "Run in headless video mode" },
+        { "temporal-window", "Frames used by temporal NlMeans (odd, 1 to denoize frames alone)", "N", "1" },
+        { "queue", "Capacity of the queues between stages (frames)", "N", "8" },
+        { "codec", "FourCC of the output video", "fourcc", "MJPG" },
+    });
+    addProcessingOptions(parser);
+
+    parser.process(_arguments);
+
+    if(parser.positionalArguments().size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    if(!bParseProcessingOptions(parser, operation))
+        return 1;
+
+    processor.setOperation(operation);
+    processor.setTemporalWindow(parser.value("temporal-window").toInt());
+    processor.setQueueCapacity(parser.value("queue").toInt());
+    processor.setCodec(parser.value("codec"));
+
+    bool bOK = processor.bRun(parser.positionalArguments().at(0), parser.positionalArguments().at(1));
+
+    if(parser.isSet("trace") && !Profiler::bWriteTrace(parser.value("trace")))
+    {
+        bOK = false;
+    }
+
+    return bOK ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#ifndef VIDEOPROCESSOR_H
+#define VIDEOPROCESSOR_H
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+#include <opencv2/videoio.hpp>
+
+#include "batchprocessor.h"
+#include "boundedqueue.h"
+
+typedef struct
+{
+    int index;
+    cv::Mat img;
+} VideoFrame;
+
+/*
+ * Headless denoizing of a video file or an image sequence (printf style
+ * pattern, e.g. frame_%04d.png). Decoding, processing and encoding run
+ * as pipeline stages on their own threads, linked by bounded queues.
+ * Frames are denoized with any ProcessType, or with temporal NlMeans
+ * over a sliding window of neighbouring frames.
+ */
+class VideoProcessor
+{
+public:
+    VideoProcessor();
+
+    void setOperation(const BatchOperation &_operation);
+    void setTemporalWindow(int _frames);
+    void setQueueCapacity(int _frames);
+    void setCodec(const QString &_fourcc);
+
+    bool bRun(QString _input, QString _output);
+
+private:
+    // Pipeline stages
+    void decodeStage();
+    void processStage();
+    void encodeStage();
+
+    bool bEditFrame(cv::Mat &_img);
+    bool bProcessTemporal();
+    bool bProcessFrames();
+    void printProgress(double _elapsedMs, bool _bFinal);
+
+    BatchOperation          m_operation;
+    int                     m_temporalWindow;
+    int                     m_queueCapacity;
+    QString                 m_codec;
+    QString                 m_output;
+
+    cv::VideoCapture        m_capture;
+    cv::VideoWriter         m_writer;
+    double                  m_fps;
+
+    // Editing kernel, built from the levels of the first frame
+    ColorEditKernel         m_editKernel;
+    bool                    m_bEditKernelReady;
+
+    BoundedQueue<VideoFrame> *m_decodedQueue;
+    BoundedQueue<VideoFrame> *m_processedQueue;
+
+    // Statistics, updated by the stages
+    std::atomic<int>        m_decodedFrames;
+    std::atomic<int>        m_processedFrames;
+    std::atomic<int>        m_encodedFrames;
+    std::atomic<qint64>     m_stageNs[3];
+    std::atomic<bool>       m_bFailed;
+};
+
+int runVideoCommandLine(const QStringList &_arguments);
+
+#endif // VIDEOPROCESSOR_H
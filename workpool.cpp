@@ -0,0 +1,517 @@
+#include "workpool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// Stripes of a parallel loop per thread by default: spare stripes are
+// claimed by the threads done first
+#define POOL_STRIPES_PER_THREAD 4
+
+// Worker index of the current thread (-1 outside of the pool)
+static thread_local int t_workerIndex = -1;
+// Nesting of the SerialScope of the current thread
+static thread_local int t_serialDepth = 0;
+
+/*
+ * Stripes of one parallelFor(), claimed in order by the calling thread
+ * and by the helper tasks it queues, which run the stripes of this group
+ * only. Helpers still queued when the loop returns find no stripe left:
+ * the group is shared with them, the function is not used anymore. The
+ * first exception thrown by a stripe is rethrown to the calling thread
+ */
+typedef struct
+{
+    const WorkRangeFunction *function;
+    int count;
+    int stripes;
+    std::atomic<int> next;
+    std::mutex mutex;
+    std::condition_variable done;
+    int remaining;
+    std::exception_ptr error;
+} WorkGroup;
+
+/**
+*************************************************************************
+@verbatim
++ runStripes() - Run the stripes of a group until none is left to claim
++ ----------------
++ Parameters : _group   parallel loop
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+static void runStripes(WorkGroup &_group)
+{
+    for(int stripe = _group.next++; stripe < _group.stripes; stripe = _group.next++)
+    {
+        int begin = (int)((long long)_group.count * stripe / _group.stripes);
+        int end = (int)((long long)_group.count * (stripe + 1) / _group.stripes);
+        std::exception_ptr error;
+
+        try
+        {
+            (*_group.function)(begin, end);
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(_group.mutex);
+
+        if(error && !_group.error)
+            _group.error = error;
+        if(--_group.remaining == 0)
+            _group.done.notify_all();
+    }
+}
+
+/**
+*************************************************************************
+@verbatim
++ bPinThread() - Pin the calling thread to one CPU
++ ----------------
++ Parameters : _cpu     CPU index
++ Returns    : TRUE if success; FALSE otherwise (or not supported)
+@endverbatim
+***************************************************************************/
+static bool bPinThread(int _cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    if(_cpu >= CPU_SETSIZE)
+        return false;
+
+    CPU_ZERO(&set);
+    CPU_SET(_cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    // Processor group of the process only (64 CPUs)
+    if(_cpu >= (int)(8 * sizeof(DWORD_PTR)))
+        return false;
+
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << _cpu) != 0;
+#else
+    (void)_cpu;
+    return false;
+#endif
+}
+
+WorkPool &WorkPool::instance()
+{
+    static WorkPool pool;
+
+    return pool;
+}
+
+WorkPool::WorkPool() :
+    m_bStopping(false),
+    m_opencvThreads(1),
+    m_pinned(0),
+    m_pinFailures(0),
+    m_queued(0),
+    m_maxQueued(0),
+    m_executed(0),
+    m_steals(0)
+{
+    (void)bStart(0, std::vector<int>());
+}
+
+WorkPool::~WorkPool()
+{
+    stop();
+}
+
+bool WorkPool::configure(int _threads, const std::vector<int> &_cpus)
+{
+    stop();
+    return bStart(_threads, _cpus);
+}
+
+bool WorkPool::bAffinitySupported()
+{
+#if defined(__linux__) || defined(_WIN32)
+    return true;
+#else
+    return false;
+#endif
+}
+
+int WorkPool::threadCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return (int)m_workers.size();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bStart() - Start the workers, pin them to the CPUs and cap the threads
++            of OpenCV to the CPUs left per worker. Each worker pins
++            itself, the call returns once all of them tried
++ ----------------
++ Parameters : _threads number of workers (<= 0: one per CPU)
++              _cpus    CPUs the workers are pinned to (round robin),
++                       empty for no affinity
++ Returns    : TRUE if every worker could be pinned; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool WorkPool::bStart(int _threads, const std::vector<int> &_cpus)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    int cpus = _cpus.empty() ? (int)std::max(1u, std::thread::hardware_concurrency()) : (int)_cpus.size();
+    int threads = (_threads > 0) ? _threads : cpus;
+
+    m_bStopping = false;
+    m_pinned = 0;
+    m_pinFailures = 0;
+    m_opencvThreads = std::max(1, cpus / threads);
+    cv::setNumThreads(m_opencvThreads);
+
+    for(int i = 0; i < threads; i++)
+    {
+        m_workers.emplace_back(new Worker());
+        m_workers[i]->cpu = _cpus.empty() ? -1 : _cpus[i % _cpus.size()];
+    }
+
+    for(int i = 0; i < threads; i++)
+    {
+        m_workers[i]->thread = std::thread(&WorkPool::workerLoop, this, i);
+    }
+
+    if(_cpus.empty())
+        return true;
+
+    m_pinDone.wait(lock, [this, threads]() { return m_pinned == threads; });
+
+    return m_pinFailures == 0;
+}
+
+/**
+*************************************************************************
+@verbatim
++ stop() - Stop the workers once every pending task is done
++ ----------------
++ Parameters : NONE
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void WorkPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bStopping = true;
+    }
+    m_wake.notify_all();
+
+    for(std::unique_ptr<Worker> &worker : m_workers)
+    {
+        if(worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workers.clear();
+}
+
+void WorkPool::submit(const WorkTask &_task)
+{
+    push(_task);
+}
+
+/**
+*************************************************************************
+@verbatim
++ push() - Queue a task: on the queue of the current worker, or on the
++          shared queue from other threads, and wake an idle worker
++ ----------------
++ Parameters : _task    task to run
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void WorkPool::push(const WorkTask &_task)
+{
+    int queued;
+
+    if(t_workerIndex >= 0)
+    {
+        Worker &worker = *m_workers[t_workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        worker.tasks.push_back(_task);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_shared.push_back(_task);
+    }
+
+    queued = ++m_queued;
+    for(int max = m_maxQueued; (queued > max) && !m_maxQueued.compare_exchange_weak(max, queued); )
+    {
+    }
+
+    // Idle workers check the count under the mutex: no lost wake up
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_wake.notify_one();
+}
+
+/**
+*************************************************************************
+@verbatim
++ bRunPending() - Run one pending task of a worker: the newest of its own
++                 queue, else the oldest of the shared queue, else the
++                 oldest of another worker (steal)
++ ----------------
++ Parameters : NONE
++ Returns    : TRUE if a task was run; FALSE if the queues were empty
+@endverbatim
+***************************************************************************/
+bool WorkPool::bRunPending()
+{
+    int self = t_workerIndex;
+    int count = (int)m_workers.size();
+    WorkTask task;
+    bool bStolen = false;
+
+    if(self >= 0)
+    {
+        Worker &worker = *m_workers[self];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if(!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+    }
+
+    if(!task)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!m_shared.empty())
+        {
+            task = std::move(m_shared.front());
+            m_shared.pop_front();
+        }
+    }
+
+    // Victims are visited from the next worker, spreading the steals
+    for(int i = 1; !task && (i <= count); i++)
+    {
+        int victim = (std::max(self, 0) + i) % count;
+
+        if(victim == self)
+            continue;
+
+        Worker &worker = *m_workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+
+        if(!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            bStolen = true;
+        }
+    }
+
+    if(!task)
+        return false;
+
+    m_queued--;
+    m_executed++;
+    if(bStolen)
+        m_steals++;
+
+    task();
+
+    return true;
+}
+
+void WorkPool::workerLoop(int _index)
+{
+    int cpu = m_workers[_index]->cpu;
+
+    t_workerIndex = _index;
+
+    if(cpu >= 0)
+    {
+        bool bPinned = bPinThread(cpu);
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(!bPinned)
+        {
+            std::cerr << __func__ << " Could not pin pool thread " << _index << " to CPU " << cpu << "!" << std::endl;
+            m_pinFailures++;
+        }
+        m_pinned++;
+        m_pinDone.notify_all();
+    }
+
+    while(true)
+    {
+        if(bRunPending())
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_wake.wait(lock, [this]() { return m_bStopping || (m_queued > 0); });
+
+        if(m_bStopping && (m_queued <= 0))
+            break;
+    }
+
+    t_workerIndex = -1;
+}
+
+/**
+*************************************************************************
+@verbatim
++ parallelFor() - Split [0, _count) into stripes run by the pool, as
++                 cv::parallel_for_(). The calling thread runs stripes
++                 too and returns once all are done. It only runs the
++                 stripes of this loop: an unrelated task (an encode, a
++                 file of a batch) would delay the return and run nested
++                 in the caller. Runs inline in a SerialScope
++ ----------------
++ Parameters : _count       number of indices
++              _function    processing of a stripe [_begin, _end)
++              _stripes     number of stripes (<= 0: a few per thread),
++                           bounds the stripes run concurrently
++ Returns    : NONE
+@endverbatim
+***************************************************************************/
+void WorkPool::parallelFor(int _count, const WorkRangeFunction &_function, int _stripes)
+{
+    std::shared_ptr<WorkGroup> group;
+    int stripes;
+    int helpers;
+
+    if(_count <= 0)
+        return;
+
+    stripes = (_stripes > 0) ? _stripes : POOL_STRIPES_PER_THREAD * threadCount();
+    stripes = std::min(stripes, _count);
+
+    if( (stripes <= 1) || (t_serialDepth > 0) )
+    {
+        _function(0, _count);
+        return;
+    }
+
+    group = std::make_shared<WorkGroup>();
+    group->function = &_function;
+    group->count = _count;
+    group->stripes = stripes;
+    group->next = 0;
+    group->remaining = stripes;
+
+    // Each helper claims stripes until none is left
+    helpers = std::min(stripes - 1, threadCount());
+    for(int i = 0; i < helpers; i++)
+    {
+        push([group]() { runStripes(*group); });
+    }
+
+    runStripes(*group);
+
+    // The stripes still running are claimed by busy threads: no deadlock
+    {
+        std::unique_lock<std::mutex> lock(group->mutex);
+
+        group->done.wait(lock, [&group]() { return group->remaining == 0; });
+    }
+
+    if(group->error)
+        std::rethrow_exception(group->error);
+}
+
+WorkPoolStats WorkPool::stats() const
+{
+    WorkPoolStats stats;
+
+    stats.threads = threadCount();
+    stats.opencvThreads = m_opencvThreads;
+    stats.queued = std::max((int)m_queued, 0);
+    stats.maxQueued = m_maxQueued;
+    stats.executed = m_executed;
+    stats.steals = m_steals;
+
+    return stats;
+}
+
+void WorkPool::resetStats()
+{
+    m_maxQueued = std::max((int)m_queued, 0);
+    m_executed = 0;
+    m_steals = 0;
+}
+
+/**
+*************************************************************************
+@verbatim
++ bParseCpuList() - Parse a list of CPUs, e.g. "0-3,8,10"
++ ----------------
++ Parameters : _list    comma separated CPUs or ranges of CPUs
++              _cpus    receives the CPUs
++ Returns    : TRUE if the list is valid; FALSE otherwise
+@endverbatim
+***************************************************************************/
+bool WorkPool::bParseCpuList(const std::string &_list, std::vector<int> &_cpus)
+{
+    std::stringstream stream(_list);
+    std::string item;
+
+    _cpus.clear();
+
+    while(std::getline(stream, item, ','))
+    {
+        int first;
+        int last;
+        char dash;
+        std::stringstream range(item);
+
+        if(!(range >> first) || (first < 0))
+            return false;
+
+        last = first;
+        if( (range >> dash) && ((dash != '-') || !(range >> last) || (last < first)) )
+            return false;
+
+        for(int cpu = first; cpu <= last; cpu++)
+        {
+            _cpus.push_back(cpu);
+        }
+    }
+
+    return !_cpus.empty();
+}
+
+WorkPool::SerialScope::SerialScope()
+{
+    t_serialDepth++;
+}
+
+WorkPool::SerialScope::~SerialScope()
+{
+    t_serialDepth--;
+}
@@ -0,0 +1,117 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Task run by the pool, shall not throw
+typedef std::function<void()> WorkTask;
+// Processing of the indices [_begin, _end) of a parallel loop
+typedef std::function<void(int _begin, int _end)> WorkRangeFunction;
+
+typedef struct
+{
+    int threads;
+    // Threads OpenCV may use inside each task
+    int opencvThreads;
+    // Tasks waiting in the queues, now and at most since resetStats()
+    int queued;
+    int maxQueued;
+    // Tasks run since resetStats(), and how many were stolen from the
+    // queue of another worker
+    long long executed;
+    long long steals;
+} WorkPoolStats;
+
+/*
+ * Thread pool shared by every processing operation (tiles, row bands,
+ * batch files, statistics, encodes), so that concurrent operations
+ * never oversubscribe the CPUs. Each worker owns a queue: it runs its
+ * own tasks newest first and, once empty, steals the oldest task of
+ * another worker. Tasks from other threads go to a shared queue.
+ *
+ * A thread waiting for parallelFor() runs the stripes of its own loop
+ * meanwhile, never other tasks, so nested loops neither deadlock nor
+ * add threads. OpenCV's own threads are capped so that pool and OpenCV
+ * together match the CPUs.
+ */
+class WorkPool
+{
+public:
+    static WorkPool &instance();
+
+    // Restart the workers with _threads threads (<= 0: one per CPU, or
+    // per CPU of _cpus), pinned to _cpus when not empty. Pending tasks
+    // are completed first: call it when idle. FALSE if a worker could
+    // not be pinned (it runs unpinned)
+    bool configure(int _threads, const std::vector<int> &_cpus = std::vector<int>());
+    int threadCount() const;
+    // TRUE if configure() can pin the workers (Linux & Windows)
+    static bool bAffinitySupported();
+
+    void submit(const WorkTask &_task);
+    void parallelFor(int _count, const WorkRangeFunction &_function, int _stripes = 0);
+
+    WorkPoolStats stats() const;
+    void resetStats();
+
+    static bool bParseCpuList(const std::string &_list, std::vector<int> &_cpus);
+
+    /*
+     * Run the parallel loops of this thread inline while in scope, e.g.
+     * to measure the CPU time of a task by its duration
+     */
+    class SerialScope
+    {
+    public:
+        SerialScope();
+        ~SerialScope();
+    };
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<WorkTask> tasks;
+        std::thread thread;
+        // CPU the worker pins itself to, -1 for none
+        int cpu;
+    };
+
+    WorkPool();
+    ~WorkPool();
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    bool bStart(int _threads, const std::vector<int> &_cpus);
+    void stop();
+    void push(const WorkTask &_task);
+    bool bRunPending();
+    void workerLoop(int _index);
+
+    // Workers & the shared queue, guarded by m_mutex (configuration)
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<WorkTask> m_shared;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    bool m_bStopping;
+    int m_opencvThreads;
+    // Workers done pinning themselves & failures, guarded by m_mutex
+    std::condition_variable m_pinDone;
+    int m_pinned;
+    int m_pinFailures;
+
+    std::atomic<int> m_queued;
+    std::atomic<int> m_maxQueued;
+    std::atomic<long long> m_executed;
+    std::atomic<long long> m_steals;
+};
+
+#endif // WORKPOOL_H